@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../parser/incremental.h"
+#include "pl0gen.h"
+
+using namespace std;
+
+/*
+ * 增量分析基准
+ * 对不同大小的合成程序，比较整篇分析的耗时与 Document::edit() 的单次编辑延迟：
+ *   输入   在随机一条赋值语句的末尾逐字敲入 " + 1"，再逐字删去
+ *   换行   在随机一个 ';' 之后插入换行，再删去（改变行数，其后的结点位置记为平移）
+ *   整句   在随机一条赋值语句之后粘贴一条赋值语句，再整条删去（复合语句中增删语句）
+ * 报告每类编辑的中位、p99 与最大延迟，退回整篇分析的次数，以及平均重新分析的字节数。
+ * --check 时每次编辑后再整篇分析一遍，比较语法树（含位置）与诊断是否一致，不一致时返回 1。
+ *
+ * 用法: ./editbench [--edits N] [--check] [--sizes 64K,1M,4M] [生成器选项]
+ */
+
+typedef chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0)
+{
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static double percentile(vector<double> v, double p)
+{
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+}
+
+/* 语法树（含位置）与诊断的文本，供 --check 比较 */
+static void dump(const Ast& ast, string& out)
+{
+    vector<pair<uint32_t, int>> stack(1, make_pair(ast.root(), 0));
+    while (!stack.empty()) {
+        uint32_t id = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        const Node& n = ast[id];
+        out.append(depth, ' ');
+        appendLabel(out, ast, n);
+        out += " @" + to_string(n.line) + ":" + to_string(n.col) + "\n";
+        vector<uint32_t> kids;
+        for (uint32_t c = n.first; c != Ast::NIL; c = ast[c].next) kids.push_back(c);
+        for (size_t k = kids.size(); k-- > 0;) stack.push_back(make_pair(kids[k], depth + 1));
+    }
+}
+
+static string snapshot(Document& doc)
+{
+    string s;
+    if (!doc.tree().empty()) dump(doc.tree(), s);
+    for (const Diagnostic& d : doc.diagnostics())
+        s += to_string(d.line) + ":" + to_string(d.col) + " " + d.message + "\n";
+    return s;
+}
+
+/* 一类编辑的统计 */
+struct Category {
+    const char* name;
+    vector<double> latency;
+    int full = 0;
+    size_t relexed = 0;
+
+    explicit Category(const char* name) : name(name) {}
+};
+
+struct Bench {
+    Document doc;
+    string text;            // 与 doc 同步的文本，用于挑选编辑位置
+    bool check = false;
+    int mismatches = 0;
+
+    explicit Bench(const string& src) : doc(src), text(src) {}
+
+    void edit(Category& cat, size_t off, size_t removed, const string& ins)
+    {
+        Clock::time_point t0 = Clock::now();
+        doc.edit(off, removed, ins);
+        cat.latency.push_back(seconds(t0));
+        text.replace(off, removed, ins);
+        const Document::EditStats& st = doc.lastEdit();
+        if (st.kind == Document::EditStats::FULL) ++cat.full;
+        cat.relexed += st.relexed;
+        if (!check) return;
+        Document fresh(text);
+        if (snapshot(doc) != snapshot(fresh) && ++mismatches <= 3)
+            cerr << "不一致：" << cat.name << " 偏移 " << off << " 删除 " << removed << " 插入 \"" << ins << "\"\n";
+    }
+};
+
+/* 随机一条赋值语句：返回 ":=" 之后第一个 ';' 或换行的偏移，name 为被赋值的变量 */
+static bool pickAssignment(const string& text, mt19937& rng, size_t& end, string& name)
+{
+    for (int tries = 0; tries < 100; ++tries) {
+        size_t at = text.find(":=", rng() % text.size());
+        if (at == string::npos) continue;
+        size_t b = at;
+        while (b > 0 && text[b - 1] == ' ') --b;
+        size_t a = b;
+        while (a > 0 && isalnum(static_cast<unsigned char>(text[a - 1]))) --a;
+        end = text.find_first_of(";\n", at);
+        if (a == b || end == string::npos || text[end] != ';') continue;
+        name = text.substr(a, b - a);
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    int edits = 200;
+    bool check = false;
+    vector<size_t> sizes = { 64 << 10, 1 << 20, 4 << 20 };
+    GenOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--edits") && i + 1 < argc) edits = max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--check")) check = true;
+        else if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            sizes.clear();
+            for (char* s = strtok(argv[++i], ","); s; s = strtok(0, ",")) sizes.push_back(parseSize(s));
+        } else if (!parseGenOption(argc, argv, i, opt)) {
+            cerr << "未知选项 " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    printf("%-10s %-6s %10s %8s %10s %10s %10s %6s %12s\n",
+           "大小", "编辑", "整篇 ms", "次数", "中位 µs", "p99 µs", "最大 µs", "整篇", "平均重分析B");
+    int mismatches = 0;
+    for (size_t size : sizes) {
+        GenOptions o = opt;
+        o.size = size;
+        string src = ProgramGenerator(o).generate();
+
+        vector<double> full;
+        for (int r = 0; r < 5; ++r) {
+            Clock::time_point t0 = Clock::now();
+            Document d(src);
+            full.push_back(seconds(t0));
+        }
+        double fullMs = percentile(full, 0.5) * 1e3;
+
+        Bench b(src);
+        b.check = check;
+        mt19937 rng(o.seed);
+        Category cats[3] = { Category("输入"), Category("换行"), Category("整句") };
+        for (int k = 0; k < edits; ++k) {
+            size_t end;
+            string name;
+            if (!pickAssignment(b.text, rng, end, name)) break;
+            const string typed = " + 1";
+            for (size_t j = 0; j < typed.size(); ++j) b.edit(cats[0], end + j, 0, typed.substr(j, 1));
+            for (size_t j = typed.size(); j-- > 0;) b.edit(cats[0], end + j, 1, "");
+
+            b.edit(cats[1], end + 1, 0, "\n");
+            b.edit(cats[1], end + 1, 1, "");
+
+            string stmt = "\n  " + name + " := " + name + " + 1;";
+            b.edit(cats[2], end + 1, 0, stmt);
+            b.edit(cats[2], end + 1, stmt.size(), "");
+        }
+        char label[32];
+        snprintf(label, sizeof label, "%zuK", src.size() >> 10);
+        for (const Category& c : cats) {
+            size_t n = c.latency.size();
+            printf("%-10s %-6s %10.2f %8zu %10.1f %10.1f %10.1f %6d %12zu\n", label, c.name, fullMs, n,
+                   percentile(c.latency, 0.5) * 1e6, percentile(c.latency, 0.99) * 1e6,
+                   percentile(c.latency, 1.0) * 1e6, c.full, n ? c.relexed / n : 0);
+        }
+        mismatches += b.mismatches;
+    }
+    if (check) printf("校验：%s\n", mismatches ? "不一致" : "与整篇分析一致");
+    return mismatches ? 1 : 0;
+}
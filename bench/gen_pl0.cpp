@@ -0,0 +1,47 @@
+#include <fstream>
+#include <iostream>
+
+#include "pl0gen.h"
+
+using namespace std;
+
+/*
+ * 合成 PL/0 程序生成器
+ * 用法: ./gen_pl0 [选项] [输出文件]      缺省写标准输出
+ *   --seed N        随机种子（默认 1）
+ *   --size N        目标字节数，可带 K/M 后缀（默认 1M）
+ *   --depth N       begin/end、if、while 的最大嵌套深度（默认 4）
+ *   --proc-depth N  procedure 的最大嵌套深度（默认 2）
+ *   --procs N       每个分程序声明的过程数（默认 3）
+ *   --expr N        一个表达式最多几项（默认 6）
+ *   --idents N      每个分程序声明的常量与变量数（默认 16）
+ *   --comments N    每条语句前出现注释的百分比（默认 10）
+ *   --numbers N     因子另以此百分比直接取常数（默认 0）
+ */
+
+int main(int argc, char* argv[])
+{
+    GenOptions opt;
+    string outPath;
+    for (int i = 1; i < argc; ++i) {
+        if (parseGenOption(argc, argv, i, opt)) continue;
+        if (argv[i][0] == '-' && argv[i][1] == '-') {
+            cerr << "未知选项 " << argv[i] << endl;
+            return 1;
+        }
+        outPath = argv[i];
+    }
+
+    string program = ProgramGenerator(opt).generate();
+    if (outPath.empty()) {
+        cout.write(program.data(), program.size());
+        return 0;
+    }
+    ofstream out(outPath, ios::binary);
+    if (!out) {
+        cerr << "error:无法打开文件 " << outPath << endl;
+        return 1;
+    }
+    out.write(program.data(), program.size());
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <map>
+#include <random>
+#include <unordered_map>
+
+#include "../lexier/lexer.h"
+
+/*
+ * 关键字识别微基准：标识符密集的输入上，比较
+ *   旧做法  map<string,string> 查关键字 + unordered_map 由种类名得到 Tok
+ *   新做法  lookupKeyword() 编译期完美哈希，一次探测
+ * 并给出 Lexer 在同一份输入上的吞吐。
+ *
+ * 用法: ./keyword_bench [单词数] [随机种子]
+ */
+
+typedef chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0)
+{
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+/* 生成单词表：约三分之一是关键字，其余为 1~10 个字符的标识符 */
+static vector<string> makeWords(size_t n, unsigned seed)
+{
+    static const char* const kw[] = {
+        "begin", "call", "const", "do", "end", "if", "else", "odd",
+        "procedure", "read", "var", "while", "write", "then"
+    };
+    mt19937 rng(seed);
+    vector<string> words;
+    words.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (rng() % 3 == 0) {
+            words.push_back(kw[rng() % 14]);
+        } else {
+            string w(1 + rng() % MAXIDLEN, 'a');
+            for (auto& c : w) c = static_cast<char>('a' + rng() % 26);
+            words.push_back(w);
+        }
+    }
+    return words;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], 0, 10) : 2000000;
+    unsigned seed = argc > 2 ? strtoul(argv[2], 0, 10) : 1;
+    const int rounds = 5;
+
+    vector<string> words = makeWords(n, seed);
+
+    /* 旧做法的两张表 */
+    map<string, string> oldKeywords = {
+        {"begin", "beginsym"}, {"call", "callsym"}, {"const", "constsym"}, {"do", "dosym"},
+        {"end", "endsym"}, {"if", "ifsym"}, {"else", "elsesym"}, {"odd", "oddsym"},
+        {"procedure", "proceduresym"}, {"read", "readsym"}, {"var", "varsym"},
+        {"while", "whilesym"}, {"write", "writesym"}, {"then", "thensym"}
+    };
+    unordered_map<string, Tok> oldNames;
+    for (int i = 0; i < TOK_COUNT - 1; ++i) oldNames[tokName(static_cast<Tok>(i))] = static_cast<Tok>(i);
+
+    double tOld = 1e9, tNew = 1e9;
+    unsigned long sumOld = 0, sumNew = 0;
+    for (int r = 0; r < rounds; ++r) {
+        Clock::time_point t0 = Clock::now();
+        sumOld = 0;
+        for (const string& w : words) {
+            auto it = oldKeywords.find(w.c_str());
+            Tok k = it == oldKeywords.end() ? Tok::IDENT : oldNames.find(it->second)->second;
+            sumOld += static_cast<unsigned>(k);
+        }
+        tOld = min(tOld, seconds(t0));
+
+        t0 = Clock::now();
+        sumNew = 0;
+        for (const string& w : words)
+            sumNew += static_cast<unsigned>(lookupKeyword(w.data(), w.size()));
+        tNew = min(tNew, seconds(t0));
+    }
+    if (sumOld != sumNew) {
+        cerr << "结果不一致\n";
+        return 1;
+    }
+
+    /* 同一批单词拼成源程序，测词法分析吞吐 */
+    string src;
+    for (const string& w : words) { src += w; src += ' '; }
+    double tLex = 1e9;
+    size_t ntok = 0;
+    for (int r = 0; r < rounds; ++r) {
+        Clock::time_point t0 = Clock::now();
+        Lexer lx(src);
+        Token tok;
+        ntok = 0;
+        while (lx.next(tok)) ++ntok;
+        tLex = min(tLex, seconds(t0));
+    }
+
+    printf("单词数 %zu，取 %d 轮最好成绩\n", n, rounds);
+    printf("  map + unordered_map : %7.2f ns/词\n", tOld * 1e9 / n);
+    printf("  完美哈希            : %7.2f ns/词  (%.1fx)\n", tNew * 1e9 / n, tOld / tNew);
+    printf("  Lexer               : %7.1f MB/s, %zu 个记号\n", src.size() / tLex / 1e6, ntok);
+    return 0;
+}
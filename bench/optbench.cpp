@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../lexier/lexer.h"
+#include "../parser/parser.h"
+#include "../vm/codegen.h"
+#include "../vm/ir.h"
+
+using namespace std;
+
+/*
+ * 编译后端基准：深嵌套与平坦输入
+ * 对几种形状的合成程序各自分析一次，再分别计时直接生成 P-code（CodeGen）与 -O 的流水线
+ * （转中间表示、优化、由中间表示生成 P-code），预热一轮后取 --runs 轮的中位数。
+ * 每种嵌套形状与同样语句数的平坦程序相比，报告每个语法树结点的耗时及其倍数；
+ * 某一遍若对嵌套深度是平方的代价，倍数会随 --depth 增大而增大。
+ *
+ * 用法: ./optbench [--runs N] [--depth N] [--check]
+ *   --depth N  嵌套层数，也是平坦程序的语句数（默认 20000）
+ *   --check    任一嵌套形状 -O 的每结点耗时超过平坦程序的 MAX_RATIO 倍时以 1 退出
+ */
+
+typedef chrono::steady_clock Clock;
+
+static const double MAX_RATIO = 4;
+
+static double seconds(Clock::time_point t0)
+{
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static double medianOf(vector<double> t)
+{
+    sort(t.begin(), t.end());
+    return t.size() % 2 ? t[t.size() / 2] : (t[t.size() / 2 - 1] + t[t.size() / 2]) / 2;
+}
+
+/* 预热一轮后运行 runs 轮，返回中位秒数 */
+template <class F>
+static double measure(int runs, F body)
+{
+    vector<double> t;
+    for (int r = 0; r <= runs; ++r) {
+        Clock::time_point t0 = Clock::now();
+        body();
+        if (r) t.push_back(seconds(t0));
+    }
+    return medianOf(t);
+}
+
+static string repeat(const char* s, int n)
+{
+    string out;
+    out.reserve(strlen(s) * n);
+    for (int i = 0; i < n; ++i) out += s;
+    return out;
+}
+
+/* 显示宽度：汉字与全角符号（UTF-8 三字节）占两列 */
+static int displayWidth(const char* s)
+{
+    int w = 0;
+    for (const char* c = s; *c; ++c) {
+        unsigned char b = static_cast<unsigned char>(*c);
+        if (b < 0x80) w += 1;
+        else if (b >= 0xE0) w += 2;
+    }
+    return w;
+}
+
+/* 按显示宽度左、右对齐到 width 列 */
+static string padRight(const char* s, int width)
+{
+    return s + string(max(0, width - displayWidth(s)), ' ');
+}
+
+static string padLeft(const char* s, int width)
+{
+    return string(max(0, width - displayWidth(s)), ' ') + s;
+}
+
+struct Shape {
+    const char* name;
+    string source;
+};
+
+/* 平坦的放在最前，作为比较的基准；y 由 read 读入，条件在编译期未知 */
+static vector<Shape> shapes(int n)
+{
+    const string head = "var x, y;\nbegin\n  read(y);\n";
+    const string tail = "  write(x)\nend.\n";
+    vector<Shape> s;
+    s.push_back(Shape{ "平坦 if", head + repeat("  if y = 0 then x := x + 1;\n", n) + tail });
+    s.push_back(Shape{ "嵌套 if（变量条件）", head + repeat("if y = 0 then\n", n) + "  x := 1;\n" + tail });
+    s.push_back(Shape{ "嵌套 if（常数条件）", head + repeat("if 1 = 1 then\n", n) + "  x := 1;\n" + tail });
+    s.push_back(Shape{ "嵌套 while", head + repeat("while y = 0 do\n", n) + "  y := 1;\n" + tail });
+    s.push_back(Shape{ "嵌套括号", head + "  x := " + repeat("(", n) + "y + 1" + repeat(")", n) + ";\n" + tail });
+    return s;
+}
+
+int main(int argc, char* argv[])
+{
+    int runs = 3, depth = 20000;
+    bool check = false;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--runs" && i + 1 < argc) runs = max(1, atoi(argv[++i]));
+        else if (a == "--depth" && i + 1 < argc) depth = max(1, atoi(argv[++i]));
+        else if (a == "--check") check = true;
+        else {
+            cerr << "用法: " << argv[0] << " [--runs N] [--depth N] [--check]\n";
+            return 1;
+        }
+    }
+
+    printf("嵌套 %d 层，每种形状 %d 轮\n", depth, runs);
+    printf("%s %s %10s %10s %s %s\n", padRight("形状", 20).c_str(), padLeft("结点", 9).c_str(), "P-code ms", "-O ms",
+           padLeft("-O ns/结点", 11).c_str(), padLeft("倍数", 8).c_str());
+
+    double flat = 0;
+    int failed = 0;
+    for (const Shape& s : shapes(depth)) {
+        Lexer lx(s.source);
+        Parser p(lx);
+        const Ast& ast = p.parse();
+        if (p.getErrorCount()) {
+            cerr << s.name << ": 合成程序有错误\n";
+            return 1;
+        }
+        double plain = measure(runs, [&] {
+            CodeGen gen;
+            gen.generate(ast);
+        });
+        double optimized = measure(runs, [&] {
+            IrProgram ir;
+            lowerToIr(ast, ir);
+            Optimizer().run(ir);
+            Program prog;
+            emitPcode(ir, prog);
+        });
+        double perNode = optimized / ast.size() * 1e9;
+        if (flat == 0) flat = perNode;
+        double ratio = perNode / flat;
+        bool bad = ratio > MAX_RATIO;
+        failed += bad;
+        printf("%s %9zu %10.2f %10.2f %11.1f %7.1fx%s\n", padRight(s.name, 20).c_str(), ast.size(), plain * 1e3, optimized * 1e3,
+               perNode, ratio, bad ? "  !" : "");
+    }
+    return check && failed ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../lexier/lexer.h"
+#include "../lexier/source.h"
+#include "../lexier/tokfile.h"
+#include "../parser/parser.h"
+#include "pl0gen.h"
+
+using namespace std;
+
+/*
+ * 词法/语法分析基准套件
+ * 用生成器按种子造出合成负载，分别测
+ *   词法   Lexer 从内存缓冲区取尽记号，MB/s
+ *   语法   Parser 消费预先取好的记号并建好语法树，记号/s
+ *   打印   把建好的语法树以缩进文本写出（输出丢弃），结点/s
+ *   端到端 打开源文件 + 词法 + 语法 + 打印的总耗时
+ *   峰值内存 新起一个子进程（重新 exec 本程序）跑一遍端到端，取其最大常驻集
+ * 每项先预热一轮，再测若干轮，报告最小值、中位数、平均值与相对标准差。
+ *
+ * 用法: ./pl0bench [--runs N] [--preset 名字] [--keep 目录] [生成器选项]
+ *   --runs N       每项测量的轮数（默认 7）
+ *   --preset 名字  只跑一个预置负载：small medium large deep comments wide numbers
+ *   --keep 目录    把生成的负载留在该目录下，便于复现
+ *   其余选项同 gen_pl0（--seed --size --depth ...），给出时只跑这一个自定义负载
+ */
+
+typedef chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0)
+{
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+/* 一组测量值的统计 */
+struct Stats {
+    double min = 0, median = 0, mean = 0, rsd = 0;     // rsd 为相对标准差（%）
+
+    explicit Stats(vector<double> v)
+    {
+        if (v.empty()) return;
+        sort(v.begin(), v.end());
+        min = v.front();
+        median = v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+        for (double x : v) mean += x;
+        mean /= v.size();
+        double var = 0;
+        for (double x : v) var += (x - mean) * (x - mean);
+        rsd = v.size() > 1 && mean > 0 ? sqrt(var / (v.size() - 1)) / mean * 100 : 0;
+    }
+};
+
+/* 预热一轮后测 runs 轮，返回每轮秒数 */
+template <class F>
+static vector<double> measure(int runs, F body)
+{
+    body();
+    vector<double> t;
+    for (int r = 0; r < runs; ++r) {
+        Clock::time_point t0 = Clock::now();
+        body();
+        t.push_back(seconds(t0));
+    }
+    return t;
+}
+
+/* 丢弃一切写入，语法树打印的格式化开销仍然计入 */
+class NullBuf : public streambuf {
+protected:
+    int overflow(int c) override { return c == EOF ? 0 : c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+static size_t lexAll(const char* data, size_t size)
+{
+    Lexer lx(data, size);
+    Token tok;
+    size_t n = 0;
+    while (lx.next(tok)) ++n;
+    return n;
+}
+
+/* 预先取尽记号存入 TokenFile，语法分析轮次只消费内存中的记号 */
+static void tokenize(const string& src, TokenFile& tf)
+{
+    Lexer lx(src);
+    Token tok;
+    tf.lexOff.push_back(0);
+    while (lx.next(tok)) {
+        Lexeme l = lx.lexeme(tok);
+        tf.kinds.push_back(tok.kind);
+        tf.lexIds.push_back(static_cast<uint32_t>(tf.lexOff.size() - 1));
+        tf.pool.append(l.ptr, l.len);
+        tf.lexOff.push_back(static_cast<uint32_t>(tf.pool.size()));
+    }
+}
+
+static void endToEnd(const string& path)
+{
+    SourceBuffer source;
+    string why;
+    if (!source.open(path, why)) {
+        cerr << "error:" << why << endl;
+        exit(1);
+    }
+    Lexer lx(source.data(), source.size());
+    Parser p(lx);
+    printTree(p.parse(), cout);
+}
+
+static const char* selfPath = "./pl0bench";
+
+/*
+ * 在子进程里跑一遍端到端，返回其峰值常驻内存（KiB），失败返回 -1。
+ * 子进程重新 exec 本程序，不继承父进程里的负载与记号，量到的只是编译器本身。
+ */
+static long peakRssKiB(const string& path)
+{
+    cout.flush();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execl(selfPath, selfPath, "--e2e-child", path.c_str(), (char*)0);
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;     // macOS 以字节为单位
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+struct Workload {
+    const char* name;
+    GenOptions opt;
+};
+
+static vector<Workload> presets()
+{
+    vector<Workload> w;
+    GenOptions o;
+    o.size = 64 << 10;
+    w.push_back(Workload{ "small", o });
+    o.size = 4 << 20;
+    w.push_back(Workload{ "medium", o });
+    o.size = 32 << 20;
+    w.push_back(Workload{ "large", o });
+    o = GenOptions();
+    o.size = 4 << 20; o.depth = 24; o.procDepth = 6; o.procs = 2;
+    w.push_back(Workload{ "deep", o });
+    o = GenOptions();
+    o.size = 4 << 20; o.comments = 70;
+    w.push_back(Workload{ "comments", o });
+    o = GenOptions();
+    o.size = 4 << 20; o.exprTerms = 24; o.idents = 200;
+    w.push_back(Workload{ "wide", o });
+    o = GenOptions();
+    o.size = 4 << 20; o.exprTerms = 24; o.numbers = 80;
+    w.push_back(Workload{ "numbers", o });
+    return w;
+}
+
+static void row(const char* what, const Stats& s, double work, const char* unit)
+{
+    printf("  %-8s 最小 %9.2f ms  中位 %9.2f ms  平均 %9.2f ms  ±%4.1f%%   %10.1f %s\n",
+           what, s.min * 1e3, s.median * 1e3, s.mean * 1e3, s.rsd, work / s.median, unit);
+}
+
+static void runWorkload(const Workload& w, int runs, const string& keepDir)
+{
+    Clock::time_point t0 = Clock::now();
+    string src = ProgramGenerator(w.opt).generate();
+    double genTime = seconds(t0);
+
+    string path = keepDir.empty() ? "/tmp/pl0bench_" + to_string(getpid()) + "_" + w.name + ".pl0"
+                                  : keepDir + "/" + w.name + ".pl0";
+    {
+        ofstream out(path, ios::binary);
+        out.write(src.data(), src.size());
+    }
+
+    TokenFile tf;
+    tokenize(src, tf);
+
+    printf("[%s] seed=%u size=%zu depth=%d proc-depth=%d procs=%d expr=%d idents=%d comments=%d numbers=%d\n",
+           w.name, w.opt.seed, src.size(), w.opt.depth, w.opt.procDepth, w.opt.procs,
+           w.opt.exprTerms, w.opt.idents, w.opt.comments, w.opt.numbers);
+    printf("  %zu 字节，%zu 个记号，生成耗时 %.1f ms\n", src.size(), tf.size(), genTime * 1e3);
+
+    size_t ntok = 0;
+    Stats lex(measure(runs, [&] { ntok = lexAll(src.data(), src.size()); }));
+    row("词法", lex, src.size() / 1e6, "MB/s");
+    if (ntok != tf.size()) {
+        cerr << "记号数不一致：" << ntok << " / " << tf.size() << endl;
+        exit(1);
+    }
+
+    Stats parse(measure(runs, [&] {
+        TokenFileSource ts(tf);
+        Parser p(ts);
+        p.parse();
+    }));
+    row("语法", parse, tf.size() / 1e6, "M记号/s");
+
+    TokenFileSource ts(tf);
+    Parser p(ts);
+    const Ast& ast = p.parse();
+    NullBuf null;
+    streambuf* saved = cout.rdbuf(&null);
+    Stats print(measure(runs, [&] { printTree(ast, cout); }));
+    Stats e2e(measure(runs, [&] { endToEnd(path); }));
+    cout.rdbuf(saved);
+    row("打印", print, ast.size() / 1e6, "M结点/s");
+    row("端到端", e2e, src.size() / 1e6, "MB/s");
+
+    long rss = peakRssKiB(path);
+    if (rss >= 0)
+        printf("  峰值内存 %.1f MiB（子进程端到端）\n", rss / 1024.0);
+    else
+        printf("  峰值内存 测量失败\n");
+
+    if (keepDir.empty()) unlink(path.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    selfPath = argv[0];
+    if (argc == 3 && !strcmp(argv[1], "--e2e-child")) {
+        static NullBuf null;        // 退出时 cout 还会刷新，须活到最后
+        cout.rdbuf(&null);
+        endToEnd(argv[2]);
+        return 0;
+    }
+
+    int runs = 7;
+    string preset, keepDir;
+    GenOptions custom;
+    bool haveCustom = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--preset") && i + 1 < argc) preset = argv[++i];
+        else if (!strcmp(argv[i], "--keep") && i + 1 < argc) keepDir = argv[++i];
+        else if (parseGenOption(argc, argv, i, custom)) haveCustom = true;
+        else {
+            cerr << "未知选项 " << argv[i] << endl;
+            return 1;
+        }
+    }
+    if (runs < 1) runs = 1;
+
+    vector<Workload> todo;
+    if (haveCustom) {
+        todo.push_back(Workload{ "custom", custom });
+    } else {
+        for (const Workload& w : presets())
+            if (preset.empty() || preset == w.name) todo.push_back(w);
+        if (todo.empty()) {
+            cerr << "没有名为 " << preset << " 的预置负载" << endl;
+            return 1;
+        }
+    }
+
+    printf("每项预热 1 轮后测 %d 轮，吞吐按中位数计算\n", runs);
+    for (const Workload& w : todo)
+        runWorkload(w, runs, keepDir);
+    return 0;
+}
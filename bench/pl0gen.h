@@ -0,0 +1,333 @@
+#ifndef PL0_BENCH_GEN_H
+#define PL0_BENCH_GEN_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 合成负载的形状
+ * 同一组参数与种子总是生成同一份程序。
+ */
+struct GenOptions {
+    unsigned seed = 1;
+    size_t size = 1 << 20;      // 目标字节数，生成到不小于它的第一个语句边界为止
+    int depth = 4;              // begin/end、if、while 语句的最大嵌套深度
+    int procDepth = 2;          // procedure 的最大嵌套深度
+    int procs = 3;              // 每个分程序声明的过程数
+    int exprTerms = 6;          // 一个表达式最多几项
+    int idents = 16;            // 每个分程序声明的常量与变量数
+    int comments = 10;          // 每条语句前出现注释的百分比
+    int numbers = 0;            // 因子另以此百分比直接取常数，模拟数据表一类常数密集的代码
+};
+
+/**
+ * @brief 种子确定的 PL/0 程序生成器
+ * 生成的程序语法正确，并且只使用作用域内声明过的名字：
+ * 赋值与 read 只写变量，call 只调用可见的过程，表达式只读可见的常量与变量。
+ * 标识符不超过 10 个字符，常数不超过 5 位，不会触发词法错误。
+ */
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator(const GenOptions& opt) : opt(opt), rng(opt.seed) {}
+
+    std::string generate()
+    {
+        out.clear();
+        out.reserve(opt.size + 4096);
+        scopes.clear();
+        nameCounter = 0;
+        topLevel = true;
+        block(0);
+        out += ".\n";
+        return out;
+    }
+
+private:
+    struct Scope {
+        std::vector<std::string> consts, vars, procs;
+    };
+
+    GenOptions opt;
+    std::mt19937 rng;
+    std::string out;
+    std::vector<Scope> scopes;
+    unsigned nameCounter = 0;
+    int indent = 0;
+    bool topLevel = true;
+
+    int pick(int n) { return n > 0 ? static_cast<int>(rng() % static_cast<unsigned>(n)) : 0; }
+    bool chance(int pct) { return pick(100) < pct; }
+
+    /* 新名字：前缀 + 层次 + 序号，最长 10 个字符 */
+    std::string fresh(char prefix)
+    {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%c%ux%u", prefix, static_cast<unsigned>(scopes.size()),
+                      nameCounter++ % 100000u);
+        return buf;
+    }
+
+    /* 从所有可见作用域中随机取一个名字，内层优先 */
+    const std::string* visible(std::vector<std::string> Scope::*which)
+    {
+        for (int tries = 0; tries < 4; ++tries) {
+            const Scope& s = scopes[scopes.size() - 1 - pick(static_cast<int>(scopes.size()))];
+            const std::vector<std::string>& names = s.*which;
+            if (!names.empty()) return &names[pick(static_cast<int>(names.size()))];
+        }
+        for (size_t k = scopes.size(); k-- > 0; ) {
+            const std::vector<std::string>& names = scopes[k].*which;
+            if (!names.empty()) return &names[pick(static_cast<int>(names.size()))];
+        }
+        return nullptr;
+    }
+
+    void newline()
+    {
+        out += '\n';
+        out.append(static_cast<size_t>(indent) * 2, ' ');
+    }
+
+    void comment()
+    {
+        static const char* const words[] = {
+            "loop", "counter", "update", "check", "the", "result", "value", "next", "sum", "temp"
+        };
+        out += "{ ";
+        int n = 2 + pick(10);
+        for (int k = 0; k < n; ++k) {
+            out += words[pick(10)];
+            if (k + 1 < n && chance(10)) newline(); else out += ' ';
+        }
+        out += '}';
+        newline();
+    }
+
+    void number() { out += std::to_string(pick(100000)); }
+
+    void block(int level)
+    {
+        scopes.emplace_back();
+        int nConst = 1 + opt.idents / 4, nVar = opt.idents > nConst ? opt.idents - nConst : 1;
+
+        out += "const ";
+        for (int k = 0; k < nConst; ++k) {
+            std::string name = fresh('c');
+            if (k) out += ", ";
+            out += name + " = ";
+            number();
+            scopes.back().consts.push_back(name);
+        }
+        out += ';';
+        newline();
+        out += "var ";
+        for (int k = 0; k < nVar; ++k) {
+            std::string name = fresh('v');
+            if (k) out += ", ";
+            out += name;
+            scopes.back().vars.push_back(name);
+        }
+        out += ';';
+        newline();
+
+        if (level < opt.procDepth) {
+            for (int k = 0; k < opt.procs; ++k) {
+                std::string name = fresh('p');
+                scopes.back().procs.push_back(name);    // 过程体内可以递归调用自己
+                out += "procedure " + name + ';';
+                ++indent;
+                newline();
+                bool wasTop = topLevel;
+                topLevel = false;
+                block(level + 1);
+                topLevel = wasTop;
+                --indent;
+                out += ';';
+                newline();
+            }
+        }
+
+        // 主程序的语句体一直生成到目标大小，过程体只生成几条
+        out += "begin";
+        ++indent;
+        newline();
+        if (topLevel) {
+            bool first = true;
+            while (out.size() < opt.size || first) {
+                if (!first) { out += ';'; newline(); }
+                statement(1);
+                first = false;
+            }
+        } else {
+            int n = 1 + pick(4);
+            for (int k = 0; k < n; ++k) {
+                if (k) { out += ';'; newline(); }
+                statement(1);
+            }
+        }
+        --indent;
+        newline();
+        out += "end";
+        scopes.pop_back();
+    }
+
+    void statement(int depth)
+    {
+        if (chance(opt.comments)) comment();
+        bool nest = depth < opt.depth;
+        int kind = pick(nest ? 9 : 5);
+        const std::string* name;
+        switch (kind) {
+        case 0: case 1:
+        default:
+            name = visible(&Scope::vars);
+            out += *name + " := ";
+            expression(0);
+            break;
+        case 2:
+            name = visible(&Scope::procs);
+            if (!name) { statement(depth); return; }
+            out += "call " + *name;
+            break;
+        case 3:
+            out += "read(" + *visible(&Scope::vars) + ')';
+            break;
+        case 4:
+            out += "write(";
+            expression(0);
+            out += ')';
+            break;
+        case 5: case 6: {
+            out += "begin";
+            ++indent;
+            newline();
+            int n = 1 + pick(4);
+            for (int k = 0; k < n; ++k) {
+                if (k) { out += ';'; newline(); }
+                statement(depth + 1);
+            }
+            --indent;
+            newline();
+            out += "end";
+            break;
+        }
+        case 7:
+            out += "if ";
+            condition();
+            out += " then";
+            ++indent;
+            newline();
+            statement(depth + 1);
+            --indent;
+            if (chance(30)) {
+                newline();
+                out += "else";
+                ++indent;
+                newline();
+                statement(depth + 1);
+                --indent;
+            }
+            break;
+        case 8:
+            out += "while ";
+            condition();
+            out += " do";
+            ++indent;
+            newline();
+            statement(depth + 1);
+            --indent;
+            break;
+        }
+    }
+
+    void condition()
+    {
+        static const char* const ops[] = { "=", "#", "<", "<=", ">", ">=" };
+        if (chance(15)) {
+            out += "odd ";
+            expression(0);
+            return;
+        }
+        expression(0);
+        out += ' ';
+        out += ops[pick(6)];
+        out += ' ';
+        expression(0);
+    }
+
+    void expression(int nesting)
+    {
+        if (chance(10)) out += '-';
+        int terms = 1 + pick(opt.exprTerms);
+        for (int k = 0; k < terms; ++k) {
+            if (k) out += chance(50) ? " + " : " - ";
+            term(nesting);
+        }
+    }
+
+    void term(int nesting)
+    {
+        factor(nesting);
+        if (chance(30)) {
+            out += chance(50) ? " * " : " / ";
+            factor(nesting);
+        }
+    }
+
+    void factor(int nesting)
+    {
+        if (opt.numbers > 0 && chance(opt.numbers)) {
+            number();
+            return;
+        }
+        int kind = pick(nesting < 2 ? 10 : 9);
+        if (kind < 5) {
+            out += *visible(&Scope::vars);
+        } else if (kind < 7) {
+            const std::string* c = visible(&Scope::consts);
+            out += *c;
+        } else if (kind < 9) {
+            number();
+        } else {
+            out += '(';
+            expression(nesting + 1);
+            out += ')';
+        }
+    }
+};
+
+/* 解析带 K/M 后缀的大小 */
+inline size_t parseSize(const char* s)
+{
+    char* end = 0;
+    size_t n = strtoul(s, &end, 10);
+    if (*end == 'k' || *end == 'K') n <<= 10;
+    if (*end == 'm' || *end == 'M') n <<= 20;
+    return n;
+}
+
+/* 解析一个生成器选项，成功时消耗其参数并返回 true，gen_pl0 与 pl0bench 共用 */
+inline bool parseGenOption(int argc, char* argv[], int& i, GenOptions& opt)
+{
+    if (i + 1 >= argc) return false;
+    const char* a = argv[i];
+    const char* v = argv[i + 1];
+    if (!strcmp(a, "--seed")) opt.seed = strtoul(v, 0, 10);
+    else if (!strcmp(a, "--size")) opt.size = parseSize(v);
+    else if (!strcmp(a, "--depth")) opt.depth = atoi(v);
+    else if (!strcmp(a, "--proc-depth")) opt.procDepth = atoi(v);
+    else if (!strcmp(a, "--procs")) opt.procs = atoi(v);
+    else if (!strcmp(a, "--expr")) opt.exprTerms = atoi(v);
+    else if (!strcmp(a, "--idents")) opt.idents = atoi(v);
+    else if (!strcmp(a, "--comments")) opt.comments = atoi(v);
+    else if (!strcmp(a, "--numbers")) opt.numbers = atoi(v);
+    else return false;
+    ++i;
+    return true;
+}
+
+#endif
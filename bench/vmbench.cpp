@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../lexier/lexer.h"
+#include "../lexier/source.h"
+#include "../parser/parser.h"
+#include "../vm/codegen.h"
+#include "../vm/jit.h"
+#include "../vm/vm.h"
+
+using namespace std;
+
+/*
+ * P-code 虚拟机与即时编译基准
+ * 对每个程序生成一次 P-code，在虚拟机上预热一轮后运行 --runs 轮，write 的输出丢弃；
+ * 报告代码条数、每轮执行的指令数、中位耗时与按中位耗时算出的每秒指令数。
+ * 本平台支持即时编译时，再把同一份 P-code 编译成机器码，分别报告编译耗时与运行的中位耗时，
+ * 以及相对解释执行的加速比。
+ * 程序不能含 read。同一份源码分别以默认方式和 -DPL0_VM_SWITCH 编译，即可比较两种分派。
+ *
+ * 用法: ./vmbench [--runs N] [程序 ...]
+ *   不给程序时跑 programs/ 下的 loop、gcd、primes
+ */
+
+typedef chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0)
+{
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static double medianOf(vector<double> t)
+{
+    sort(t.begin(), t.end());
+    return t.size() % 2 ? t[t.size() / 2] : (t[t.size() / 2 - 1] + t[t.size() / 2]) / 2;
+}
+
+/* 预热一轮后运行 runs 轮，返回每轮秒数；出错时返回空 */
+template <class F>
+static vector<double> measure(int runs, F body)
+{
+    vector<double> t;
+    for (int r = 0; r <= runs; ++r) {
+        Clock::time_point t0 = Clock::now();
+        if (!body()) return vector<double>();
+        if (r) t.push_back(seconds(t0));
+    }
+    return t;
+}
+
+int main(int argc, char* argv[])
+{
+    int runs = 5;
+    vector<string> files;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--runs" && i + 1 < argc) runs = max(1, atoi(argv[++i]));
+        else files.push_back(a);
+    }
+    if (files.empty()) files = { "programs/loop.pl0", "programs/gcd.pl0", "programs/primes.pl0" };
+
+    FILE* sink = fopen("/dev/null", "w");
+    if (!sink) {
+        cerr << "error: 无法打开 /dev/null\n";
+        return 1;
+    }
+    printf("分派方式: %s，即时编译: %s，每个程序 %d 轮\n", VM::dispatch(), Jit::supported() ? "x86-64" : "不支持", runs);
+    printf("%-24s %6s %12s %10s %9s %10s %10s %8s\n",
+           "程序", "代码", "指令/轮", "解释 ms", "M 条/秒", "JIT编译ms", "JIT运行ms", "加速比");
+
+    int failed = 0;
+    for (const string& path : files) {
+        SourceBuffer source;
+        string why;
+        if (!source.open(path, why)) {
+            cerr << "error:" << why << endl;
+            ++failed;
+            continue;
+        }
+        Lexer lx(source.data(), source.size());
+        Parser p(lx);
+        const Ast& ast = p.parse();
+        if (p.getErrorCount()) {
+            cerr << path << ": 有语义错误，跳过\n";
+            ++failed;
+            continue;
+        }
+        CodeGen gen;
+        const Program& prog = gen.generate(ast);
+
+        VM vm;
+        vector<double> t = measure(runs, [&] { return vm.run(prog, stdin, sink, why); });
+        if (t.empty()) {
+            cerr << path << ": 运行错误: " << why << endl;
+            ++failed;
+            continue;
+        }
+        double interp = medianOf(t);
+        printf("%-24s %6zu %12llu %10.2f %9.1f", path.c_str(), prog.code.size(),
+               static_cast<unsigned long long>(vm.steps()), interp * 1e3,
+               interp > 0 ? vm.steps() / interp / 1e6 : 0.0);
+
+        if (Jit::supported()) {
+            Jit jit;
+            Clock::time_point t0 = Clock::now();
+            bool ok = jit.compile(prog, why);
+            double compile = seconds(t0);
+            if (ok) t = measure(runs, [&] { return jit.run(stdin, sink, why); });
+            if (!ok || t.empty()) {
+                printf("\n");
+                cerr << path << ": 即时编译出错: " << why << endl;
+                ++failed;
+                continue;
+            }
+            double native = medianOf(t);
+            printf(" %10.3f %10.2f %7.1fx", compile * 1e3, native * 1e3, native > 0 ? interp / native : 0.0);
+        }
+        printf("\n");
+    }
+    fclose(sink);
+    return failed ? 1 : 0;
+}
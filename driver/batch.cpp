@@ -0,0 +1,305 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../lexier/intern.h"
+#include "../lexier/lexer.h"
+#include "../lexier/profile.h"
+#include "../lexier/source.h"
+#include "../lexier/trace.h"
+#include "../parser/parser.h"
+#include "../vm/codegen.h"
+#include "../vm/ir.h"
+
+/* ------------ 线程池 ------------ */
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    unsigned n = threads ? threads : std::thread::hardware_concurrency();
+    if (n == 0) n = 1;
+    for (unsigned i = 0; i < n; ++i) queues.emplace_back(new Queue);
+    for (unsigned i = 0; i < n; ++i) workers.emplace_back(&WorkStealingPool::worker, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    unsigned q;
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        q = nextQueue;
+        nextQueue = (nextQueue + 1) % queues.size();
+        ++unfinished;
+        ++queued;       // 在 mtx 下增加，休眠的线程检查 queued 与进入等待之间不会漏掉通知
+    }
+    {
+        std::lock_guard<std::mutex> lk(queues[q]->mtx);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    workCv.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    doneCv.wait(lk, [this] { return unfinished == 0; });
+}
+
+/**
+ * @brief
+ * 先按提交顺序从自己队列的头部取，再依次从其他队列的尾部窃取
+ * @return 取到任务时为 true
+ */
+bool WorkStealingPool::take(unsigned self, Task& task)
+{
+    size_t n = queues.size();
+    for (size_t k = 0; k < n; ++k) {
+        Queue& q = *queues[(self + k) % n];
+        std::lock_guard<std::mutex> lk(q.mtx);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        } else {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            ++stolen;
+        }
+        --queued;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::worker(unsigned self)
+{
+    for (;;) {
+        Task task;
+        if (take(self, task)) {
+            task(self);
+            std::lock_guard<std::mutex> lk(mtx);
+            if (--unfinished == 0) doneCv.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mtx);
+        workCv.wait(lk, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+/* ------------ 收集源文件 ------------ */
+
+static bool hasExtension(const std::string& name, const char* ext)
+{
+    size_t n = std::char_traits<char>::length(ext);
+    return name.size() > n && name.compare(name.size() - n, n, ext) == 0;
+}
+
+/* 递归列出目录中的 .pl0 文件；打不开的子目录跳过，指向目录的符号链接不进入，免得成环或重复列出 */
+static bool listDirectory(const std::string& dir, std::vector<std::string>& out)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d) return false;
+    std::vector<std::string> subdirs;
+    while (dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name == "." || name == "..") continue;
+        std::string path = dir + (dir.empty() || dir[dir.size() - 1] != '/' ? "/" : "") + name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) continue;
+        if (S_ISLNK(st.st_mode) && (stat(path.c_str(), &st) != 0 || S_ISDIR(st.st_mode))) continue;
+        if (S_ISDIR(st.st_mode)) subdirs.push_back(path);
+        else if (S_ISREG(st.st_mode) && hasExtension(name, ".pl0")) out.push_back(path);
+    }
+    closedir(d);
+    for (size_t i = 0; i < subdirs.size(); ++i) listDirectory(subdirs[i], out);
+    return true;
+}
+
+bool collectSources(const std::string& arg, std::vector<std::string>& out, std::string& err)
+{
+    if (!arg.empty() && arg[0] == '@') {
+        std::string listPath = arg.substr(1);
+        std::ifstream file;
+        if (listPath != "-") {
+            file.open(listPath.c_str());
+            if (!file) {
+                err = "无法打开文件列表 " + listPath;
+                return false;
+            }
+        }
+        std::istream& in = listPath == "-" ? std::cin : file;
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#') continue;
+            size_t e = line.find_last_not_of(" \t\r");
+            out.push_back(line.substr(b, e - b + 1));
+        }
+        return true;
+    }
+    struct stat st;
+    if (stat(arg.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        size_t first = out.size();
+        if (!listDirectory(arg, out)) {
+            err = "无法打开目录 " + arg;
+            return false;
+        }
+        std::sort(out.begin() + first, out.end());
+        return true;
+    }
+    out.push_back(arg);     // 打不开时记在该文件的结果里
+    return true;
+}
+
+/* ------------ 编译 ------------ */
+
+/**
+ * @brief
+ * 编译一个文件，只读写 r 与本函数内的对象
+ * @param r 结果槽，path 已填好
+ */
+static void compileFile(FileResult& r, const BatchOptions& opt)
+{
+    PL0_ZONE(Zone::COMPILE_FILE);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+
+    SourceBuffer source;
+    std::string why;
+    if (!source.open(r.path, why)) {
+        r.status = FileResult::UNREADABLE;
+        r.diagnostics = why;
+        r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+        return;
+    }
+    r.bytes = source.size();
+
+    // 词法错误攒在本文件的诊断里，不直接写标准错误，免得各线程的输出交错
+    NullSink quiet;
+    StringSink lexDiag;
+    Interner atoms;
+    Parser parser;
+    {
+        Tracer tracer(quiet, lexDiag, TraceLevel::ERROR);
+        Lexer lx(source.data(), source.size(), &tracer);
+        lx.useInterner(atoms);
+        parser.parse(lx);
+        r.lexErrors = lx.errorCount();
+    }
+    r.syntaxErrors = parser.getSyntaxErrorCount();
+    r.errors = parser.getErrorCount();
+
+    std::ostringstream diag;
+    diag << lexDiag.text;
+    parser.writeDiagnostics(diag);
+    r.diagnostics = diag.str();
+
+    if (r.errors == 0) {
+        const Ast& ast = parser.tree();
+        Program prog;
+        if (opt.optimize) {
+            IrProgram ir;
+            {
+                PL0_ZONE(Zone::IR);
+                lowerToIr(ast, ir);
+            }
+            {
+                PL0_ZONE(Zone::OPTIMIZE);
+                Optimizer().run(ir);
+            }
+            PL0_ZONE(Zone::CODEGEN);
+            emitPcode(ir, prog);
+        } else {
+            PL0_ZONE(Zone::CODEGEN);
+            CodeGen gen;
+            prog = gen.generate(ast);
+        }
+        r.instructions = prog.code.size();
+        PL0_COUNT(Counter::PCODE, r.instructions);
+    }
+    r.status = r.errors || r.lexErrors ? FileResult::ERRORS : FileResult::OK;
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+size_t compileBatch(const std::vector<std::string>& paths, const BatchOptions& opt, std::vector<FileResult>& results)
+{
+    results.assign(paths.size(), FileResult());
+    // 大文件先提交，最后剩下的都是小任务，各线程差不多同时做完
+    std::vector<std::pair<off_t, size_t>> order(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        results[i].path = paths[i];
+        struct stat st;
+        order[i] = std::make_pair(stat(paths[i].c_str(), &st) == 0 ? st.st_size : 0, i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<off_t, size_t>& a, const std::pair<off_t, size_t>& b) { return a.first > b.first; });
+
+    WorkStealingPool pool(opt.threads);
+    for (size_t k = 0; k < order.size(); ++k) {
+        FileResult* slot = &results[order[k].second];
+        pool.submit([slot, &opt](unsigned worker) {
+            slot->worker = worker;
+            compileFile(*slot, opt);
+        });
+    }
+    pool.wait();
+    return pool.steals();
+}
+
+/* ------------ 报告 ------------ */
+
+void writeReport(const std::vector<FileResult>& results, std::ostream& out, double wallSeconds,
+                 unsigned threads, size_t steals, bool verbose)
+{
+    size_t ok = 0, failed = 0, unreadable = 0, bytes = 0;
+    double cpu = 0;
+    char line[256];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const FileResult& r = results[i];
+        bytes += r.bytes;
+        cpu += r.seconds;
+        switch (r.status) {
+            case FileResult::OK: ++ok; break;
+            case FileResult::ERRORS: ++failed; break;
+            case FileResult::UNREADABLE: ++unreadable; break;
+        }
+        if (r.status == FileResult::UNREADABLE) {
+            out << r.path << ": 无法读取: " << r.diagnostics << '\n';
+            continue;
+        }
+        if (r.status == FileResult::ERRORS) {
+            std::snprintf(line, sizeof line, ": 词法错误 %zu 个，语法错误 %d 个，语义错误 %d 个\n",
+                          r.lexErrors, r.syntaxErrors, r.errors - r.syntaxErrors);
+            out << r.path << line << r.diagnostics;
+        } else if (verbose) {
+            std::snprintf(line, sizeof line, ": 正确，%zu 字节，P-code %zu 条，%.3f ms（线程 %u）\n",
+                          r.bytes, r.instructions, r.seconds * 1e3, r.worker);
+            out << r.path << line;
+        }
+    }
+    std::snprintf(line, sizeof line,
+                  "共 %zu 个文件：正确 %zu，有错误 %zu，无法读取 %zu；%.1f MiB，"
+                  "耗时 %.3f s（各文件合计 %.3f s），%u 线程，窃取 %zu 次\n",
+                  results.size(), ok, failed, unreadable, bytes / 1048576.0,
+                  wallSeconds, cpu, threads, steals);
+    out << line;
+}
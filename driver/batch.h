@@ -0,0 +1,105 @@
+#ifndef PL0_BATCH_H
+#define PL0_BATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 工作窃取线程池
+ * 每个工作线程有自己的任务队列：提交的任务轮流放进各队列，线程按提交顺序从自己队列的头部取任务，
+ * 自己的队列空了就从别的队列的尾部窃取（即对方最后才会做的任务），耗时不均的任务因此不会堆在某一个线程上。
+ * 各队列各有一把锁，取任务时只锁一个队列；没有任务可取时在条件变量上休眠。
+ */
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned worker)> Task;     // worker 为执行它的线程的编号
+
+    /* threads 为 0 时取硬件线程数 */
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();                // 先做完已提交的任务
+
+    void submit(Task task);
+    /* 阻塞到已提交的任务全部做完 */
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+    /* 从别的线程的队列里取到的任务数 */
+    size_t steals() const { return stolen; }
+
+private:
+    WorkStealingPool(const WorkStealingPool&);            // 不可拷贝
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    bool take(unsigned self, Task& task);
+    void worker(unsigned self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable workCv;     // 有新任务，或者要析构了
+    std::condition_variable doneCv;     // 任务全部做完
+    std::atomic<size_t> queued{0};      // 还在队列里的任务数，增加时持有 mtx
+    size_t unfinished = 0;              // 已提交、未做完的任务数，受 mtx 保护
+    unsigned nextQueue = 0;             // 下一个任务放进哪个队列，受 mtx 保护
+    bool stopping = false;              // 受 mtx 保护
+    std::atomic<size_t> stolen{0};
+};
+
+/* 批量编译中一个文件的结果，由处理它的线程独自填写 */
+struct FileResult {
+    enum Status : unsigned char { OK, ERRORS, UNREADABLE };
+
+    std::string path;
+    Status status = UNREADABLE;
+    size_t bytes = 0;
+    int syntaxErrors = 0;
+    int errors = 0;             // 语法与语义错误的总数
+    size_t lexErrors = 0;       // 词法错误（非法字符等）的条数
+    size_t instructions = 0;    // 生成的 P-code 条数，有错误时为 0
+    double seconds = 0;
+    unsigned worker = 0;
+    std::string diagnostics;    // 词法错误与 Parser::writeDiagnostics() 的输出；无法读取时为原因
+};
+
+struct BatchOptions {
+    unsigned threads = 0;       // 0 取硬件线程数
+    bool optimize = false;      // 经中间表示优化后再生成 P-code
+};
+
+/*
+ * 把一个命令行参数展开为要编译的文件，依次追加到 out：
+ *   目录      递归列出其中扩展名为 .pl0 的文件，按路径排序
+ *   @列表     列表文件每行一个路径，空行与 '#' 开头的行跳过；"@-" 从标准输入读列表
+ *   其他      原样当作一个文件
+ * 目录或列表文件打不开时返回 false，并在 err 中给出原因
+ */
+bool collectSources(const std::string& arg, std::vector<std::string>& out, std::string& err);
+
+/*
+ * 在工作窃取线程池上编译 paths 中的全部文件：每个文件各自做词法分析、语法分析与代码生成，
+ * 各用自己的 Lexer、Parser 与原子表，不共享可变的状态；结果按 paths 的顺序放在 results 中。
+ * 返回线程池窃取任务的次数
+ */
+size_t compileBatch(const std::vector<std::string>& paths, const BatchOptions& opt, std::vector<FileResult>& results);
+
+/*
+ * 汇总报告：按输入顺序列出有错误或无法读取的文件及其诊断（verbose 时每个文件都列一行），
+ * 最后一行为总数、字节数、耗时与线程数
+ */
+void writeReport(const std::vector<FileResult>& results, std::ostream& out, double wallSeconds,
+                 unsigned threads, size_t steals, bool verbose);
+
+#endif
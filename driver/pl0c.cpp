@@ -0,0 +1,245 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "../lexier/lexer.h"
+#include "../lexier/parallel.h"
+#include "../lexier/profile.h"
+#include "../lexier/ring.h"
+#include "../lexier/source.h"
+#include "../parser/parser.h"
+#include "../vm/codegen.h"
+#include "../vm/ir.h"
+#include "../vm/jit.h"
+#include "../vm/vm.h"
+#include "batch.h"
+
+/*
+ * 用法: ./pl0c [-j 线程数] [--dot | --json] [--depth N] [--root ID | --stream] [-O] [--ir | --pcode | --run [--jit]] [--stats] [--profile 文件] <源文件>
+ *   源文件为 "-" 时从标准输入读取
+ *   -j N     分块并行做词法分析，N 为线程数（0 取硬件线程数）
+ *   --dot / --json / --depth / --root  语法树的输出格式与范围，见 ../parser/ast.h
+ *   --stream 输出语法树时边分析边输出：词法分析在后台线程上进行，记号经定长环形缓冲区交给语法分析器，
+ *            结点分析完即回收，语法分析的内存只随嵌套深度增长；不能与 --root 同用
+ *   -O       经中间表示做常量传播、常量折叠、分支化简与死代码删除后再生成 P-code
+ *   --ir     不输出语法树，改为列出中间表示（加 -O 时为优化后的）
+ *   --pcode  不输出语法树，改为列出生成的 P-code
+ *   --run    不输出语法树，生成 P-code 并在虚拟机上运行，read 读标准输入，write 写标准输出
+ *   --jit    与 --run 同用：把 P-code 即时编译成 x86-64 机器码运行，而不是在虚拟机上解释
+ *   --stats  在标准错误给出各优化遍的统计（-O 时），运行结束后给出编译与运行的耗时，
+ *            解释执行时另给出指令数与每秒指令数
+ *   --profile 文件  给各阶段与各文法函数计时、按种类数记号，结束时把 Chrome 跟踪事件格式的 JSON 写到文件，
+ *            汇总表写标准错误，见 ../lexier/profile.h
+ * 在同一进程内完成词法分析与语法分析：语法分析器通过 Lexer 按需拉取记号，
+ * 不生成中间记号文件，也不保存整条记号流。
+ *
+ * 批量模式: ./pl0c --batch [-j 线程数] [-O] [--verbose] [--profile 文件] <文件 | 目录 | @列表文件>...
+ *   在工作窃取线程池上编译全部文件（到生成 P-code 为止），最后给出汇总报告，见 batch.h
+ *   -j N       线程数，缺省或为 0 时取硬件线程数
+ *   --verbose  正确的文件也各列一行
+ *   --profile  同上，各工作线程在跟踪中各占一行
+ * 有文件出错或无法读取时以 1 退出
+ */
+static int batchMain(int argc, char* argv[]){
+    BatchOptions opt;
+    bool verbose = false;
+    vector<string> paths;
+    string why, profilePath;
+    for(int i = 2; i < argc; ++i){
+        string a = argv[i];
+        if(a == "-j" && i + 1 < argc) opt.threads = atoi(argv[++i]);
+        else if(a == "-O") opt.optimize = true;
+        else if(a == "--verbose") verbose = true;
+        else if(a == "--profile" && i + 1 < argc) profilePath = argv[++i];
+        else if(!collectSources(a, paths, why)){
+            cerr << "error:" << why << endl;
+            return 1;
+        }
+    }
+    if(paths.empty()){
+        cerr << "用法: " << argv[0] << " --batch [-j 线程数] [-O] [--verbose] [--profile 文件] <文件 | 目录 | @列表文件>...\n";
+        return 1;
+    }
+    unsigned threads = opt.threads ? opt.threads : thread::hardware_concurrency();
+    opt.threads = threads ? threads : 1;
+
+    ProfileSession profile(profilePath);
+    vector<FileResult> results;
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    size_t steals = compileBatch(paths, opt, results);
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    writeReport(results, cout, wall, opt.threads, steals, verbose);
+    for(size_t i = 0; i < results.size(); ++i)
+        if(results[i].status != FileResult::OK) return 1;
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    if(argc > 1 && string(argv[1]) == "--batch") return batchMain(argc, argv);
+
+    int jobs = -1;              // 小于 0 表示顺序分析
+    enum { TREE, IR, PCODE, RUN } mode = TREE;
+    bool stats = false, jit = false, optimize = false, streaming = false;
+    TreeFormat fmt = TreeFormat::TEXT;
+    TreeLimits lim;
+    string profilePath;
+    int argi = 1;
+    for(; argi < argc - 1; ++argi){
+        string a = argv[argi];
+        if(a == "-j") jobs = atoi(argv[++argi]);
+        else if(a == "-O") optimize = true;
+        else if(a == "--ir") mode = IR;
+        else if(a == "--pcode") mode = PCODE;
+        else if(a == "--run") mode = RUN;
+        else if(a == "--stats") stats = true;
+        else if(a == "--jit") jit = true;
+        else if(a == "--stream") streaming = true;
+        else if(a == "--profile") profilePath = argv[++argi];
+        else if(!parseTreeOption(argc, argv, argi, fmt, lim)) break;
+    }
+    if(argi != argc - 1 || (streaming && (mode != TREE || lim.root != Ast::NIL))){
+        cerr << "用法: " << argv[0] << " [-j 线程数] [--dot | --json] [--depth N] [--root ID | --stream] [-O] [--ir | --pcode | --run [--jit]] [--stats] [--profile 文件] <源文件>\n";
+        return 1;
+    }
+
+    // 在记号来源之前开始计时，分块并行与后台读记号的线程都结束后才输出
+    ProfileSession profile(profilePath);
+
+    // 普通文件只读映射，词法分析直接在映射的字节上进行
+    SourceBuffer source;
+    string why;
+    if(!source.open(argv[argi], why)){
+        cerr << "error:" << why << endl;
+        return 1;
+    }
+
+    unique_ptr<TokenSource> lx;
+    if(streaming){
+        // 后台线程上的词法分析读在前面，其诊断随记号转交，在语法分析器取到该记号时才输出
+        RingCapture capture;
+        Tracer lexTrace(capture.out, capture.diag, TraceLevel::ERROR);
+        if(jobs < 0)
+            lx.reset(new Lexer(source.data(), source.size(), &lexTrace));
+        else
+            lx.reset(new ParallelLexer(source.data(), source.size(), jobs, &lexTrace));
+        unique_ptr<TreeStream> out = streamTree(cout, fmt, lim);
+        Parser p;
+        p.setStream(out.get());
+        {
+            TokenRing ring(*lx, 4096, 64 * 1024, &capture);
+            p.parse(ring);
+        }
+        cout.flush();
+        p.writeDiagnostics(cerr);
+        if(!p.getSyntaxErrorCount()) (fmt == TreeFormat::TEXT ? cout : cerr) << "语法正确\n";
+        return p.getErrorCount() ? 1 : 0;
+    }
+    if(jobs < 0)
+        lx.reset(new Lexer(source.data(), source.size()));
+    else
+        lx.reset(new ParallelLexer(source.data(), source.size(), jobs));
+    Parser p(*lx);
+    const Ast& ast = p.parse();
+    if(mode == TREE){
+        if(!hasRoot(ast, lim)){
+            cerr << "--root " << lim.root << ": 语法树只有 " << ast.size() << " 个结点\n";
+            return 1;
+        }
+        writeTree(ast, cout, fmt, lim);
+        cout.flush();
+        p.writeDiagnostics(cerr);
+        if(!p.getSyntaxErrorCount()) (fmt == TreeFormat::TEXT ? cout : cerr) << "语法正确\n";
+        return p.getErrorCount() ? 1 : 0;   // 有错误时以 1 退出
+    }
+    if(p.getErrorCount()){              // 有错误时不生成代码
+        p.writeDiagnostics(cerr);
+        return 1;
+    }
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+    Program prog;
+    if(optimize || mode == IR){
+        IrProgram ir;
+        {
+            PL0_ZONE(Zone::IR);
+            lowerToIr(ast, ir);
+        }
+        size_t stmts = Optimizer::statements(ir), blocks = Optimizer::blocks(ir);
+        if(optimize){
+            Optimizer opt;
+            {
+                PL0_ZONE(Zone::OPTIMIZE);
+                opt.run(ir);
+            }
+            if(stats){
+                opt.report(stderr);
+                fprintf(stderr, "中间表示: 语句 %zu -> %zu，基本块 %zu -> %zu\n",
+                        stmts, Optimizer::statements(ir), blocks, Optimizer::blocks(ir));
+            }
+        }
+        if(mode == IR){
+            PL0_ZONE(Zone::OUTPUT);
+            printIr(ir, stdout, &lx->interner());
+            return 0;
+        }
+        PL0_ZONE(Zone::CODEGEN);
+        emitPcode(ir, prog);
+    }else{
+        PL0_ZONE(Zone::CODEGEN);
+        CodeGen gen;
+        prog = gen.generate(ast);
+    }
+    double compileSec = chrono::duration<double>(Clock::now() - t0).count();   // 不含数据栈的分配
+    PL0_COUNT(Counter::PCODE, prog.code.size());
+    if(mode == PCODE){
+        PL0_ZONE(Zone::OUTPUT);
+        listCode(prog.code, stdout);
+        return 0;
+    }
+    bool ok;
+    double runSec;
+    if(jit){
+        Jit j;
+        Clock::time_point t1 = Clock::now();
+        bool compiled;
+        {
+            PL0_ZONE(Zone::CODEGEN);
+            compiled = j.compile(prog, why);
+        }
+        if(!compiled){
+            cerr << "即时编译失败: " << why << endl;
+            return 1;
+        }
+        compileSec += chrono::duration<double>(Clock::now() - t1).count();
+        t1 = Clock::now();
+        {
+            PL0_ZONE(Zone::RUN);
+            ok = j.run(stdin, stdout, why);
+        }
+        runSec = chrono::duration<double>(Clock::now() - t1).count();
+        fflush(stdout);
+        if(!ok) cerr << "运行错误: " << why << endl;
+        if(stats)
+            fprintf(stderr, "编译 %.3f ms（机器码 %zu 字节），运行 %.3f ms（即时编译）\n",
+                    compileSec * 1e3, j.codeSize(), runSec * 1e3);
+        return ok ? 0 : 1;
+    }
+    VM vm;
+    Clock::time_point t1 = Clock::now();
+    {
+        PL0_ZONE(Zone::RUN);
+        ok = vm.run(prog, stdin, stdout, why);
+    }
+    runSec = chrono::duration<double>(Clock::now() - t1).count();
+    fflush(stdout);
+    if(!ok) cerr << "运行错误: " << why << endl;
+    if(stats){
+        fprintf(stderr, "编译 %.3f ms，运行 %.3f ms，指令 %llu 条，%.1f M 条/秒（%s）\n",
+                compileSec * 1e3, runSec * 1e3, static_cast<unsigned long long>(vm.steps()),
+                runSec > 0 ? vm.steps() / runSec / 1e6 : 0.0, VM::dispatch());
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+#include "intern.h"
+
+#include <cstring>
+
+const uint32_t Interner::NONE;
+
+Interner::Interner()
+{
+    clear();
+}
+
+/**
+ * @brief
+ * 清空原子表，之前分配的编号全部作废
+ */
+void Interner::clear()
+{
+    pool.clear();
+    off.assign(1, 0);
+    slots.assign(256, Slot{ 0, NONE });
+}
+
+Interner& Interner::global()
+{
+    static Interner table;
+    return table;
+}
+
+/**
+ * @brief
+ * FNV-1a
+ */
+uint32_t Interner::hashOf(const char* s, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t k = 0; k < n; ++k) {
+        h ^= static_cast<unsigned char>(s[k]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief
+ * 线性探测：返回名字所在的槽，名字不在表中时返回探测到的第一个空槽
+ */
+uint32_t Interner::probe(const char* s, size_t n, uint32_t h) const
+{
+    uint32_t mask = static_cast<uint32_t>(slots.size() - 1);
+    for (uint32_t i = h & mask;; i = (i + 1) & mask) {
+        const Slot& sl = slots[i];
+        if (sl.atom == NONE) return i;
+        if (sl.hash == h && off[sl.atom + 1] - off[sl.atom] == n
+            && std::memcmp(pool.data() + off[sl.atom], s, n) == 0)
+            return i;
+    }
+}
+
+/**
+ * @brief
+ * 容量翻倍，按保存的哈希值重新放置，不重算哈希也不比较名字
+ */
+void Interner::grow()
+{
+    std::vector<Slot> old(slots.size() * 2, Slot{ 0, NONE });
+    old.swap(slots);
+    uint32_t mask = static_cast<uint32_t>(slots.size() - 1);
+    for (const Slot& sl : old) {
+        if (sl.atom == NONE) continue;
+        uint32_t i = sl.hash & mask;
+        while (slots[i].atom != NONE) i = (i + 1) & mask;
+        slots[i] = sl;
+    }
+}
+
+/**
+ * @brief
+ * 名字的原子，第一次出现时分配
+ */
+uint32_t Interner::intern(const char* s, size_t n)
+{
+    uint32_t h = hashOf(s, n);
+    uint32_t i = probe(s, n, h);
+    if (slots[i].atom != NONE) return slots[i].atom;
+    if ((size() + 1) * 2 > slots.size()) {
+        grow();
+        i = probe(s, n, h);
+    }
+    uint32_t atom = static_cast<uint32_t>(size());
+    pool.append(s, n);
+    off.push_back(static_cast<uint32_t>(pool.size()));
+    slots[i] = Slot{ h, atom };
+    return atom;
+}
+
+/**
+ * @brief
+ * 名字的原子，不在表中返回 NONE
+ */
+uint32_t Interner::find(const char* s, size_t n) const
+{
+    return slots[probe(s, n, hashOf(s, n))].atom;
+}
+
+/* ------------ 记号来源 ------------ */
+
+TokenSource::TokenSource() : atoms(&Interner::global()) {}
+
+/**
+ * @brief
+ * 默认做法：把词素交给原子表
+ */
+uint32_t TokenSource::atom(const Token& tok)
+{
+    return atoms->intern(lexeme(tok));
+}
@@ -0,0 +1,55 @@
+#ifndef PL0_INTERN_H
+#define PL0_INTERN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "token.h"
+
+/**
+ * @brief 标识符原子表
+ * 每个不同的名字第一次进表时得到一个稳定的 32 位编号（原子），从 0 起连续分配，
+ * 之后同名的标识符总是得到同一个编号，名字本身只存一份。
+ * 语法分析器与符号表比较、散列的都是编号，不再比较字符串；编号连续，可以直接作数组下标。
+ *
+ * 名字首尾相接存放在 pool 中；散列表为开放定址、线性探测，槽里存 (哈希, 编号)，
+ * 装载率不超过 1/2，一次查找通常只比较一次名字。
+ * 不是线程安全的：多个线程各自分析时应各用一个 Interner（见 TokenSource::useInterner）。
+ */
+class Interner {
+public:
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+    Interner();
+
+    /* 名字的原子，第一次出现时分配 */
+    uint32_t intern(const char* s, size_t n);
+    uint32_t intern(Lexeme l) { return intern(l.ptr, l.len); }
+    /* 名字的原子，不在表中返回 NONE */
+    uint32_t find(const char* s, size_t n) const;
+
+    /* 原子对应的名字 */
+    Lexeme name(uint32_t atom) const { return Lexeme{ pool.data() + off[atom], off[atom + 1] - off[atom] }; }
+    size_t size() const { return off.size() - 1; }
+    void clear();
+
+    /* 进程内默认的原子表，未指定 Interner 的记号来源共用它 */
+    static Interner& global();
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t atom;      // NONE 表示空槽
+    };
+
+    std::string pool;               // 名字首尾相接
+    std::vector<uint32_t> off;      // 第 i 个名字为 pool[off[i], off[i+1])
+    std::vector<Slot> slots;        // 容量为 2 的幂
+
+    static uint32_t hashOf(const char* s, size_t n);
+    uint32_t probe(const char* s, size_t n, uint32_t h) const;     // 名字所在或应在的槽
+    void grow();
+};
+
+#endif
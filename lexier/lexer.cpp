@@ -1,398 +1,287 @@
 #include "lexer.h"
 
-void error(int n){
-    printf("Error %3d: %s\n", n, err_msg[n]);
+Lexer::Lexer(const char* src, size_t len, Tracer* tracer)
+    : src(src), len(len), tracer(tracer), scan(scanKernels())
+{
+    memset(cur_token, 0, MAXIDLEN + 1); // 初始化
 }
 
-/**
- * @brief 
- * PL/0词法分析器：DFA实现
- * @param sourceCode 
- * @return vjector<pair<string, string>> 
- */
-vector<pair<string, string>> lexer(const string &sourceCode)
+Lexer::Lexer(const string& src, Tracer* tracer)
+    : Lexer(src.data(), src.size(), tracer) {}
+
+Lexer::Lexer(const char* src, size_t end, const LexStart& at, Tracer* tracer)
+    : Lexer(src, end, tracer)
 {
-    // 结果记录
-    vector<pair<string, string>> tokens;
+    i = at.begin;
+    last = at.last;
+    currentState = at.inComment ? COMMENT : START;
+    currentLine = at.line;
+    lineStart = at.lineStart;
+}
 
-    // --- 添加行号和列号跟踪变量 ---
-    int currentLine = 1;
-    int currentColumn = 1;
-    int tokenStartLine = 1;
-    int tokenStartColumn = 1;
-    // --- 行号列号变量结束 ---
+/**
+ * @brief
+ * 报告词法错误：有 tracer 时交给它的诊断输出端，否则直接写标准错误
+ * @param n 错误号，对应 err_msg
+ */
+void Lexer::error(int n){
+    ++errors;
+    PL0_COUNT(Counter::LEX_ERRORS, 1);
+    if(tracer)
+        tracer->error(n, err_msg[n]);
+    else
+        fprintf(stderr, "Error %3d: %s\n", n, err_msg[n]);
+}
 
-    int cur_num = 0;                    // 识别中的数字
-    float cur_float = 0.0;                // 识别小数字
-    int cur_float_index = 0;            // 小数点后几位
-    int cur_num_len = 0;                // 识别中数字的长度
-    char cur_token[MAXIDLEN + 1];       // 识别中的标识符or关键字
-    int cur_token_index = 0;            // 识别中标识符or关键字的下标
-    memset(cur_token, 0, MAXIDLEN + 1); // 初始化
+/**
+ * @brief
+ * 填写记号，并按需交给 tracer 输出跟踪信息
+ * @param tok 输出
+ * @param kind 种类
+ * @param off 记号在源程序中的起点
+ * @param n 记号在源程序中的长度
+ */
+void Lexer::emit(Token& tok, Tok kind, size_t off, size_t n){
+    tok.kind = kind;
+    tok.off = static_cast<uint32_t>(off);
+    tok.len = static_cast<uint32_t>(n);
+    tok.line = static_cast<uint32_t>(tokenStartLine);
+    tok.col = static_cast<uint16_t>(tokenStartColumn < 0xffff ? tokenStartColumn : 0xffff);
+    PL0_COUNT_TOKEN(kind);
+#if PL0_TRACE_TOKENS
+    if(tracer && tracer->on(TraceLevel::TOKEN))
+        tracer->token(kind, lexeme(tok), tokenStartLine, tokenStartColumn);
+#endif
+}
 
-    currentState = START; // 确保每次调用 lexer 时状态重置
+/**
+ * @brief
+ * 记号的词素：标识符与关键字取转成小写、截断后的 cur_token，
+ * 数字取规范化后的 numLexeme，其余记号直接是源程序中的区间
+ * @param tok 刚由 next() 取出的记号
+ * @return Lexeme 
+ */
+Lexeme Lexer::lexeme(const Token& tok) const{
+    if(tok.kind == Tok::NUMBER)
+        return numLexeme;
+    if(tok.kind <= Tok::IDENT)
+        return Lexeme{ cur_token, static_cast<size_t>(cur_token_index) };
+    return Lexeme{ src + tok.off, tok.len };
+}
 
-    // 按字符读取源程序
-    for (size_t i = 0; i < sourceCode.size(); /* i 在循环内部或回退时管理 */)
-    {
-        char raw_c = sourceCode[i]; // 获取原始字符
-        char c = tolower(raw_c);    // 转小写用于逻辑判断
+/**
+ * @brief
+ * 记录记号起始位置
+ */
+void Lexer::markStart(){
+    tokenStart = i;
+    tokenStartLine = currentLine;
+    tokenStartColumn = static_cast<int>(i - lineStart) + 1;
+}
 
-        // --- 记录 Token 起始位置 ---
-        if (currentState == START && !(isspace(raw_c) || raw_c == '{'))
-        {
-            tokenStartLine = currentLine;
-            tokenStartColumn = currentColumn;
+/**
+ * @brief
+ * 结束 INNUM / INFLOAT / INID / GTR / LES / INBECOMES 中正在识别的记号
+ * @param tok 输出
+ * @param step 结束当前记号的那一项转移
+ * @return true 产生了记号
+ * @return false 没有产生记号（单独的 ':'）
+ */
+bool Lexer::finish(Token& tok, const LexStep& step){
+    currentState = static_cast<state>(step.next);
+    switch(step.action){
+    case A_FINISH_NUM:
+    case A_FINISH_FLOAT:
+        if(num.overflow)
+            error(25); /* 处理错误 */
+        if(num.canonical)   // 多数常数的原文就是规范的，不必格式化
+            numLexeme = Lexeme{ src + tokenStart, i - tokenStart };
+        else{
+            numberText(num, src, tokenStart, numText);
+            numLexeme = Lexeme{ numText.data(), numText.size() };
         }
-        // --- Token 起始位置记录结束 ---
-
-        // 状态转移 (保持原有逻辑)
-        switch (currentState)
-        {
-        case START:
-            if (isspace(raw_c))
-            { /* 跳过 */
-            }
-            else if (raw_c == '{')
-            {
-                currentState = COMMENT;
-            }
-            else if (isdigit(c))
-            {
-                currentState = INNUM;
-                cur_num = c - '0';
-                cur_num_len = 1;
-            }
-            else if (isalpha(c))
-            {
-                currentState = INID;
-                cleanTokenMem(cur_token, cur_token_index);
-                if (cur_token_index < MAXIDLEN)
-                {
-                    cur_token[cur_token_index++] = c;
-                }
-                else
-                {
-                    error(26); /* 处理错误，可能需要跳过 */
-                    // exit(1);
-                }
-            }
-            else if (c == ':')
-            {
-                currentState = INBECOMES;
-            }
-            else if (c == '>')
-            {
-                currentState = GTR;
-            }
-            else if (c == '<')
-            {
-                currentState = LES;
-            }
-            else if (isSingleOperator(c))
-            {
-                currentState = START;
-                string sym(1, c);
-                string type = operators.find(sym)->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << sym << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, sym));
-            }
-            else if (c == ',')
-            {
-                currentState = START;
-                string type = delimiters.find(",")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << "," << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, ","));
-            }
-            else if (c == ';')
-            {
-                currentState = START;
-                string type = delimiters.find(";")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << ";" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, ";"));
-            }
-            else if (c == '=')
-            {
-                currentState = START;
-                string type = operators.find("=")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << "=" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, "="));
-            }
-            else if (c == '(')
-            {
-                currentState = START;
-                string type = delimiters.find("(")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << "(" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, "("));
-            }
-            else if (c == ')')
-            {
-                currentState = START;
-                string type = delimiters.find(")")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << ")" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, ")"));
-            }
-            // --- 添加对句点的处理 ---
-            else if (c == '.')
-            {
-                currentState = START;
-                string type = delimiters.find(".")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << "." << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, "."));
-            }
-            else
-            {
-                cout << "报错字符：" << raw_c << " at Line " << currentLine << ", Column " << currentColumn << endl;
-                error(0);
-                // exit(1); 
-            }
-            break; // START 结束
-
-        case INNUM:
-            if (isdigit(c))
-            {
-                if (cur_num_len >= MAXNUMLEN)
-                {
-                    error(25); /* 处理错误 */
-                    // exit(1);
-                }
-                else
-                {
-                    cur_num = cur_num * 10 + (c - '0');
-                    cur_num_len++;
-                }
-            }else if(c=='.'){
-                // 读取小数点
-                currentState = INFLOAT;
-                cur_float = cur_num;
-
-            }else{
-                currentState = START;
-                string val = to_string(cur_num);
-                // --- 打印信息 ---
-                cout << "Token: (" << number << ", " << val << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(number, val));
-                cur_num = 0;
-                cur_num_len = 0;
-                i--; // 回退
-                currentColumn--;
-            }
-            break; // INNUM 结束
+        emit(tok, Tok::NUMBER, tokenStart, i - tokenStart);
+        return true;
+    case A_FINISH_ID:
+    {
+        cur_token[cur_token_index] = '\0';
+        Tok tokenType = lookupKeyword(cur_token, cur_token_index);
+        if(tokenType == Tok::ENDSYM)
+            currentState = END;
+        // 规范化后的词素留在 cur_token 中，下次进入 INID 时才覆盖
+        emit(tok, tokenType, tokenStart, i - tokenStart);
+        return true;
+    }
+    case A_FINISH_OP:
+        emit(tok, step.kind, tokenStart, 1);
+        return true;
+    default: // A_DROP
+        return false;
+    }
+}
 
-        case INFLOAT:
-           if (isdigit(c))
-            {
-                if (cur_num_len >= MAXNUMLEN)
-                {
-                    error(25); /* 处理错误 */
-                    // exit(1);
-                }
-                else
-                {
-                    cur_float_index--;
-                    cur_float = cur_float + (c - '0') * powf(10, cur_float_index);
-                }
-            }else{
-                currentState = START;
-                string val = to_string(cur_float);
-                // --- 打印信息 ---
-                cout << "Token: (" << number << ", " << val << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(number, val));
-                cur_num = 0;
-                cur_num_len = 0;
-                cur_float = 0.0;
-                cur_float_index=0;
-                i--; // 回退
-                currentColumn--;
-            } 
-            break;
+/**
+ * @brief 
+ * PL/0词法分析器：表驱动的 DFA
+ * 每个字节查一次字符类别表与转移表，按转移项的动作处理；
+ * 结束记号的字符直接交给新状态继续处理，不回退重读。
+ * 源程序末尾若还有未结束的记号，按其后跟一个空白处理。
+ * @param tok 输出
+ * @return true 取得一个记号
+ * @return false 源程序已读完
+ */
+bool Lexer::next(Token& tok)
+{
+    PL0_ZONE(Zone::LEX);
+    if (hasQueued)
+    {
+        tok = queued;
+        hasQueued = false;
+        return true;
+    }
 
-        case COMMENT:
-            if (raw_c == '}')
-            {
-                currentState = START;
-            }
-            break; // COMMENT 结束
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    while (i < len)
+    {
+        unsigned char ch = s[i];
+        unsigned char cls = charClass[ch];
+        const LexStep* step = &lexTable[currentState][cls];
 
-        case INID:
-            if (isalnum(c))
+        // 空白、注释与标识符内部的字符占了绝大多数，交给 scan 内核成段跨过，
+        // 状态与位置放在局部变量里，直到遇到其他动作才落回下面的通用分派
+        if (step->action == A_SKIP || step->action == A_ID_CHAR)
+        {
+            size_t pos = i;
+            state st = currentState;
+            do
             {
-                if (cur_token_index >= MAXIDLEN)
+                size_t run;
+                size_t lines = 0, lastNl = 0;
+                // 下一个字节已不在段内时（如单个空格、短标识符的末字符）不值得调用内核
+                unsigned char after = pos + 1 < len ? charClass[s[pos + 1]] : static_cast<unsigned char>(C_OTHER);
+                if (step->action == A_ID_CHAR)
                 {
-                    error(26); /* 处理错误 */
-                    // exit(1);
+                    run = (after == C_LETTER || after == C_DIGIT) ? scan.alnumRun(s + pos, len - pos) : 1;
+                    size_t keep = static_cast<size_t>(MAXIDLEN - cur_token_index);
+                    if (keep > run)
+                        keep = run;
+                    for (size_t k = 0; k < keep; ++k)
+                        cur_token[cur_token_index++] = s[pos + k] | 0x20; // 字母转小写，数字不变
+                    for (size_t k = keep; k < run; ++k)
+                        error(26); /* 处理错误 */
                 }
-                else
+                else if (st == COMMENT && cls != C_RBRACE)
                 {
-                    cur_token[cur_token_index++] = c;
+                    run = scan.commentRun(s + pos, len - pos, lines, lastNl);
+                    PL0_COUNT(Counter::COMMENT_BYTES, run);
                 }
-            }
-            else
-            {
-                currentState = START;
-                cur_token[cur_token_index] = '\0';
-                string tokenValue = cur_token;
-                string tokenType;
-                if (isKeyword(tokenValue))
+                else if (cls == C_SPACE || cls == C_NEWLINE)
                 {
-                    tokenType = keywords.find(tokenValue)->second;
-                    if (tokenValue == "end")
+                    if (after == C_SPACE || after == C_NEWLINE)
+                        run = scan.spaceRun(s + pos, len - pos, lines, lastNl);
+                    else
                     {
-                        currentState = END;
-                    } 
+                        run = 1;
+                        lines = (ch == '\n');
+                    }
                 }
                 else
+                    run = 1; // 进出注释的 '{' 与 '}'
+                if (lines)
                 {
-                    tokenType = identifier;
+                    currentLine += static_cast<int>(lines);
+                    lineStart = pos + lastNl + 1;
                 }
-                // --- 打印信息 ---
-                cout << "Token: (" << tokenType << ", " << tokenValue << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(tokenType, tokenValue));
-                cleanTokenMem(cur_token, cur_token_index);
-                i--; // 回退
-                currentColumn--;
-            }
-            break; // INID 结束
-
-        case INBECOMES:
-            if (c == '=')
-            {
-                currentState = BECOMES;
-            }
-            else
-            {
-                currentState = START;
-                i--; /* 回退 */
-                currentColumn--;
-            }
-            break; // INBECOMES 结束
+                st = static_cast<state>(step->next);
+                pos += run;
+                if (pos == len)
+                    break;
+                ch = s[pos];
+                cls = charClass[ch];
+                step = &lexTable[st][cls];
+            } while (step->action == A_SKIP || step->action == A_ID_CHAR);
+            i = pos;
+            currentState = st;
+            continue;
+        }
 
-        case GTR:
-            if (c == '=')
-            {
-                currentState = GEQ;
-            }
-            else
-            {
-                currentState = START;
-                string type = operators.find(">")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << ">" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, ">"));
-                i--; // 回退
-                currentColumn--;
-            }
-            break; // GTR 结束
+        bool emitted = false;
 
-        case LES:
-            if (c == '=')
-            {
-                currentState = LEQ;
-            }
-            else if (c == '>')
-            {
-                currentState = NEQ;
-            }
-            else
-            {
-                currentState = START;
-                string type = operators.find("<")->second;
-                // --- 打印信息 ---
-                cout << "Token: (" << type << ", " << "<" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, "<"));
-                i--; // 回退
-                currentColumn--;
-            }
-            break; // LES 结束
+        if (step->action >= A_FINISH_NUM)
+        {
+            emitted = finish(tok, *step);
+            step = &lexTable[currentState][cls];
+        }
+        currentState = static_cast<state>(step->next);
 
-        case BECOMES: // 识别出 :=
-            currentState = START;
-            // --- 打印信息 ---
-            cout << "Token: (" << operators.find(":=")->second << ", " << ":=" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-            tokens.push_back(make_pair(operators.find(":=")->second, ":="));
-            i--; // 回退，因为 BECOMES 状态是在读到 '=' 后进入的，但 for 循环还会自增 i
-            currentColumn--;
+        switch (step->action)
+        {
+        case A_MARK:
+            markStart();
             break;
-
-        case GEQ: // 识别出 >=
-            currentState = START;
-            // --- 打印信息 ---
-            cout << "Token: (" << operators.find(">=")->second << ", " << ">=" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-            tokens.push_back(make_pair(operators.find(">=")->second, ">="));
-            i--; // 回退
-            currentColumn--;
+        case A_NUM_BEGIN:
+            // 整个常数一次读完，停在它的末位上；INNUM / INFLOAT 只剩下处理结束它的那个字符
+            markStart();
+            num = scanNumber(src, i, len);
+            currentState = num.decimal ? INFLOAT : INNUM;
+            i = num.end - 1;
             break;
-
-        case LEQ: // 识别出 <=
-            currentState = START;
-            // --- 打印信息 ---
-            cout << "Token: (" << operators.find("<=")->second << ", " << "<=" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-            tokens.push_back(make_pair(operators.find("<=")->second, "<="));
-            i--; // 回退
-            currentColumn--;
+        case A_ID_BEGIN:
+            markStart();
+            cur_token_index = 0;
+            cur_token[cur_token_index++] = ch | 0x20; // 转小写
             break;
-
-        case NEQ: // 识别出 <>
-            currentState = START;
-            // --- 打印信息 ---
-            cout << "Token: (" << operators.find("<>")->second << ", " << "<>" << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-            tokens.push_back(make_pair(operators.find("<>")->second, "<>"));
-            i--; // 回退
-            currentColumn--;
+        default: // A_SKIP：结束记号的是空白或 '{'，如 "x " 中的空格
             break;
-
-        case END: // 识别出 end 关键字后进入的状态
-            // 保持原有逻辑：在 end 之后如果遇到 '.'，则识别句点
-            if (c == '.')
+        case A_EMIT1:
+            markStart();
+            if (emitted)
             {
-                string type = delimiters.find(".")->second;
-                // --- 打印信息 ---
-                // 注意：这里的起始位置是 '.' 的位置，不是 'end' 的位置
-                tokenStartLine = currentLine; // 更新句点的起始位置
-                tokenStartColumn = currentColumn;
-                cout << "Token: (" << type << ", " << "." << ") at Line " << tokenStartLine << ", Col " << tokenStartColumn << endl;
-                tokens.push_back(make_pair(type, "."));
+                emit(queued, step->kind, i, 1);
+                hasQueued = true;
             }
             else
             {
-                // 如果 end 后面不是 '.'，需要回退，让 '.' 或其他字符在 START 状态被处理
-                i--;
-                currentColumn--;
+                emit(tok, step->kind, i, 1);
+                emitted = true;
             }
-            currentState = START; // 无论如何都回到 START
-            break;                // END 结束
-
-        } // switch(currentState) 结束
+            break;
+        case A_EMIT2:
+            emit(tok, step->kind, tokenStart, 2);
+            emitted = true;
+            break;
+        case A_BAD:
+            if (tracer)
+                tracer->badChar(src[i], currentLine, column());
+            else
+                fprintf(stderr, "报错字符：%c at Line %d, Column %d\n", src[i], currentLine, column());
+            error(0);
+            break;
+        }
 
-        // --- 更新行号和列号 ---
-        if (raw_c == '\n')
+        // --- 更新行号 ---
+        if (ch == '\n')
         {
             currentLine++;
-            currentColumn = 1;
-        }
-        else
-        {
-            currentColumn++;
+            lineStart = i + 1;
         }
-        // --- 行号列号更新结束 ---
-
-        // 移动到下一个字符 (如果前面没有 continue 或 i--)
         i++;
 
-    } // for 循环结束
+        if (emitted)
+            return true;
+    }
 
-    // --- 添加文件结束符 EOF Token 的打印信息 (但不加入返回列表) ---
-    cout << "Token: (EOF, ) at Line " << currentLine << ", Col " << currentColumn << endl;
-    // --- EOF Token 打印结束 ---
+    // 源程序末尾还有未结束的记号
+    const LexStep& step = lexTable[currentState][C_SPACE];
+    if (step.action >= A_FINISH_NUM && finish(tok, step))
+        return true;
+    currentState = static_cast<state>(step.next);
 
-    // 词法分析结束
-    cout << "Lexical analysis END." << endl;
-    return tokens; // 返回值类型和内容不变
+    // --- 添加文件结束符 EOF Token 的打印信息 (但不作为记号返回) ---
+#if PL0_TRACE_TOKENS
+    if (tracer && !done && last)
+        tracer->eof(currentLine, column());
+#endif
+    done = true;
+    return false;
 }
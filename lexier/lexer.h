@@ -1,12 +1,22 @@
+#ifndef PL0_LEXER_H
+#define PL0_LEXER_H
+
 #include <iostream>
 #include <vector>
-#include <map>
 #include <set>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "errmsg.h"
+#include "token.h"
+#include "trace.h"
+#include "scan.h"
+#include "profile.h"
 
 using namespace std;
 
 #define NRW 11 // number of reserved words 保留词数量
-#define MAXNUMLEN 13 // 数字最大位
 #define MAXIDLEN 10 // 标识符最大长度
 
 /**
@@ -43,115 +53,349 @@ enum state
     COMMENT
 };
 
-// 初始状态
-state currentState = START;
+/**
+ * @brief 字符类别，即 DFA 转移表的列
+ * 每个字节只查一次 charClass 表，不再逐字符调用 isspace/isalpha/isdigit/tolower
+ */
+enum CharClass : unsigned char
+{
+    C_SPACE, C_NEWLINE, C_LETTER, C_DIGIT,
+    C_LBRACE, C_RBRACE, C_COLON, C_GTR, C_LSS, C_EQL, C_PERIOD,
+    C_PLUS, C_MINUS, C_TIMES, C_SLASH, C_HASH,
+    C_COMMA, C_SEMICOLON, C_LPAREN, C_RPAREN,
+    C_OTHER,
+    CLASS_COUNT
+};
+
+#define SP C_SPACE
+#define NL C_NEWLINE
+#define AL C_LETTER
+#define DG C_DIGIT
+#define LB C_LBRACE
+#define RB C_RBRACE
+#define CO C_COLON
+#define GT C_GTR
+#define LT C_LSS
+#define EQ C_EQL
+#define DT C_PERIOD
+#define PL C_PLUS
+#define MI C_MINUS
+#define TI C_TIMES
+#define SL C_SLASH
+#define HA C_HASH
+#define CM C_COMMA
+#define SC C_SEMICOLON
+#define LP C_LPAREN
+#define RP C_RPAREN
+#define OT C_OTHER
+// 按字节取字符类别（C locale 下的空白、字母、数字）
+const unsigned char charClass[256] = {
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, SP, NL, SP, SP, SP, OT, OT,  /* 00 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 10 */
+    SP, OT, OT, HA, OT, OT, OT, OT, LP, RP, TI, PL, CM, MI, DT, SL,  /* 20 */
+    DG, DG, DG, DG, DG, DG, DG, DG, DG, DG, CO, SC, LT, EQ, GT, OT,  /* 30 */
+    OT, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,  /* 40 */
+    AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, OT, OT, OT, OT, OT,  /* 50 */
+    OT, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,  /* 60 */
+    AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, LB, OT, RB, OT, OT,  /* 70 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 80 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 90 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* A0 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* B0 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* C0 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* D0 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* E0 */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* F0 */
+};
+#undef SP
+#undef NL
+#undef AL
+#undef DG
+#undef LB
+#undef RB
+#undef CO
+#undef GT
+#undef LT
+#undef EQ
+#undef DT
+#undef PL
+#undef MI
+#undef TI
+#undef SL
+#undef HA
+#undef CM
+#undef SC
+#undef LP
+#undef RP
+#undef OT
+
+/**
+ * @brief 转移动作
+ * A_FINISH_* 及 A_DROP 表示读到的字符结束了当前记号：先收尾，
+ * 再由新状态所在行继续处理同一个字符，不回退、不重读。
+ */
+enum LexAction : unsigned char
+{
+    A_SKIP,         // 不产生记号（空白、注释）
+    A_MARK,         // 记录记号起点（: > < 等待下一个字符）
+    A_NUM_BEGIN,    // 数字的第一位：整个常数由 scanNumber() 一次读完
+    A_NUM_DIGIT,    // 数字的后续位（已由 A_NUM_BEGIN 读过，不会执行）
+    A_NUM_DOT,      // 小数点（同上）
+    A_FLOAT_DIGIT,  // 小数部分（同上）
+    A_ID_BEGIN,     // 标识符的第一个字母
+    A_ID_CHAR,      // 标识符的后续字符
+    A_EMIT1,        // 单字符记号
+    A_EMIT2,        // 双字符记号，起点在 A_MARK 处
+    A_BAD,          // 非法字符
+    A_FINISH_NUM,   // 结束整数
+    A_FINISH_FLOAT, // 结束小数
+    A_FINISH_ID,    // 结束标识符/关键字
+    A_FINISH_OP,    // 结束单字符的 > 或 <
+    A_DROP          // 单独的 ':'，不产生记号
+};
+
+// 转移表的一项：下一状态、动作、产生的记号种类
+struct LexStep
+{
+    unsigned char next;
+    unsigned char action;
+    Tok kind;
+};
+
+const int STATE_COUNT = COMMENT + 1;
+
+#define S(next, action, kind) { next, action, Tok::kind }
+// START 行；END 与已识别出双字符运算符的状态都按它处理下一个字符
+#define START_ROW {                                                                  \
+    S(START, A_SKIP, END), S(START, A_SKIP, END),                                    \
+    S(INID, A_ID_BEGIN, IDENT), S(INNUM, A_NUM_BEGIN, NUMBER),                       \
+    S(COMMENT, A_SKIP, END), S(START, A_BAD, END), S(INBECOMES, A_MARK, END),        \
+    S(GTR, A_MARK, END), S(LES, A_MARK, END),                                        \
+    S(START, A_EMIT1, EQL), S(START, A_EMIT1, PERIOD),                               \
+    S(START, A_EMIT1, PLUS), S(START, A_EMIT1, MINUS), S(START, A_EMIT1, TIMES),     \
+    S(START, A_EMIT1, SLASH), S(START, A_EMIT1, NEQ),                                \
+    S(START, A_EMIT1, COMMA), S(START, A_EMIT1, SEMICOLON),                          \
+    S(START, A_EMIT1, LPAREN), S(START, A_EMIT1, RPAREN),                            \
+    S(START, A_BAD, END) }
+
+/**
+ * @brief DFA 转移表 lexTable[状态][字符类别]
+ * 列顺序与 CharClass 一致：
+ *   空白 换行 字母 数字 { } : > < = . + - * / # , ; ( ) 其他
+ */
+const LexStep lexTable[STATE_COUNT][CLASS_COUNT] = {
+    /* START */ START_ROW,
+    /* INNUM */ {
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(INNUM, A_NUM_DIGIT, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(INFLOAT, A_NUM_DOT, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER), S(START, A_FINISH_NUM, NUMBER),
+        S(START, A_FINISH_NUM, NUMBER) },
+    /* INFLOAT */ {
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(INFLOAT, A_FLOAT_DIGIT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER), S(START, A_FINISH_FLOAT, NUMBER),
+        S(START, A_FINISH_FLOAT, NUMBER) },
+    /* INID */ {
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(INID, A_ID_CHAR, IDENT), S(INID, A_ID_CHAR, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT), S(START, A_FINISH_ID, IDENT),
+        S(START, A_FINISH_ID, IDENT) },
+    /* INBECOMES */ {
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_EMIT2, BECOMES), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END), S(START, A_DROP, END),
+        S(START, A_DROP, END) },
+    /* BECOMES */ START_ROW,
+    /* GTR */ {
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_EMIT2, GEQ), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR), S(START, A_FINISH_OP, GTR),
+        S(START, A_FINISH_OP, GTR) },
+    /* GEQ */ START_ROW,
+    /* NEQ */ START_ROW,
+    /* LES */ {
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_EMIT2, NEQ), S(START, A_FINISH_OP, LSS),
+        S(START, A_EMIT2, LEQ), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS), S(START, A_FINISH_OP, LSS),
+        S(START, A_FINISH_OP, LSS) },
+    /* LEQ */ START_ROW,
+    /* END */ START_ROW,
+    /* COMMENT */ {
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(START, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END), S(COMMENT, A_SKIP, END),
+        S(COMMENT, A_SKIP, END) }
+};
+#undef START_ROW
+#undef S
 
 // 定义Pl/0语言词汇表
+// 词汇表都是编译期生成的完美哈希表（见 token.h 的 PerfectHash）：
+// 常量初始化，进程启动时没有构造开销，查找只探测一个槽、比较一次
+
 // 基本字 单词-符号(symbol)
-map<string, string> keywords = {
-    {"begin", "beginsym"},
-    {"call", "callsym"},
-    {"const", "constsym"},
-    {"do", "dosym"},
-    {"end", "endsym"},
-    {"if", "ifsym"},
-    {"else","elsesym"},
-    {"odd", "oddsym"},
-    {"procedure", "proceduresym"},
-    {"read", "readsym"},
-    {"var", "varsym"},
-    {"while", "whilesym"},
-    {"write", "writesym"},
-    {"then","thensym"}
+constexpr NameKind KEYWORDS[] = {
+    {"begin", 5, Tok::BEGINSYM},
+    {"call", 4, Tok::CALLSYM},
+    {"const", 5, Tok::CONSTSYM},
+    {"do", 2, Tok::DOSYM},
+    {"end", 3, Tok::ENDSYM},
+    {"if", 2, Tok::IFSYM},
+    {"else", 4, Tok::ELSESYM},
+    {"odd", 3, Tok::ODDSYM},
+    {"procedure", 9, Tok::PROCEDURESYM},
+    {"read", 4, Tok::READSYM},
+    {"var", 3, Tok::VARSYM},
+    {"while", 5, Tok::WHILESYM},
+    {"write", 5, Tok::WRITESYM},
+    {"then", 4, Tok::THENSYM}
 };
 
-// 标识符
-const string identifier="ident";
-
-// 常数
-const string number = "number";
+// 前两个字符与长度：14 个关键字落在 16 个槽中互不冲突（要求长度至少为 2）
+struct KeywordKeys {
+    static constexpr unsigned size = 16;
+    static constexpr unsigned count = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+    static constexpr Tok miss = Tok::IDENT;
+    static constexpr NameKind entry(unsigned k) { return KEYWORDS[k]; }
+    static constexpr unsigned hash(const char* s, size_t n)
+    {
+        return (static_cast<unsigned char>(s[0]) * 6u + static_cast<unsigned char>(s[1]) * 4u
+              + static_cast<unsigned>(n)) & 15u;
+    }
+};
+static_assert(PerfectHash<KeywordKeys>::perfect(), "关键字哈希出现冲突");
+constexpr PerfectHashTable<KeywordKeys::size> keywordTable = PerfectHash<KeywordKeys>::build();
 
 // 运算符
-map<string, string> operators = {
-    {"+", "plus"},
-    {"-", "minus"},
-    {"*", "times"},
-    {"/", "slash"},
-    {"=", "eql"},
-    {"<>", "neq"},
-    {"#", "neq"},
-    {"<", "lss"},
-    {"<=", "leq"},
-    {">", "gtr"},
-    {">=", "geq"},
-    {":=", "becomes"}
+constexpr NameKind OPERATORS[] = {
+    {"+", 1, Tok::PLUS},
+    {"-", 1, Tok::MINUS},
+    {"*", 1, Tok::TIMES},
+    {"/", 1, Tok::SLASH},
+    {"=", 1, Tok::EQL},
+    {"<>", 2, Tok::NEQ},
+    {"#", 1, Tok::NEQ},
+    {"<", 1, Tok::LSS},
+    {"<=", 2, Tok::LEQ},
+    {">", 1, Tok::GTR},
+    {">=", 2, Tok::GEQ},
+    {":=", 2, Tok::BECOMES}
 };
 
+struct OperatorKeys {
+    static constexpr unsigned size = 32;
+    static constexpr unsigned count = sizeof(OPERATORS) / sizeof(OPERATORS[0]);
+    static constexpr Tok miss = Tok::END;
+    static constexpr NameKind entry(unsigned k) { return OPERATORS[k]; }
+    static constexpr unsigned hash(const char* s, size_t n)
+    {
+        return (static_cast<unsigned char>(s[0]) * 2u + static_cast<unsigned char>(s[n - 1]) * 7u
+              + static_cast<unsigned>(n)) & 31u;
+    }
+};
+static_assert(PerfectHash<OperatorKeys>::perfect(), "运算符哈希出现冲突");
+constexpr PerfectHashTable<OperatorKeys::size> operatorTable = PerfectHash<OperatorKeys>::build();
+
 // 界符号（分隔符）
-map <string,string> delimiters={
-    {"(","lparen"},
-    {")","rparen"},
-    {",","comma"},
-    {";","semicolon"},
-    {".","period"}
+constexpr NameKind DELIMITERS[] = {
+    {"(", 1, Tok::LPAREN},
+    {")", 1, Tok::RPAREN},
+    {",", 1, Tok::COMMA},
+    {";", 1, Tok::SEMICOLON},
+    {".", 1, Tok::PERIOD}
 };
 
-// 报错提示
-const char* err_msg[] =
-{
-/*  0 */    "Fatal Error:Unknown character.\n",
-/*  1 */    "Found ':=' when expecting '='.",
-/*  2 */    "There must be a number to follow '='.",
-/*  3 */    "There must be an '=' to follow the identifier.",
-/*  4 */    "There must be an identifier to follow 'const', 'var', or 'procedure'.",
-/*  5 */    "Missing ',' or ';'.",
-/*  6 */    "Incorrect procedure name.",
-/*  7 */    "Statement expected.",
-/*  8 */    "Follow the statement is an incorrect symbol.",
-/*  9 */    "'.' expected.",
-/* 10 */    "';' expected.",
-/* 11 */    "Undeclared identifier.",
-/* 12 */    "Illegal assignment.",
-/* 13 */    "':=' expected.",
-/* 14 */    "There must be an identifier to follow the 'call'.",
-/* 15 */    "A constant or variable can not be called.",
-/* 16 */    "'then' expected.",
-/* 17 */    "';' or 'end' expected.",
-/* 18 */    "'do' expected.",
-/* 19 */    "Incorrect symbol.",
-/* 20 */    "Relative operators expected.",
-/* 21 */    "Procedure identifier can not be in an expression.",
-/* 22 */    "Missing ')'.",
-/* 23 */    "The symbol can not be followed by a factor.",
-/* 24 */    "The symbol can not be as the beginning of an expression.",
-/* 25 */    "The number is too great.",
-/* 26 */    "The identifier is too long",
-/* 27 */    "",
-/* 28 */    "",
-/* 29 */    "",
-/* 30 */    "",
-/* 31 */    "",
-/* 32 */    "There are too many levels.",
-/* 33 */    "invalid number:can't have letters in a number."
+struct DelimiterKeys {
+    static constexpr unsigned size = 8;
+    static constexpr unsigned count = sizeof(DELIMITERS) / sizeof(DELIMITERS[0]);
+    static constexpr Tok miss = Tok::END;
+    static constexpr NameKind entry(unsigned k) { return DELIMITERS[k]; }
+    static constexpr unsigned hash(const char* s, size_t n)
+    {
+        return (static_cast<unsigned char>(s[0]) + static_cast<unsigned>(n)) & 7u;
+    }
 };
+static_assert(PerfectHash<DelimiterKeys>::perfect(), "界符哈希出现冲突");
+constexpr PerfectHashTable<DelimiterKeys::size> delimiterTable = PerfectHash<DelimiterKeys>::build();
+
+// 关键字查表：是关键字返回其种类，否则返回 Tok::IDENT
+inline Tok lookupKeyword(const char* s, size_t n){
+    if (n < 2) return Tok::IDENT;
+    return probe(keywordTable.slot, KeywordKeys::hash(s, n), s, n, Tok::IDENT);
+}
+
+// 运算符查表，不是运算符返回 Tok::END
+inline Tok lookupOperator(const char* s, size_t n){
+    if (n == 0) return Tok::END;
+    return probe(operatorTable.slot, OperatorKeys::hash(s, n), s, n, Tok::END);
+}
+
+// 界符查表，不是界符返回 Tok::END
+inline Tok lookupDelimiter(const char* s, size_t n){
+    if (n == 0) return Tok::END;
+    return probe(delimiterTable.slot, DelimiterKeys::hash(s, n), s, n, Tok::END);
+}
+
 
 // 实用函数 (utils)
 // 判断是否是关键字
-bool isKeyword(const string &str){
-    return keywords.find(str) != keywords.end();
+inline bool isKeyword(const string &str){
+    return lookupKeyword(str.data(), str.size()) != Tok::IDENT;
 }
 
 // 判断是否是运算符
-bool isOperator(const char *c){
-    return operators.find(c) != operators.end();
+inline bool isOperator(const char *c){
+    return lookupOperator(c, strlen(c)) != Tok::END;
 }
 // 判断是否是单字符运算符
-bool isSingleOperator(const char c){
+inline bool isSingleOperator(const char c){
     return (c == '+' || c == '-' || c == '*' || c == '/' || c == '#');
 }
 
 // 判断是否是数字
-bool isNumber(const string &str){
+inline bool isNumber(const string &str){
     for(char c:str){
         if(!isdigit(c)){
             return false;
@@ -161,12 +405,84 @@ bool isNumber(const string &str){
 }
 
 // 判断是否是分隔符
-bool isDelimiter(const string &str){
-    return delimiters.find(str) != delimiters.end();
+inline bool isDelimiter(const string &str){
+    return lookupDelimiter(str.data(), str.size()) != Tok::END;
 }
 
 // 清理当前识别token内存
-void cleanTokenMem(char* cur_token,int &cur_token_index){
+inline void cleanTokenMem(char* cur_token,int &cur_token_index){
     memset(cur_token, 0, MAXIDLEN+1);
     cur_token_index = 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 从源程序中间开始分析时的起点（分块并行分析用）
+ * 起点须紧跟在一个空白字符之后，这时 DFA 只可能处在 START 或 COMMENT，
+ * 由 inComment 区分；其后的分析与从头分析到这里完全相同。
+ */
+struct LexStart {
+    size_t begin = 0;           // 起始位置
+    int line = 1;               // 起始位置所在的行号
+    size_t lineStart = 0;       // 该行行首的位置
+    bool inComment = false;     // 起始位置是否处在 { } 注释内
+    bool last = true;           // 分析范围的末尾是否就是源程序末尾，只有这时才输出 EOF 跟踪
+};
+
+/**
+ * @brief 拉取式词法分析器
+ * 每调用一次 next() 只把 DFA 推进到下一个记号为止，
+ * 语法分析器按需取记号，整条记号流不必驻留内存。
+ * 源程序缓冲区由调用方持有，须在 Lexer 使用期间保持有效。
+ */
+class Lexer : public TokenSource {
+public:
+    /* tracer 非空时按其级别输出记号跟踪与错误诊断，为空时错误直接写标准错误 */
+    Lexer(const char* src, size_t len, Tracer* tracer = 0);
+    explicit Lexer(const string& src, Tracer* tracer = 0);
+    /* 只分析 [at.begin, end)，记号位置仍相对于 src 起点 */
+    Lexer(const char* src, size_t end, const LexStart& at, Tracer* tracer = 0);
+
+    bool next(Token& tok) override;
+    Lexeme lexeme(const Token& tok) const override;
+    int64_t number(const Token&) const override { return num.value; }
+
+    int line() const { return currentLine; }
+    int column() const { return static_cast<int>(i - lineStart) + 1; }
+    /* 已报告的词法错误个数 */
+    int errorCount() const { return errors; }
+
+private:
+    const char* src;
+    size_t len;
+    size_t i = 0;
+    Tracer* tracer;
+    const ScanKernels& scan;            // 成段扫描内核，按 CPU 选定
+    bool done = false;
+    bool last = true;
+    state currentState = START;
+    int errors = 0;
+
+    // 行号；列号由当前位置与行首位置相减得到
+    int currentLine = 1;
+    size_t lineStart = 0;
+    int tokenStartLine = 1;
+    int tokenStartColumn = 1;
+    size_t tokenStart = 0;              // 记号起点在源程序中的位置
+
+    NumberScan num;                     // 识别中（或刚交出）的常数
+    char cur_token[MAXIDLEN + 1];       // 识别中的标识符or关键字
+    int cur_token_index = 0;            // 识别中标识符or关键字的下标
+    string numText;                     // 规范化后的常数词素，原文不规范时才用
+    Lexeme numLexeme = Lexeme();        // 常数记号的词素：numText 或源程序中的原文
+
+    // 一个字符同时结束上一个记号并构成单字符记号时，后者暂存于此
+    Token queued;
+    bool hasQueued = false;
+
+    void error(int n);
+    void markStart();
+    bool finish(Token& tok, const LexStep& step);
+    void emit(Token& tok, Tok kind, size_t off, size_t n);
+};
+
+#endif
@@ -1,40 +1,102 @@
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <memory>
 
-#include "lexer.cpp"
+#include "lexer.h"
+#include "parallel.h"
+#include "profile.h"
+#include "source.h"
+#include "tokfile.h"
+#include "trace.h"
 
 using namespace std;
 
-int main(){
-    ifstream inputFile("./tests/case05.txt");
-    ofstream outputFile("./out/case05_output.txt");
+/*
+ * 用法: ./lexer [-b] [-v 级别] [-t 跟踪文件] [-j 线程数] [--profile 文件] [源文件] [输出文件]
+ *   -b      以二进制格式 (.tokb) 输出记号流，默认为 (单词种类,值) 文本格式
+ *   -v N    输出级别：0 静默，1 仅错误，2 错误与阶段信息，3 逐个记号（默认）
+ *   -t F    记号跟踪与阶段信息写入文件 F，默认写标准输出；错误诊断总是写标准错误
+ *   -j N    分块并行分析，N 为线程数（0 取硬件线程数），输出与顺序分析相同
+ *   --profile F  计时并按种类数记号，结束时把 Chrome 跟踪事件格式的 JSON 写入 F、汇总表写标准错误
+ *   缺省源文件为 ./tests/case05.txt，缺省输出为 ./out/case05_output.txt
+ *   源文件为 "-" 时从标准输入读取
+ */
+int main(int argc, char* argv[]){
+    bool binary = false;
+    int verbosity = static_cast<int>(TraceLevel::TOKEN);
+    string tracePath, profilePath;
+    int jobs = -1;              // 小于 0 表示顺序分析
+    vector<string> paths;
+    for(int i = 1; i < argc; ++i){
+        string arg = argv[i];
+        if(arg == "-b") binary = true;
+        else if(arg == "-v" && i + 1 < argc) verbosity = atoi(argv[++i]);
+        else if(arg == "-t" && i + 1 < argc) tracePath = argv[++i];
+        else if(arg == "-j" && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if(arg == "--profile" && i + 1 < argc) profilePath = argv[++i];
+        else paths.push_back(arg);
+    }
+    if(verbosity < 0 || verbosity > static_cast<int>(TraceLevel::TOKEN)){
+        cerr << "error:输出级别应为 0-3" << endl;
+        return 1;
+    }
+    string inPath  = paths.size() > 0 ? paths[0] : "./tests/case05.txt";
+    string outPath = paths.size() > 1 ? paths[1] : "./out/case05_output.txt";
 
-    if(!inputFile.is_open()||!outputFile.is_open()){
-        cerr << "error:无法打开文件" << endl;
+    ProfileSession profile(profilePath);
+
+    // 普通文件只读映射，标准输入与管道整块读入
+    SourceBuffer source;
+    string why;
+    if(!source.open(inPath, why)){
+        cerr << "error:" << why << endl;
         return 1;
     }
 
-    string sourceCode;
-    string line;
-    
-    // 读取源代码程序作为字符流
-    while(getline(inputFile,line)){
-        sourceCode += line + "\n";
+    ofstream outputFile(outPath, binary ? ios::binary : ios::out);
+    if(!outputFile.is_open()){
+        cerr << "error:无法打开文件" << endl;
+        return 1;
     }
 
-    // 定义并通过词法分析，获取记号流
-    vector<pair<string,string>> tokens;
-    tokens=lexer(sourceCode);
+    // 跟踪信息攒批写出，错误诊断单独走标准错误
+    BufferedSink stdoutSink(stdout);
+    BufferedSink stderrSink(stderr, 0);
+    unique_ptr<FileSink> fileSink;
+    if(!tracePath.empty()){
+        fileSink.reset(new FileSink(tracePath));
+        if(!fileSink->ok()){
+            cerr << "error:无法打开跟踪文件 " << tracePath << endl;
+            return 1;
+        }
+    }
+    Tracer tracer(fileSink ? static_cast<TraceSink&>(*fileSink) : stdoutSink,
+                  stderrSink, static_cast<TraceLevel>(verbosity));
 
-    // 以(单词种类，值)方式输出
-    for(const auto &pair:tokens){
-        outputFile<<"("<<pair.first<<","<<pair.second<<")"<<endl;
+    // 词法分析器边识别边交给输出，以(单词种类，值)方式或二进制格式写出
+    unique_ptr<TokenSource> lexer;
+    if(jobs < 0)
+        lexer.reset(new Lexer(source.data(), source.size(), &tracer));
+    else
+        lexer.reset(new ParallelLexer(source.data(), source.size(), jobs, &tracer));
+    TokenSource& lx = *lexer;
+    if(binary){
+        if(!writeTokensBinary(outputFile, lx)){
+            cerr << "error:写出二进制记号文件失败" << endl;
+            return 1;
+        }
+    }else{
+        writeTokensText(outputFile, lx);
     }
 
-    inputFile.close();
+    // 词法分析结束
+    tracer.info("Lexical analysis END.");
+
     outputFile.close();
 
-    cout << "词法分析结果已写入output.txt" << endl;
+    tracer.info(("词法分析结果已写入" + outPath).c_str());
+    tracer.flush();
 
     return 0;
-}
\ No newline at end of file
+}
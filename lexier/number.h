@@ -0,0 +1,135 @@
+#ifndef PL0_NUMBER_H
+#define PL0_NUMBER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+/**
+ * @brief 常数的扫描结果
+ * 常数为 digits [ '.' digits* ]；value 是其整数部分，带小数点时 real 是按十进制正确舍入得到的 double。
+ * 整数部分超出 int64 时 value 取 INT64_MAX、overflow 置位，整个常数按 INT64_MAX 处理（错误 25）。
+ */
+struct NumberScan {
+    size_t end = 0;             // 常数之后的第一个位置
+    int64_t value = 0;
+    double real = 0;
+    bool decimal = false;       // 带小数点
+    bool overflow = false;
+    bool canonical = false;     // 不带小数点、没有多余的前导 0、没有溢出：原文就是规范化的词素
+};
+
+inline bool isDigitChar(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+/**
+ * @brief
+ * 从 pos 起读一串数字累加到 v，超出 int64 时 v 取 INT64_MAX 并置 overflow
+ * @return 数字之后的位置
+ */
+inline size_t scanDigits(const char* s, size_t pos, size_t len, uint64_t& v, bool& overflow)
+{
+    const uint64_t CUT = INT64_MAX / 10, LAST = INT64_MAX % 10;
+    for (; pos < len && isDigitChar(s[pos]); ++pos) {
+        unsigned d = static_cast<unsigned>(s[pos] - '0');
+        if (v < CUT || (v == CUT && d <= LAST)) v = v * 10 + d;
+        else {
+            v = INT64_MAX;
+            overflow = true;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @brief
+ * [begin, end) 中小数的值，正确舍入到 double。
+ * 去掉小数点后的数字串 m 不超过 2^53、小数位数不超过 22 时 m 与 10^k 都能精确表示，
+ * 一次除法即为正确舍入的结果（Clinger 的快速路径）；其余少见的情形交给 strtod
+ * （glibc 的 strtod 正确舍入；本程序不调用 setlocale，小数点总是 '.'）
+ */
+inline double decimalValue(const char* s, size_t begin, size_t end)
+{
+    static const double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t EXACT = uint64_t(1) << 53;
+    uint64_t m = 0;
+    int frac = -1;              // 小数点之后的位数，-1 表示还没遇到小数点
+    for (size_t p = begin; p < end; ++p) {
+        if (s[p] == '.') {
+            frac = 0;
+            continue;
+        }
+        m = m * 10 + static_cast<unsigned>(s[p] - '0');
+        if (m > EXACT) return std::strtod(std::string(s + begin, end - begin).c_str(), 0);
+        if (frac >= 0) ++frac;
+    }
+    if (frac > 22) return std::strtod(std::string(s + begin, end - begin).c_str(), 0);
+    return frac > 0 ? static_cast<double>(m) / POW10[frac] : static_cast<double>(m);
+}
+
+/**
+ * @brief
+ * 从 pos（须是数字）起读一个常数；只看 [pos, len)
+ */
+inline NumberScan scanNumber(const char* s, size_t pos, size_t len)
+{
+    NumberScan n;
+    uint64_t v = 0;
+    size_t p = scanDigits(s, pos, len, v, n.overflow);
+    n.value = static_cast<int64_t>(v);
+    n.canonical = !n.overflow && (s[pos] != '0' || p - pos == 1);
+    if (p < len && s[p] == '.') {
+        for (++p; p < len && isDigitChar(s[p]); ++p) {}
+        n.end = p;
+        n.decimal = true;
+        n.canonical = false;
+        n.real = n.overflow ? static_cast<double>(INT64_MAX) : decimalValue(s, pos, n.end);
+    } else {
+        n.end = p;
+    }
+    return n;
+}
+
+/**
+ * @brief
+ * 规范化的词素写入 out：整数去掉前导 0（溢出的为 INT64_MAX），小数为 %f 格式（小数点后 6 位）。
+ * 小数部分不超过 6 位、整数部分小于 2^32 时，real 与原文之差不到 0.5e-6，%f 的结果就是原文补足 6 位，
+ * 直接由原文拼出，不必格式化 double
+ * @param s, pos 常数在源程序中的起点，即交给 scanNumber() 的
+ */
+inline void numberText(const NumberScan& n, const char* s, size_t pos, std::string& out)
+{
+    out.clear();
+    if (n.overflow) {
+        out = std::to_string(n.value);
+        return;
+    }
+    size_t p = pos;
+    while (p + 1 < n.end && s[p] == '0' && isDigitChar(s[p + 1])) ++p;     // 前导 0
+    if (!n.decimal) {
+        out.assign(s + p, n.end - p);
+        return;
+    }
+    size_t dot = p;
+    while (s[dot] != '.') ++dot;
+    size_t frac = n.end - dot - 1;
+    if (frac <= 6 && n.value < (int64_t(1) << 32)) {
+        out.assign(s + p, n.end - p);
+        out.append(6 - frac, '0');
+    } else {
+        out = std::to_string(n.real);
+    }
+}
+
+/* 词素的整数部分，超出 int64 时取 INT64_MAX；从记号文件读入的常数由此求值 */
+inline int64_t numberValue(const char* s, size_t len)
+{
+    uint64_t v = 0;
+    bool overflow = false;
+    scanDigits(s, 0, len, v, overflow);
+    return static_cast<int64_t>(v);
+}
+
+#endif
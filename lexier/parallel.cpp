@@ -0,0 +1,258 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "lexer.h"
+
+/*
+ * 每块大约这么大：切得太碎时线程调度与合并的开销会盖过收益，
+ * 太大则每块的记号缓冲占内存过多。测试切分时可以编译期调小。
+ */
+#ifndef PL0_CHUNK_SIZE
+#define PL0_CHUNK_SIZE (1 << 20)
+#endif
+static const size_t CHUNK_SIZE = PL0_CHUNK_SIZE;
+
+/* 每个线程最多领先语法分析器这么多块，分析好而未取走的记号所占内存因此有上限 */
+static const size_t CHUNKS_AHEAD = 4;
+
+ParallelLexer::ParallelLexer(const char* src, size_t len, unsigned threads, Tracer* tracer)
+    : src(src), len(len), tracer(tracer)
+{
+    unsigned n = threads ? threads : std::thread::hardware_concurrency();
+    if (n == 0) n = 1;
+    window = CHUNKS_AHEAD * n;
+    split();
+
+    // 第一遍：并行统计各块的换行与注释边界
+    std::atomic<size_t> k(0);
+    auto scanAll = [this, &k] {
+        for (size_t j; (j = k++) < chunks.size(); )
+            summarize(chunks[j]);
+    };
+    std::vector<std::thread> scanners;
+    for (unsigned t = 1; t < n && t < chunks.size(); ++t)
+        scanners.emplace_back(scanAll);
+    scanAll();
+    for (auto& t : scanners) t.join();
+
+    // 顺序串起各块的起始行号、行首位置与注释状态
+    int line = 1;
+    size_t lineStart = 0;
+    bool inComment = false;
+    for (auto& c : chunks) {
+        c.line = line;
+        c.lineStart = lineStart;
+        c.inComment = inComment;
+        line += static_cast<int>(c.lines);
+        if (c.lines) lineStart = c.lastNl + 1;
+        inComment = inComment ? c.exitIfIn : c.exitIfOut;
+    }
+
+    // 第二遍：后台并行分析，next() 按顺序取用
+    for (unsigned t = 0; t < n && t < chunks.size(); ++t)
+        workers.emplace_back(&ParallelLexer::worker, this);
+}
+
+ParallelLexer::~ParallelLexer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    aheadCv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+/**
+ * @brief
+ * 按 CHUNK_SIZE 切块，每个切分点后移到下一个空白字符之后
+ */
+void ParallelLexer::split()
+{
+    size_t begin = 0;
+    while (len - begin > CHUNK_SIZE) {
+        size_t b = begin + CHUNK_SIZE;
+        while (b < len) {
+            unsigned char cls = charClass[static_cast<unsigned char>(src[b])];
+            if (cls == C_SPACE || cls == C_NEWLINE) break;
+            ++b;
+        }
+        if (b + 1 >= len) break;
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = b + 1;
+        begin = b + 1;
+    }
+    chunks.emplace_back();
+    chunks.back().begin = begin;
+    chunks.back().end = len;
+}
+
+/* 这些记号的词素经过规范化，与源程序区间不同 */
+static inline bool hasOwnLexeme(Tok kind)
+{
+    return kind == Tok::NUMBER || kind <= Tok::IDENT;
+}
+
+/* 从 p 开始、在注释内 (in) 或注释外进入 [p, end)，返回出来时是否在注释内 */
+static bool commentStateAfter(const char* s, size_t p, size_t end, bool in)
+{
+    for (;;) {
+        if (!in) {
+            const void* open = std::memchr(s + p, '{', end - p);
+            if (!open) return false;
+            p = static_cast<const char*>(open) - s + 1;
+        }
+        const void* close = std::memchr(s + p, '}', end - p);
+        if (!close) return true;
+        p = static_cast<const char*>(close) - s + 1;
+        in = false;
+    }
+}
+
+/**
+ * @brief
+ * 第一遍：统计块内换行数与最后一个换行的位置，
+ * 并分别求出从注释外、注释内进入时出块的注释状态
+ */
+void ParallelLexer::summarize(Chunk& c)
+{
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    const ScanKernels& scan = scanKernels();
+    // commentRun 在 '}' 处停下，跨过它继续，就数遍了整块的换行
+    for (size_t p = c.begin; p < c.end; ) {
+        size_t lines = 0, lastNl = 0;
+        size_t run = scan.commentRun(s + p, c.end - p, lines, lastNl);
+        if (lines) {
+            c.lines += lines;
+            c.lastNl = p + lastNl;
+        }
+        p += run + 1;
+    }
+    c.exitIfOut = commentStateAfter(src, c.begin, c.end, false);
+    c.exitIfIn = commentStateAfter(src, c.begin, c.end, true);
+}
+
+/**
+ * @brief
+ * 第二遍：从块的起点状态开始分析，记号、词素、跟踪与诊断都先存在块里
+ * @param c 块
+ * @param last 是否为最后一块
+ */
+void ParallelLexer::lexChunk(Chunk& c, bool last)
+{
+    StringSink out, diag;
+    TraceLevel level = tracer ? tracer->level() : TraceLevel::ERROR;
+    Tracer local(out, diag, level);
+
+    LexStart at;
+    at.begin = c.begin;
+    at.line = c.line;
+    at.lineStart = c.lineStart;
+    at.inComment = c.inComment;
+    at.last = last;
+    Lexer lx(src, c.end, at, &local);
+
+    // 标识符、关键字与数字的词素是规范化过的，按 [长度字节][内容] 依次存入 pool，数字在内容之前另存 8 字节的值；
+    // 其余记号的词素就是源程序区间，不必另存
+    Token tok;
+    c.toks.reserve((c.end - c.begin) / 4 + 16);
+    while (lx.next(tok)) {
+        c.toks.push_back(tok);
+        if (hasOwnLexeme(tok.kind)) {
+            Lexeme l = lx.lexeme(tok);
+            c.pool.push_back(static_cast<char>(l.len));   // 标识符不超过 MAXIDLEN，数字不超过 27 个字符
+            if (tok.kind == Tok::NUMBER) {
+                int64_t v = lx.number(tok);
+                c.pool.append(reinterpret_cast<const char*>(&v), sizeof v);
+            }
+            c.pool.append(l.ptr, l.len);
+        }
+    }
+
+    c.trace.swap(out.text);
+    c.diag.swap(diag.text);
+}
+
+void ParallelLexer::worker()
+{
+    for (;;) {
+        size_t k;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            aheadCv.wait(lock, [this] { return stopping || nextChunk < cur + window; });
+            if (stopping || nextChunk >= chunks.size()) return;
+            k = nextChunk++;
+        }
+        lexChunk(chunks[k], k + 1 == chunks.size());
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            chunks[k].ready = true;
+        }
+        readyCv.notify_all();
+    }
+}
+
+/**
+ * @brief
+ * 按块的顺序交出记号；进入一块时先转发它的跟踪与诊断，离开时释放它的记号
+ * @param tok 输出
+ * @return true 取得一个记号
+ * @return false 所有块都已取完
+ */
+bool ParallelLexer::next(Token& tok)
+{
+    while (!done) {
+        Chunk& c = chunks[cur];
+        if (!entered) {
+            std::unique_lock<std::mutex> lock(mtx);
+            readyCv.wait(lock, [&c] { return c.ready; });
+            lock.unlock();
+            if (tracer)
+                tracer->forward(c.trace, c.diag);
+            else if (!c.diag.empty())
+                std::fputs(c.diag.c_str(), stderr);
+            entered = true;
+        }
+        if (pos < c.toks.size()) {
+            tok = c.toks[pos++];
+            if (hasOwnLexeme(tok.kind)) {
+                size_t n = static_cast<unsigned char>(c.pool[poolPos++]);
+                if (tok.kind == Tok::NUMBER) {
+                    std::memcpy(&curNumber, c.pool.data() + poolPos, sizeof curNumber);
+                    poolPos += sizeof curNumber;
+                }
+                curLexeme = Lexeme{ c.pool.data() + poolPos, n };
+                poolPos += n;
+            } else {
+                curLexeme = Lexeme{ src + tok.off, tok.len };
+            }
+            return true;
+        }
+        if (cur + 1 == chunks.size()) {
+            done = true;
+            break;
+        }
+        std::vector<Token>().swap(c.toks);
+        std::string().swap(c.pool);
+        std::string().swap(c.trace);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++cur;
+        }
+        aheadCv.notify_all();
+        pos = 0;
+        poolPos = 0;
+        entered = false;
+    }
+    curLexeme = Lexeme();       // 与顺序分析一致，EOF 的词素为空
+    return false;
+}
+
+Lexeme ParallelLexer::lexeme(const Token&) const
+{
+    return curLexeme;
+}
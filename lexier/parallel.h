@@ -0,0 +1,85 @@
+#ifndef PL0_PARALLEL_H
+#define PL0_PARALLEL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "token.h"
+#include "trace.h"
+
+/**
+ * @brief 分块并行的词法分析器
+ * 把源程序切成若干块，在多个线程上同时分析，再按块的顺序交出记号，
+ * 记号流、跟踪与错误诊断和顺序分析得到的完全相同。
+ *
+ * 切分点总是紧跟在一个空白字符之后，因此不会把记号切断；
+ * 先并行统计每块的换行数与 "从注释外/注释内进入时在哪里出来"，
+ * 再顺序串起各块的起始行号与注释状态，最后并行分析各块。
+ * 语法分析器取第 k 块的记号时，后面的块仍在后台分析。
+ */
+class ParallelLexer : public TokenSource {
+public:
+    /* threads 为 0 时取硬件线程数；源程序较小时退化为单块 */
+    ParallelLexer(const char* src, size_t len, unsigned threads = 0, Tracer* tracer = 0);
+    ~ParallelLexer();
+
+    bool next(Token& tok) override;
+    Lexeme lexeme(const Token& tok) const override;
+    int64_t number(const Token&) const override { return curNumber; }
+
+    size_t chunkCount() const { return chunks.size(); }
+
+private:
+    ParallelLexer(const ParallelLexer&);            // 不可拷贝
+    ParallelLexer& operator=(const ParallelLexer&);
+
+    struct Chunk {
+        size_t begin = 0, end = 0;
+        // 第一遍：块内换行与注释边界
+        size_t lines = 0;
+        size_t lastNl = 0;          // 块内最后一个 '\n' 的位置，lines 为 0 时无意义
+        bool exitIfOut = false;     // 从注释外进入时，出块时是否在注释内
+        bool exitIfIn = false;      // 从注释内进入时，出块时是否在注释内
+        // 串起来之后得到的起点
+        int line = 1;
+        size_t lineStart = 0;
+        bool inComment = false;
+        // 第二遍：分析结果
+        std::vector<Token> toks;
+        std::string pool;               // 标识符、关键字与数字的词素，按记号顺序存放
+        std::string trace;              // 已格式化的记号跟踪
+        std::string diag;               // 已格式化的错误诊断
+        bool ready = false;
+    };
+
+    void split();
+    void summarize(Chunk& c);
+    void lexChunk(Chunk& c, bool last);
+    void worker();
+
+    const char* src;
+    size_t len;
+    Tracer* tracer;
+    std::vector<Chunk> chunks;
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable readyCv;    // 某块分析完毕
+    std::condition_variable aheadCv;    // 语法分析器取走了一块，或者要析构了
+    size_t nextChunk = 0;           // 下一块待分析的块，受 mtx 保护
+    size_t window = 0;              // 分析最多领先 cur 的块数
+    bool stopping = false;          // 析构时不再领取新块，受 mtx 保护
+
+    size_t cur = 0;                 // 正在交出的块，受 mtx 保护（本线程读取时不必加锁）
+    size_t pos = 0;                 // 块内下一个记号
+    size_t poolPos = 0;             // 块内下一个另存的词素
+    Lexeme curLexeme = Lexeme();    // 刚交出的记号的词素
+    int64_t curNumber = 0;          // 刚交出的常数的值
+    bool entered = false;           // 是否已转发当前块的跟踪与诊断
+    bool done = false;
+};
+
+#endif
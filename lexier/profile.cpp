@@ -0,0 +1,328 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+bool Profiler::active = false;
+
+namespace {
+
+const int ZONE_COUNT = static_cast<int>(Zone::COUNT);
+const int COUNTER_COUNT = static_cast<int>(Counter::COUNT);
+
+/* 区段名、跟踪事件的类别与汇总表中的缩进 */
+struct ZoneInfo {
+    const char* name;
+    const char* cat;
+    int indent;
+};
+
+const ZoneInfo ZONE_NAMES[ZONE_COUNT] = {
+    { "读源程序", "io", 0 },
+    { "载入记号文件", "io", 0 },
+    { "词法分析", "lex", 0 },
+    { "取记号", "parse", 0 },
+    { "语法分析", "parse", 0 },
+    { "program", "grammar", 2 }, { "block", "grammar", 2 },
+    { "constDecl", "grammar", 2 }, { "varDecl", "grammar", 2 }, { "procDecl", "grammar", 2 },
+    { "statement", "grammar", 2 }, { "condition", "grammar", 2 },
+    { "expression", "grammar", 2 }, { "term", "grammar", 2 }, { "factor", "grammar", 2 },
+    { "生成中间表示", "codegen", 0 },
+    { "优化", "codegen", 0 },
+    { "生成代码", "codegen", 0 },
+    { "输出", "output", 0 },
+    { "运行", "run", 0 },
+    { "编译文件", "batch", 0 }
+};
+
+const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+    "源程序字节", "注释字节", "词法错误", "语法树结点", "P-code 指令"
+};
+
+struct Frame {
+    Zone zone;
+    uint64_t start;
+    uint64_t child;         // 其中嵌套的区段合计
+};
+
+struct Event {
+    Zone zone;
+    uint64_t start, dur;
+};
+
+struct ZoneStat {
+    uint64_t calls = 0, total = 0, self = 0;
+};
+
+/* 一个线程的记录，只由该线程写；stop() 之后才汇总 */
+struct ThreadLog {
+    int tid = 0;
+    std::vector<Frame> stack;
+    unsigned depth[ZONE_COUNT] = {};        // 各区段在栈中打开的层数，递归时只在最外一层计总耗时
+    ZoneStat zones[ZONE_COUNT];
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t tokens[TOK_COUNT] = {};
+    std::vector<Event> events;
+    uint64_t dropped = 0;                   // 事件数到上限后丢弃的
+};
+
+std::mutex logMtx;
+std::vector<std::unique_ptr<ThreadLog>> logs;
+std::chrono::steady_clock::time_point epoch;
+uint64_t minEvent = 0;
+uint64_t wall = 0;                          // start() 到 stop() 的纳秒数
+
+thread_local ThreadLog* mine = nullptr;
+
+uint64_t now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+ThreadLog& threadLog()
+{
+    if (!mine) {
+        std::lock_guard<std::mutex> lk(logMtx);
+        logs.emplace_back(new ThreadLog);
+        mine = logs.back().get();
+        mine->tid = static_cast<int>(logs.size());
+        mine->stack.reserve(64);
+    }
+    return *mine;
+}
+
+/* 微秒，保留到纳秒 */
+void printMicros(FILE* fp, uint64_t ns)
+{
+    std::fprintf(fp, "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                 static_cast<unsigned long long>(ns % 1000));
+}
+
+/* 显示宽度：ASCII 占一列，其余（这里只有汉字）占两列 */
+int displayWidth(const char* s)
+{
+    int w = 0;
+    for (; *s; ++s) {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c < 0x80) ++w;
+        else if (c >= 0xC0) w += 2;
+    }
+    return w;
+}
+
+void padRight(FILE* fp, const char* s, int width)
+{
+    std::fputs(s, fp);
+    for (int w = displayWidth(s); w < width; ++w) std::fputc(' ', fp);
+}
+
+void padLeft(FILE* fp, const char* s, int width)
+{
+    for (int w = displayWidth(s); w < width; ++w) std::fputc(' ', fp);
+    std::fputs(s, fp);
+}
+
+double millis(uint64_t ns) { return ns / 1e6; }
+
+} // namespace
+
+/**
+ * @brief
+ * 开始计时；只应调用一次，且在其余线程使用之前
+ * @param minEventNs 短于它的区段不写入跟踪事件，只进汇总
+ */
+void Profiler::start(uint64_t minEventNs)
+{
+    epoch = std::chrono::steady_clock::now();
+    minEvent = minEventNs;
+    active = true;
+}
+
+/* 停止计时；须在其余线程都已结束后调用，之后才能输出 */
+void Profiler::stop()
+{
+    if (!active) return;
+    wall = now();
+    active = false;
+}
+
+void Profiler::enter(Zone z)
+{
+    ThreadLog& log = threadLog();
+    log.stack.push_back(Frame{ z, now(), 0 });
+    ++log.depth[static_cast<int>(z)];
+}
+
+void Profiler::leave()
+{
+    ThreadLog& log = threadLog();
+    if (log.stack.empty()) return;
+    uint64_t t = now();
+    Frame f = log.stack.back();
+    log.stack.pop_back();
+    uint64_t dur = t - f.start;
+    int z = static_cast<int>(f.zone);
+    ZoneStat& st = log.zones[z];
+    ++st.calls;
+    st.self += dur - f.child;
+    if (--log.depth[z] == 0) st.total += dur;
+    if (!log.stack.empty()) log.stack.back().child += dur;
+    if (dur >= minEvent) {
+        if (log.events.size() < MAX_EVENTS) log.events.push_back(Event{ f.zone, f.start, dur });
+        else ++log.dropped;
+    }
+}
+
+void Profiler::add(Counter c, uint64_t n)
+{
+    threadLog().counters[static_cast<int>(c)] += n;
+}
+
+void Profiler::addToken(Tok k)
+{
+    ++threadLog().tokens[static_cast<int>(k)];
+}
+
+/**
+ * @brief
+ * Chrome 跟踪事件格式（JSON 对象形式）：每个区段一个 "X" 事件，时间以微秒计；
+ * 各线程给出线程名，计数器与按种类的记号数在结束时刻各给一个 "C" 事件
+ */
+void Profiler::writeTrace(FILE* fp)
+{
+    std::fputs("{\"traceEvents\":[\n", fp);
+    bool first = true;
+    auto sep = [&] {
+        if (!first) std::fputs(",\n", fp);
+        first = false;
+    };
+    uint64_t counters[COUNTER_COUNT] = {}, tokens[TOK_COUNT] = {}, dropped = 0;
+    for (size_t i = 0; i < logs.size(); ++i) {
+        const ThreadLog& log = *logs[i];
+        sep();
+        std::fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                         "\"args\":{\"name\":\"线程 %d\"}}", log.tid, log.tid);
+        for (size_t k = 0; k < log.events.size(); ++k) {
+            const Event& e = log.events[k];
+            const ZoneInfo& info = ZONE_NAMES[static_cast<int>(e.zone)];
+            sep();
+            std::fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":",
+                         info.name, info.cat, log.tid);
+            printMicros(fp, e.start);
+            std::fputs(",\"dur\":", fp);
+            printMicros(fp, e.dur);
+            std::fputc('}', fp);
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) counters[c] += log.counters[c];
+        for (int k = 0; k < TOK_COUNT; ++k) tokens[k] += log.tokens[k];
+        dropped += log.dropped;
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        if (!counters[c]) continue;
+        sep();
+        std::fprintf(fp, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":", COUNTER_NAMES[c]);
+        printMicros(fp, wall);
+        std::fprintf(fp, ",\"args\":{\"value\":%llu}}", static_cast<unsigned long long>(counters[c]));
+    }
+    sep();
+    std::fputs("{\"name\":\"记号\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":", fp);
+    printMicros(fp, wall);
+    std::fputs(",\"args\":{", fp);
+    bool firstArg = true;
+    for (int k = 0; k < TOK_COUNT; ++k) {
+        if (!tokens[k]) continue;
+        std::fprintf(fp, "%s\"%s\":%llu", firstArg ? "" : ",", tokName(static_cast<Tok>(k)),
+                     static_cast<unsigned long long>(tokens[k]));
+        firstArg = false;
+    }
+    std::fputs("}}\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"droppedEvents\":", fp);
+    std::fprintf(fp, "%llu,\"minEventMicros\":", static_cast<unsigned long long>(dropped));
+    printMicros(fp, minEvent);
+    std::fputs("}\n}\n", fp);
+}
+
+/**
+ * @brief
+ * 汇总表：各区段（合并各线程）的调用次数、总耗时、自身耗时及其占墙钟时间的比例，
+ * 再列出计数器与按种类的记号数（多到少）。多线程时自身耗时之和可以超过墙钟时间
+ */
+void Profiler::writeSummary(FILE* fp)
+{
+    ZoneStat zones[ZONE_COUNT];
+    uint64_t counters[COUNTER_COUNT] = {}, tokens[TOK_COUNT] = {}, events = 0, dropped = 0;
+    for (size_t i = 0; i < logs.size(); ++i) {
+        const ThreadLog& log = *logs[i];
+        for (int z = 0; z < ZONE_COUNT; ++z) {
+            zones[z].calls += log.zones[z].calls;
+            zones[z].total += log.zones[z].total;
+            zones[z].self += log.zones[z].self;
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) counters[c] += log.counters[c];
+        for (int k = 0; k < TOK_COUNT; ++k) tokens[k] += log.tokens[k];
+        events += log.events.size();
+        dropped += log.dropped;
+    }
+
+    padRight(fp, "区段", 16);
+    padLeft(fp, "调用次数", 12);
+    padLeft(fp, "总耗时 ms", 14);
+    padLeft(fp, "自身耗时 ms", 14);
+    padLeft(fp, "自身占比", 10);
+    std::fputc('\n', fp);
+    for (int z = 0; z < ZONE_COUNT; ++z) {
+        const ZoneStat& st = zones[z];
+        if (!st.calls) continue;
+        std::fprintf(fp, "%*s", ZONE_NAMES[z].indent, "");
+        padRight(fp, ZONE_NAMES[z].name, 16 - ZONE_NAMES[z].indent);
+        std::fprintf(fp, "%12llu%14.3f%14.3f%9.1f%%\n", static_cast<unsigned long long>(st.calls),
+                     millis(st.total), millis(st.self), wall ? 100.0 * st.self / wall : 0.0);
+    }
+    std::fprintf(fp, "墙钟时间 %.3f ms；跟踪事件 %llu 个", millis(wall), static_cast<unsigned long long>(events));
+    if (dropped) std::fprintf(fp, "，另有 %llu 个超出上限未记", static_cast<unsigned long long>(dropped));
+    std::fputc('\n', fp);
+
+    for (int c = 0; c < COUNTER_COUNT; ++c)
+        if (counters[c])
+            std::fprintf(fp, "%s %llu\n", COUNTER_NAMES[c], static_cast<unsigned long long>(counters[c]));
+
+    std::vector<int> kinds;
+    uint64_t total = 0;
+    for (int k = 0; k < TOK_COUNT; ++k)
+        if (tokens[k]) {
+            kinds.push_back(k);
+            total += tokens[k];
+        }
+    if (!total) return;
+    std::stable_sort(kinds.begin(), kinds.end(), [&](int a, int b) { return tokens[a] > tokens[b]; });
+    std::fprintf(fp, "记号 %llu", static_cast<unsigned long long>(total));
+    for (size_t i = 0; i < kinds.size(); ++i) {
+        std::fputs(i % 6 ? "  " : "\n  ", fp);
+        std::fprintf(fp, "%s %llu", tokName(static_cast<Tok>(kinds[i])),
+                     static_cast<unsigned long long>(tokens[kinds[i]]));
+    }
+    std::fputc('\n', fp);
+}
+
+ProfileSession::ProfileSession(const std::string& path) : path(path)
+{
+    if (!path.empty()) Profiler::start();
+}
+
+ProfileSession::~ProfileSession()
+{
+    if (path.empty()) return;
+    Profiler::stop();
+    FILE* fp = std::fopen(path.c_str(), "w");
+    if (fp) {
+        Profiler::writeTrace(fp);
+        std::fclose(fp);
+    } else {
+        std::fprintf(stderr, "error:无法写入 %s\n", path.c_str());
+    }
+    Profiler::writeSummary(stderr);
+}
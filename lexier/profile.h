@@ -0,0 +1,122 @@
+#ifndef PL0_PROFILE_H
+#define PL0_PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "token.h"
+
+/*
+ * 编译期开关：PL0_PROFILE 为 0 时计时与计数的代码整个不参与编译。
+ * 缺省打开：没有调用 Profiler::start() 时每个计时区段只多一次对全局标志的判断，发布构建也可以保留。
+ */
+#ifndef PL0_PROFILE
+#  define PL0_PROFILE 1
+#endif
+
+/* 计时区段；名字见 profile.cpp 的 ZONE_NAMES，汇总表按这里的顺序列出 */
+enum class Zone : unsigned char {
+    SOURCE_READ,        // 打开并映射（或读入）源程序
+    TOKEN_FILE,         // 载入记号文件
+    LEX,                // Lexer::next()
+    FETCH,              // 语法分析器取下一个记号（含其中的词法分析）
+    PARSE,              // Parser::parse() / reparse()
+    PROGRAM, BLOCK, CONST_DECL, VAR_DECL, PROC_DECL,
+    STATEMENT, CONDITION, EXPRESSION, TERM, FACTOR,
+    IR,                 // 语法树转中间表示
+    OPTIMIZE,
+    CODEGEN,            // 生成 P-code
+    OUTPUT,             // 输出语法树、记号文件、P-code 或中间表示
+    RUN,                // 解释或即时编译后运行
+    COMPILE_FILE,       // 批量编译中的一个文件
+    COUNT
+};
+
+/* 计数器；记号另按种类计数 */
+enum class Counter : unsigned char {
+    SOURCE_BYTES,
+    COMMENT_BYTES,      // { } 之内的字节
+    LEX_ERRORS,
+    AST_NODES,
+    PCODE,              // 生成的 P-code 指令
+    COUNT
+};
+
+/**
+ * @brief 计时与计数
+ * 进程内只有一个，用静态成员访问。start() 之后各线程进出区段、累加计数，
+ * 每个线程的记录各自存放（首次使用时登记），互不加锁；stop() 须在其余线程都结束后调用，
+ * 此后由 writeTrace() 输出 Chrome 跟踪事件格式的 JSON（chrome://tracing、Perfetto 可直接打开），
+ * writeSummary() 输出按区段汇总的表格。
+ *
+ * 每个区段累计调用次数、总耗时与自身耗时（减去其中嵌套的区段）；递归的区段总耗时只计最外一层。
+ * 跟踪事件只记不短于 minEventNs 的区段，每个线程至多 MAX_EVENTS 个，更短的只进汇总，
+ * 免得逐个记号的区段撑大文件。没有 start() 时所有入口只判断一次 active 就返回。
+ */
+class Profiler {
+public:
+    static bool enabled() { return active; }
+    static void start(uint64_t minEventNs = 10000);
+    static void stop();
+
+    static void enter(Zone z);
+    static void leave();
+    static void count(Counter c, uint64_t n = 1) { if (active) add(c, n); }
+    static void countToken(Tok k) { if (active) addToken(k); }
+
+    static void writeTrace(FILE* fp);
+    static void writeSummary(FILE* fp);
+
+    static const size_t MAX_EVENTS = 1 << 20;
+
+private:
+    static void add(Counter c, uint64_t n);
+    static void addToken(Tok k);
+
+    static bool active;
+};
+
+/* 作用域内计入区段 z；构造时没有 start() 则什么也不做 */
+class ProfileZone {
+public:
+    explicit ProfileZone(Zone z) : open(Profiler::enabled()) { if (open) Profiler::enter(z); }
+    ~ProfileZone() { if (open) Profiler::leave(); }
+
+private:
+    ProfileZone(const ProfileZone&);            // 不可拷贝
+    ProfileZone& operator=(const ProfileZone&);
+
+    bool open;
+};
+
+/**
+ * @brief 命令行的 --profile 文件
+ * path 非空时构造即开始计时；析构时停止，把跟踪事件写到 path，汇总表写标准错误。
+ * 须在使用记号来源、线程池等会开线程的对象之前构造，使其先于本对象析构
+ */
+class ProfileSession {
+public:
+    explicit ProfileSession(const std::string& path);
+    ~ProfileSession();
+
+private:
+    ProfileSession(const ProfileSession&);      // 不可拷贝
+    ProfileSession& operator=(const ProfileSession&);
+
+    std::string path;
+};
+
+#if PL0_PROFILE
+#  define PL0_PROFILE_CAT2(a, b) a##b
+#  define PL0_PROFILE_CAT(a, b) PL0_PROFILE_CAT2(a, b)
+#  define PL0_ZONE(z) ProfileZone PL0_PROFILE_CAT(profileZone_, __LINE__)(z)
+#  define PL0_COUNT(c, n) Profiler::count(c, n)
+#  define PL0_COUNT_TOKEN(k) Profiler::countToken(k)
+#else
+#  define PL0_ZONE(z) ((void)0)
+#  define PL0_COUNT(c, n) ((void)0)
+#  define PL0_COUNT_TOKEN(k) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+#include "ring.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+TokenRing::TokenRing(TokenSource& upstream, size_t capacity, size_t bytes, RingCapture* capture)
+    : upstream(upstream), capture(capture), slots(capacity ? capacity : 1), bytes(bytes ? bytes : 1)
+{
+    producer = std::thread(&TokenRing::produce, this);
+}
+
+TokenRing::~TokenRing()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stopping = true;
+        notFull.notify_all();
+    }
+    producer.join();
+}
+
+/**
+ * @brief
+ * 对方在 cv 上休眠时唤醒它，并清掉 waiting，此后不再为每个记号加锁通知，直到对方再次等待；
+ * 等待方每次检查条件前都在 mtx 下置位 waiting，与计数一样按顺序一致的次序读写，不会漏掉
+ */
+void TokenRing::wake(std::atomic<bool>& waiting, std::condition_variable& cv)
+{
+    if (!waiting.exchange(false)) return;
+    std::lock_guard<std::mutex> lk(mtx);
+    cv.notify_one();
+}
+
+void TokenRing::take(std::string& out, std::string& diag)
+{
+    if (!capture) return;
+    out.swap(capture->out.text);
+    diag.swap(capture->diag.text);
+    capture->out.text.clear();
+    capture->diag.text.clear();
+}
+
+void TokenRing::forward(std::string& out, std::string& diag)
+{
+    if (!capture) return;
+    if (capture->to) capture->to->forward(out, diag);
+    else if (!diag.empty()) std::fputs(diag.c_str(), stderr);
+    out.clear();
+    diag.clear();
+}
+
+/**
+ * @brief
+ * 生产者等到环中至少有 need 个空位、词素环至少有 byteNeed 字节空闲
+ * @return 析构时返回 false
+ */
+bool TokenRing::waitForSpace(size_t need, size_t byteNeed)
+{
+    size_t n = slots.size(), b = bytes.size();
+    auto roomy = [&] {
+        return tail.load(std::memory_order_relaxed) - head.load() + need <= n
+            && byteTail.load(std::memory_order_relaxed) - byteHead.load() + byteNeed <= b;
+    };
+    while (!roomy()) {
+        std::unique_lock<std::mutex> lk(mtx);
+        notFull.wait(lk, [&] {
+            producerWaiting = true;
+            return stopping.load() || roomy();
+        });
+        producerWaiting = false;
+        if (stopping) return false;
+    }
+    return !stopping;
+}
+
+/**
+ * @brief
+ * 后台线程：取尽上游的记号，逐个放进环
+ */
+void TokenRing::produce()
+{
+    Token t;
+    while (upstream.next(t)) {
+        Lexeme lx = upstream.lexeme(t);
+        size_t bt = byteTail.load(std::memory_order_relaxed);
+        size_t pos = bt % bytes.size();
+        size_t skip = lx.len > bytes.size() - pos ? bytes.size() - pos : 0;    // 放不下环尾时从环头开始
+        if (skip + lx.len > bytes.size()) {
+            // 词素太长：等环腾空，从头放起，必要时加倍词素环；此时消费者不持有记号，不会读词素环
+            if (!waitForSpace(slots.size(), bytes.size())) return;
+            if (lx.len > bytes.size()) bytes.resize(std::max(bytes.size() * 2, lx.len));
+            byteHead.store(0);
+            byteTail.store(0);
+            bt = pos = skip = 0;
+        }
+        if (!waitForSpace(1, skip + lx.len)) return;
+        bt += skip;
+        pos = bt % bytes.size();
+        if (lx.len) std::memcpy(&bytes[pos], lx.ptr, lx.len);
+
+        size_t tl = tail.load(std::memory_order_relaxed);
+        Slot& s = slots[tl % slots.size()];
+        s.tok = t;
+        s.tok.off = static_cast<uint32_t>(pos);
+        s.tok.len = static_cast<uint32_t>(lx.len);     // 词素不一定是源程序中的原文，如规范化后的常数
+        s.value = t.kind == Tok::NUMBER ? upstream.number(t) : 0;
+        s.byteEnd = bt + lx.len;
+        take(s.out, s.diag);
+        byteTail.store(bt + lx.len);
+        tail.store(tl + 1);
+        wake(consumerWaiting, notEmpty);
+    }
+    take(lastOut, lastDiag);
+    done = true;
+    wake(consumerWaiting, notEmpty);
+}
+
+/**
+ * @brief
+ * 归还上一次交出的记号，再取下一个；环空时等待生产者
+ */
+bool TokenRing::next(Token& tok)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (holding) {
+        byteHead.store(slots[h % slots.size()].byteEnd);
+        head.store(++h);
+        holding = false;
+        wake(producerWaiting, notFull);
+    }
+    while (tail.load() == h) {
+        if (done.load()) {
+            if (tail.load() != h) break;
+            forward(lastOut, lastDiag);
+            return false;
+        }
+        std::unique_lock<std::mutex> lk(mtx);
+        notEmpty.wait(lk, [&] {
+            consumerWaiting = true;
+            return tail.load() != h || done.load();
+        });
+        consumerWaiting = false;
+    }
+    Slot& s = slots[h % slots.size()];
+    forward(s.out, s.diag);
+    tok = s.tok;
+    holding = true;
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef PL0_RING_H
+#define PL0_RING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "token.h"
+#include "trace.h"
+
+/**
+ * @brief 上游的跟踪与诊断
+ * 上游的 Tracer 写到这里的两个 StringSink；TokenRing 把取每个记号时新写出的文字随记号一起转交，
+ * 消费者取到该记号时再经 to 原样输出（to 为 0 时诊断写标准错误、跟踪丢弃）。
+ * 这样即使后台线程读在前面，输出的内容与先后也和直接从上游取记号时相同。
+ */
+struct RingCapture {
+    StringSink out, diag;
+    Tracer* to = 0;
+};
+
+/**
+ * @brief 定长环形缓冲区上的记号来源
+ * 后台线程从上游记号来源（Lexer、记号文件、管道……）取记号，连同词素拷进固定大小的环，
+ * next() 从环中取；环满时上游等待，环空时 next() 等待。内存只取决于环的大小，与记号流的长度无关，
+ * 取记号与语法分析也因此在两个线程上同时进行。
+ *
+ * 单生产者单消费者：记号与词素各是一个环，读写位置为只增不减的计数，双方各改各的，不加锁；
+ * 只有一方要休眠时才经 mtx 与条件变量交接。词素在词素环中连续存放，放不下环尾时从环头重新开始。
+ * 取出的记号占着环中的位置，直到下一次 next() 才归还，词素因此按 TokenSource 的约定一直有效。
+ *
+ * 上游只在后台线程上使用；标识符的原子在本来源的原子表中查（见 useInterner），不调用上游的 atom()。
+ */
+class TokenRing : public TokenSource {
+public:
+    /* capacity 为环中最多的记号数，bytes 为词素环的字节数；单个词素比词素环还长时，等环腾空后把词素环加倍 */
+    explicit TokenRing(TokenSource& upstream, size_t capacity = 4096, size_t bytes = 64 * 1024,
+                       RingCapture* capture = 0);
+    ~TokenRing();
+
+    bool next(Token& tok) override;
+    Lexeme lexeme(const Token& tok) const override { return Lexeme{ bytes.data() + tok.off, tok.len }; }
+    int64_t number(const Token&) const override { return slots[head.load(std::memory_order_relaxed) % slots.size()].value; }
+
+private:
+    TokenRing(const TokenRing&);            // 不可拷贝
+    TokenRing& operator=(const TokenRing&);
+
+    struct Slot {
+        Token tok;
+        int64_t value;              // 常数的值
+        size_t byteEnd;             // 放入该记号后词素环的写位置，归还时读位置移到这里
+        std::string out, diag;      // 取该记号时上游写出的跟踪与诊断，多数为空
+    };
+
+    void produce();
+    void take(std::string& out, std::string& diag);     // 生产者取走 capture 中新写出的文字
+    void forward(std::string& out, std::string& diag);  // 消费者转发并清空
+    bool waitForSpace(size_t need, size_t byteNeed);
+    void wake(std::atomic<bool>& waiting, std::condition_variable& cv);
+
+    TokenSource& upstream;
+    RingCapture* capture;
+    std::vector<Slot> slots;
+    std::vector<char> bytes;
+
+    // 计数只增不减，下标为计数对容量取模；head 与 byteHead 由消费者写，tail 与 byteTail 由生产者写
+    std::atomic<size_t> head{0}, tail{0};
+    std::atomic<size_t> byteHead{0}, byteTail{0};
+    std::atomic<bool> done{false};          // 上游已取尽，tail 不再增加
+    std::atomic<bool> stopping{false};      // 析构时让生产者退出
+    bool holding = false;                   // 消费者是否占着 head 处的位置（上一次 next() 交出的记号）
+    std::string lastOut, lastDiag;          // 上游取尽时写出的文字，done 之后由消费者转发
+
+    std::mutex mtx;
+    std::condition_variable notEmpty, notFull;
+    std::atomic<bool> consumerWaiting{false}, producerWaiting{false};
+    std::thread producer;
+};
+
+#endif
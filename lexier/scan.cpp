@@ -0,0 +1,261 @@
+#include "scan.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PL0_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/* ------------ 标量实现，同时处理向量实现剩下的尾部 ------------ */
+
+static inline bool isSpaceByte(unsigned char c)
+{
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+static inline bool isAlnumByte(unsigned char c)
+{
+    return static_cast<unsigned char>(c - '0') <= 9
+        || static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+static size_t spaceRunScalar(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k < n && isSpaceByte(s[k]); ++k)
+        if (s[k] == '\n') { ++lines; lastNl = k; }
+    return k;
+}
+
+static size_t commentRunScalar(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k < n && s[k] != '}'; ++k)
+        if (s[k] == '\n') { ++lines; lastNl = k; }
+    return k;
+}
+
+static size_t alnumRunScalar(const unsigned char* s, size_t n)
+{
+    size_t k = 0;
+    while (k < n && isAlnumByte(s[k])) ++k;
+    return k;
+}
+
+#ifdef PL0_SCAN_X86
+
+/*
+ * 向量实现的共同套路：每块算出 "段结束" 位掩码 stop 与换行位掩码 nl，
+ * stop 为 0 时整块都在段内，累计整块的换行后继续；
+ * 否则段在 ctz(stop) 处结束，只统计它之前的换行。
+ */
+static inline void countLines(unsigned long long nl, size_t base, size_t& lines, size_t& lastNl)
+{
+    if (nl) {
+        lines += __builtin_popcountll(nl);
+        lastNl = base + 63 - __builtin_clzll(nl);
+    }
+}
+
+/* 剩下不足一块的尾部交给更窄的实现，它报告的 lastNl 要换算回从 s 起算 */
+static inline size_t tail(size_t (*run)(const unsigned char*, size_t, size_t&, size_t&),
+                          const unsigned char* s, size_t k, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t before = lines;
+    size_t r = run(s + k, n - k, lines, lastNl);
+    if (lines != before) lastNl += k;
+    return r;
+}
+
+static inline unsigned long long below(unsigned bit)
+{
+    return (1ULL << bit) - 1;
+}
+
+/* ---- SSE2：x86-64 的基线指令集，每次 16 字节 ---- */
+
+/* c 落在 [lo, lo+span] 中的字节置 0xFF（无符号比较） */
+static inline __m128i inRange16(__m128i v, char lo, char span)
+{
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(span)), d);
+}
+
+static inline unsigned spaceMask16(__m128i v)
+{
+    __m128i sp = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                              inRange16(v, '\t', '\r' - '\t'));
+    return static_cast<unsigned>(_mm_movemask_epi8(sp));
+}
+
+static inline unsigned alnumMask16(__m128i v)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i an = _mm_or_si128(inRange16(v, '0', 9), inRange16(lower, 'a', 'z' - 'a'));
+    return static_cast<unsigned>(_mm_movemask_epi8(an));
+}
+
+static inline unsigned byteMask16(__m128i v, char c)
+{
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+}
+
+static size_t spaceRunSSE2(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + k));
+        unsigned stop = ~spaceMask16(v) & 0xFFFF;
+        unsigned nl = byteMask16(v, '\n');
+        if (stop) {
+            unsigned end = __builtin_ctz(stop);
+            countLines(nl & below(end), k, lines, lastNl);
+            return k + end;
+        }
+        countLines(nl, k, lines, lastNl);
+    }
+    return k + tail(spaceRunScalar, s, k, n, lines, lastNl);
+}
+
+static size_t commentRunSSE2(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + k));
+        unsigned stop = byteMask16(v, '}');
+        unsigned nl = byteMask16(v, '\n');
+        if (stop) {
+            unsigned end = __builtin_ctz(stop);
+            countLines(nl & below(end), k, lines, lastNl);
+            return k + end;
+        }
+        countLines(nl, k, lines, lastNl);
+    }
+    return k + tail(commentRunScalar, s, k, n, lines, lastNl);
+}
+
+static size_t alnumRunSSE2(const unsigned char* s, size_t n)
+{
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + k));
+        unsigned stop = ~alnumMask16(v) & 0xFFFF;
+        if (stop)
+            return k + __builtin_ctz(stop);
+    }
+    return k + alnumRunScalar(s + k, n - k);
+}
+
+/* ---- AVX2：每次 32 字节，运行时确认 CPU 支持后才会被调用 ---- */
+
+#define PL0_AVX2 __attribute__((target("avx2")))
+
+PL0_AVX2 static inline __m256i inRange32(__m256i v, char lo, char span)
+{
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(span)), d);
+}
+
+PL0_AVX2 static inline unsigned byteMask32(__m256i v, char c)
+{
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+}
+
+PL0_AVX2 static size_t spaceRunAVX2(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k + 32 <= n; k += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + k));
+        __m256i sp = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                     inRange32(v, '\t', '\r' - '\t'));
+        unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(sp));
+        unsigned nl = byteMask32(v, '\n');
+        if (stop) {
+            unsigned end = __builtin_ctz(stop);
+            countLines(nl & below(end), k, lines, lastNl);
+            return k + end;
+        }
+        countLines(nl, k, lines, lastNl);
+    }
+    return k + tail(spaceRunSSE2, s, k, n, lines, lastNl);
+}
+
+PL0_AVX2 static size_t commentRunAVX2(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl)
+{
+    size_t k = 0;
+    for (; k + 32 <= n; k += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + k));
+        unsigned stop = byteMask32(v, '}');
+        unsigned nl = byteMask32(v, '\n');
+        if (stop) {
+            unsigned end = __builtin_ctz(stop);
+            countLines(nl & below(end), k, lines, lastNl);
+            return k + end;
+        }
+        countLines(nl, k, lines, lastNl);
+    }
+    return k + tail(commentRunSSE2, s, k, n, lines, lastNl);
+}
+
+PL0_AVX2 static size_t alnumRunAVX2(const unsigned char* s, size_t n)
+{
+    size_t k = 0;
+    for (; k + 32 <= n; k += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + k));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i an = _mm256_or_si256(inRange32(v, '0', 9), inRange32(lower, 'a', 'z' - 'a'));
+        unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(an));
+        if (stop)
+            return k + __builtin_ctz(stop);
+    }
+    return k + alnumRunSSE2(s + k, n - k);
+}
+
+#undef PL0_AVX2
+
+#endif // PL0_SCAN_X86
+
+/* ------------ 运行时选择 ------------ */
+
+static const ScanKernels scalarKernels = { "scalar", spaceRunScalar, commentRunScalar, alnumRunScalar };
+#ifdef PL0_SCAN_X86
+static const ScanKernels sse2Kernels = { "sse2", spaceRunSSE2, commentRunSSE2, alnumRunSSE2 };
+static const ScanKernels avx2Kernels = { "avx2", spaceRunAVX2, commentRunAVX2, alnumRunAVX2 };
+#endif
+
+const ScanKernels* findScanKernels(const char* name)
+{
+    if (std::strcmp(name, "scalar") == 0)
+        return &scalarKernels;
+#ifdef PL0_SCAN_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+        return &sse2Kernels;
+    if (std::strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+        return &avx2Kernels;
+#endif
+    return nullptr;
+}
+
+static const ScanKernels& chooseScanKernels()
+{
+    const char* forced = std::getenv("PL0_SIMD");
+    if (forced) {
+        const ScanKernels* k = findScanKernels(forced);
+        if (k) return *k;
+    }
+    static const char* const preferred[] = { "avx2", "sse2" };
+    for (const char* name : preferred) {
+        const ScanKernels* k = findScanKernels(name);
+        if (k) return *k;
+    }
+    return scalarKernels;
+}
+
+const ScanKernels& scanKernels()
+{
+    static const ScanKernels& chosen = chooseScanKernels();
+    return chosen;
+}
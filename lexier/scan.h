@@ -0,0 +1,32 @@
+#ifndef PL0_SCAN_H
+#define PL0_SCAN_H
+
+#include <cstddef>
+
+/**
+ * @brief 成段扫描的内核
+ * 词法分析器在空白、注释与标识符内部一次跨过一整段字节，不再逐字节查表。
+ * 每个函数从 s 开始最多看 n 个字节，返回这一段的长度；
+ * 跨过空白与注释时顺带统计换行：lines 加上段内换行数，
+ * 有换行时 lastNl 置为段内最后一个 '\n' 的下标。
+ */
+struct ScanKernels {
+    const char* name;
+    /* 空白（' ' 与 \t \n \v \f \r）连续段 */
+    size_t (*spaceRun)(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl);
+    /* 注释体：到 '}' 为止（不含 '}'），没有 '}' 时为整段 */
+    size_t (*commentRun)(const unsigned char* s, size_t n, size_t& lines, size_t& lastNl);
+    /* 字母数字 [A-Za-z0-9] 连续段 */
+    size_t (*alnumRun)(const unsigned char* s, size_t n);
+};
+
+/*
+ * 进程内首次调用时按 CPU 选择 AVX2 / SSE2 / 标量实现，之后返回同一份。
+ * 环境变量 PL0_SIMD=scalar|sse2|avx2 可以强制指定（CPU 不支持时忽略），便于对照测试。
+ */
+const ScanKernels& scanKernels();
+
+/* 按名字取实现，不支持时返回 nullptr */
+const ScanKernels* findScanKernels(const char* name);
+
+#endif
@@ -0,0 +1,89 @@
+#include "source.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "profile.h"
+
+SourceBuffer::~SourceBuffer()
+{
+    release();
+}
+
+void SourceBuffer::release()
+{
+    if (isMapped) munmap(const_cast<char*>(ptr), len);
+    ptr = "";
+    len = 0;
+    isMapped = false;
+    owned.clear();
+}
+
+/**
+ * @brief
+ * 打开源程序：普通文件直接映射，其他来源整块读入
+ * @param path 文件路径，"-" 表示标准输入
+ * @param err 失败原因
+ */
+bool SourceBuffer::open(const std::string& path, std::string& err)
+{
+    PL0_ZONE(Zone::SOURCE_READ);
+    release();
+    bool ok;
+    if (path == "-") {
+        ok = readAll(STDIN_FILENO, err);
+        if (ok) PL0_COUNT(Counter::SOURCE_BYTES, len);
+        return ok;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "无法打开 " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            ptr = static_cast<const char*>(p);
+            len = static_cast<size_t>(st.st_size);
+            isMapped = true;
+            ok = true;
+        } else {
+            ok = readAll(fd, err);
+        }
+    } else {
+        ok = readAll(fd, err);      // 空文件、FIFO、字符设备等
+    }
+    ::close(fd);
+    if (ok) PL0_COUNT(Counter::SOURCE_BYTES, len);
+    return ok;
+}
+
+/**
+ * @brief
+ * 读到文件尾，用于标准输入与管道
+ */
+bool SourceBuffer::readAll(int fd, std::string& err)
+{
+    char chunk[1 << 16];
+    for (;;) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            err = std::string("读取失败: ") + std::strerror(errno);
+            return false;
+        }
+        owned.append(chunk, static_cast<size_t>(n));
+    }
+    ptr = owned.data();
+    len = owned.size();
+    return true;
+}
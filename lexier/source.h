@@ -0,0 +1,37 @@
+#ifndef PL0_SOURCE_H
+#define PL0_SOURCE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief 只读源程序缓冲区
+ * 普通文件以 mmap 只读映射，词法分析器直接在映射的字节上运行，不拷贝整个文件；
+ * 标准输入、管道等无法映射的来源退化为整块读入内存。
+ */
+class SourceBuffer {
+public:
+    SourceBuffer() {}
+    ~SourceBuffer();
+
+    /* path 为 "-" 时读取标准输入；失败时返回 false 并在 err 中给出原因 */
+    bool open(const std::string& path, std::string& err);
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool mapped() const { return isMapped; }
+
+private:
+    SourceBuffer(const SourceBuffer&);            // 不可拷贝
+    SourceBuffer& operator=(const SourceBuffer&);
+
+    void release();
+    bool readAll(int fd, std::string& err);
+
+    const char* ptr = "";
+    size_t len = 0;
+    bool isMapped = false;
+    std::string owned;      // 非映射来源的内容
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "stack.h"
+
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace {
+
+struct Segment {
+    char* base;     // 含保护页
+    size_t size;
+};
+
+/* 线程退出时归还备用的栈段 */
+struct Spare {
+    std::vector<Segment> list;
+    ~Spare()
+    {
+        for (size_t i = 0; i < list.size(); ++i) munmap(list[i].base, list[i].size);
+    }
+};
+
+thread_local Spare spare;
+
+size_t pageSize()
+{
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+}
+
+/* 不内联进 Stack::call：那里有 getcontext/swapcontext，内联后的局部变量会被 -Wclobbered 报告 */
+__attribute__((noinline)) Segment acquire()
+{
+    if (!spare.list.empty()) {
+        Segment s = spare.list.back();
+        spare.list.pop_back();
+        return s;
+    }
+    size_t size = Stack::SEGMENT + pageSize();
+    void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    mprotect(p, pageSize(), PROT_NONE);     // 栈向下增长，保护页在最低处
+    return Segment{ static_cast<char*>(p), size };
+}
+
+void release(const Segment& s)
+{
+    if (spare.list.empty()) spare.list.push_back(s);
+    else munmap(s.base, s.size);
+}
+
+/* 新栈段上执行的调用，连同切回的上下文 */
+struct Call {
+    void (*fn)(void*);
+    void* arg;
+    std::exception_ptr error;
+    ucontext_t back;
+};
+
+/* makecontext 只能传 int 参数，指针拆成高低两半 */
+void trampoline(unsigned hi, unsigned lo)
+{
+    Call* c = reinterpret_cast<Call*>((static_cast<uintptr_t>(hi) << 16 << 16) | lo);
+    try {
+        c->fn(c->arg);
+    } catch (...) {
+        c->error = std::current_exception();    // 异常不能越过栈段的边界传播
+    }
+}   // 返回即按 uc_link 切回
+
+} // namespace
+
+/**
+ * @brief
+ * 首次检查时取线程栈的下限；取不到时把下限当作就在当前位置，下一次递归即换到自己分配的栈段上
+ */
+char* Stack::init()
+{
+    char* here = static_cast<char*>(__builtin_frame_address(0));
+    char* lim = here;
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* addr;
+        size_t size;
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0 && static_cast<char*>(addr) + RESERVE < here)
+            lim = static_cast<char*>(addr) + RESERVE;
+        pthread_attr_destroy(&attr);
+    }
+    limit() = lim;
+    return lim;
+}
+
+void Stack::call(void (*fn)(void*), void* arg)
+{
+    Segment seg = acquire();
+    Call c;
+    c.fn = fn;
+    c.arg = arg;
+    ucontext_t ctx;
+    getcontext(&ctx);
+    ctx.uc_stack.ss_sp = seg.base + pageSize();
+    ctx.uc_stack.ss_size = seg.size - pageSize();
+    ctx.uc_link = &c.back;
+    uintptr_t p = reinterpret_cast<uintptr_t>(&c);
+    makecontext(&ctx, reinterpret_cast<void (*)()>(trampoline), 2,
+                static_cast<unsigned>(p >> 16 >> 16), static_cast<unsigned>(p));
+
+    char* saved = limit();
+    limit() = seg.base + pageSize() + RESERVE;
+    swapcontext(&c.back, &ctx);
+    limit() = saved;
+    release(seg);
+    if (c.error) std::rethrow_exception(c.error);
+}
@@ -0,0 +1,50 @@
+#ifndef PL0_STACK_H
+#define PL0_STACK_H
+
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * @brief 按需增长的调用栈
+ * 递归下降的分析器与各个按树递归的遍历每深一层就多几个 C++ 栈帧，线程栈（通常 8 MiB）
+ * 只够几万层嵌套。递归函数在入口处检查 low()：当前栈段余下不足 RESERVE 时，
+ * 由 run() 在堆上另分配一个栈段（SEGMENT 字节，mmap 得到，底部一页作保护页），
+ * 切换过去继续递归，返回后切回并归还栈段。嵌套深度因此只受内存限制。
+ *
+ * 没有切换时每次检查只比较一次帧地址；每个栈段够几千层嵌套，切换一次只要几微秒，
+ * 深的输入与平坦的输入吞吐相同。栈段按线程各自管理，归还的栈段留一个备用，
+ * 免得在栈段边界上来回的递归反复映射。
+ */
+class Stack {
+public:
+    static const size_t SEGMENT = size_t(1) << 20;
+    static const size_t RESERVE = size_t(64) << 10;    // 两次检查之间最多用掉的栈，含库函数
+
+    /* 当前栈段余下的空间不足 RESERVE */
+    static bool low()
+    {
+        char* lim = limit();
+        if (!lim) lim = init();
+        return static_cast<char*>(__builtin_frame_address(0)) < lim;
+    }
+
+    /* 在新的栈段上调用 f()，返回后切回；f 抛出的异常在切回后重新抛出 */
+    template <class F>
+    static void run(F&& f)
+    {
+        call([](void* p) { (*static_cast<typename std::remove_reference<F>::type*>(p))(); }, &f);
+    }
+
+private:
+    static void call(void (*fn)(void*), void* arg);
+    static char* init();
+
+    /* 当前栈段的下限加上 RESERVE；未初始化时为 nullptr */
+    static char*& limit()
+    {
+        static thread_local char* lim = nullptr;
+        return lim;
+    }
+};
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef PL0_TOKEN_H
+#define PL0_TOKEN_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "number.h"
+
+/**
+ * @brief 记号种类
+ * 词法分析器与语法分析器共用；枚举值即二进制记号文件中的种类码，
+ * 不要调整已有顺序，END 须保持在最后。
+ */
+enum class Tok : unsigned char {
+    /* 关键字 */
+    BEGINSYM, ENDSYM,
+    CONSTSYM, VARSYM, PROCEDURESYM, CALLSYM,
+    IFSYM, ELSESYM, THENSYM, WHILESYM, DOSYM, ODDSYM,
+    READSYM, WRITESYM,
+    /* 标识符 / 常数 */
+    IDENT, NUMBER,
+    /* 运算符与界符 */
+    PLUS, MINUS, TIMES, SLASH,
+    EQL, NEQ, LSS, LEQ, GTR, GEQ,
+    BECOMES,
+    LPAREN, RPAREN, COMMA, SEMICOLON, PERIOD,
+    END       // 虚拟 EOF
+};
+
+/* 种类数量（含 END） */
+const int TOK_COUNT = static_cast<int>(Tok::END) + 1;
+
+/**
+ * @brief
+ * 种类名，与文本记号文件 (type,lexeme) 中的 type 一致
+ * @param t
+ * @return const char*
+ */
+inline const char* tokName(Tok t)
+{
+    static const char* const names[TOK_COUNT] = {
+        "beginsym", "endsym",
+        "constsym", "varsym", "proceduresym", "callsym",
+        "ifsym", "elsesym", "thensym", "whilesym", "dosym", "oddsym",
+        "readsym", "writesym",
+        "ident", "number",
+        "plus", "minus", "times", "slash",
+        "eql", "neq", "lss", "leq", "gtr", "geq",
+        "becomes",
+        "lparen", "rparen", "comma", "semicolon", "period",
+        "EOF"
+    };
+    return names[static_cast<int>(t)];
+}
+
+/* ------------ 编译期完美哈希 ------------ */
+
+/* 名字 -> 记号种类 */
+struct NameKind {
+    const char* name;
+    unsigned char len;
+    Tok kind;
+};
+
+constexpr unsigned char cstrLen(const char* s)
+{
+    return *s ? 1 + cstrLen(s + 1) : 0;
+}
+
+template <unsigned... I> struct IndexSeq {};
+template <unsigned N, unsigned... I> struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+template <unsigned... I> struct MakeIndexSeq<0, I...> { typedef IndexSeq<I...> type; };
+
+/* 按哈希值排好槽位的名字表，空槽 len 为 0 */
+template <unsigned Size>
+struct PerfectHashTable {
+    NameKind slot[Size];
+};
+
+/**
+ * @brief 编译期生成完美哈希表
+ * Keys 提供 size（槽数）、count（名字数）、entry(k)（第 k 个名字）、hash(s, n) 与 miss（查不到时的种类）。
+ * 表在编译期逐槽填好，是常量初始化的数据，程序启动时没有任何构造开销；
+ * perfect() 检查没有两个名字落在同一槽、各名字的 len 与实际长度一致，供 static_assert 使用。
+ */
+template <class Keys>
+struct PerfectHash {
+    static constexpr unsigned hashOf(unsigned k)
+    {
+        return Keys::hash(Keys::entry(k).name, Keys::entry(k).len);
+    }
+    /* 落在槽 h 的名字编号，没有则为 -1 */
+    static constexpr int find(unsigned h, unsigned k)
+    {
+        return k == Keys::count ? -1 : hashOf(k) == h ? int(k) : find(h, k + 1);
+    }
+    static constexpr unsigned hits(unsigned h, unsigned k)
+    {
+        return k == Keys::count ? 0 : (hashOf(k) == h) + hits(h, k + 1);
+    }
+    static constexpr NameKind slotAt(unsigned h)
+    {
+        return find(h, 0) < 0 ? NameKind{ "", 0, Keys::miss } : Keys::entry(find(h, 0));
+    }
+    template <unsigned... I>
+    static constexpr PerfectHashTable<sizeof...(I)> build(IndexSeq<I...>)
+    {
+        return {{ slotAt(I)... }};
+    }
+    static constexpr PerfectHashTable<Keys::size> build()
+    {
+        return build(typename MakeIndexSeq<Keys::size>::type());
+    }
+    static constexpr bool lengthsOk(unsigned k = 0)
+    {
+        return k == Keys::count || (Keys::entry(k).len == cstrLen(Keys::entry(k).name) && lengthsOk(k + 1));
+    }
+    static constexpr bool perfect(unsigned h = 0)
+    {
+        return h == Keys::size ? lengthsOk() : hits(h, 0) <= 1 && perfect(h + 1);
+    }
+};
+
+/* 在完美哈希表的槽 h 中查一次：命中返回其种类，否则返回 miss */
+inline Tok probe(const NameKind* slots, unsigned h, const char* s, size_t n, Tok miss)
+{
+    const NameKind& e = slots[h];
+    return e.len == n && std::memcmp(e.name, s, n) == 0 ? e.kind : miss;
+}
+
+/* 种类名表，与 tokName 一致（不含 EOF） */
+constexpr NameKind TOK_NAMES[] = {
+    { "beginsym", 8, Tok::BEGINSYM }, { "endsym", 6, Tok::ENDSYM },
+    { "constsym", 8, Tok::CONSTSYM }, { "varsym", 6, Tok::VARSYM },
+    { "proceduresym", 12, Tok::PROCEDURESYM }, { "callsym", 7, Tok::CALLSYM },
+    { "ifsym", 5, Tok::IFSYM }, { "elsesym", 7, Tok::ELSESYM }, { "thensym", 7, Tok::THENSYM },
+    { "whilesym", 8, Tok::WHILESYM }, { "dosym", 5, Tok::DOSYM }, { "oddsym", 6, Tok::ODDSYM },
+    { "readsym", 7, Tok::READSYM }, { "writesym", 8, Tok::WRITESYM },
+    { "ident", 5, Tok::IDENT }, { "number", 6, Tok::NUMBER },
+    { "plus", 4, Tok::PLUS }, { "minus", 5, Tok::MINUS }, { "times", 5, Tok::TIMES }, { "slash", 5, Tok::SLASH },
+    { "eql", 3, Tok::EQL }, { "neq", 3, Tok::NEQ }, { "lss", 3, Tok::LSS },
+    { "leq", 3, Tok::LEQ }, { "gtr", 3, Tok::GTR }, { "geq", 3, Tok::GEQ },
+    { "becomes", 7, Tok::BECOMES },
+    { "lparen", 6, Tok::LPAREN }, { "rparen", 6, Tok::RPAREN }, { "comma", 5, Tok::COMMA },
+    { "semicolon", 9, Tok::SEMICOLON }, { "period", 6, Tok::PERIOD }
+};
+
+/* 种类名的哈希：取前三个字符与长度，32 个名字落在 64 个槽中互不冲突 */
+struct TokNameKeys {
+    static constexpr unsigned size = 64;
+    static constexpr unsigned count = TOK_COUNT - 1;
+    static constexpr Tok miss = Tok::END;
+    static constexpr NameKind entry(unsigned k) { return TOK_NAMES[k]; }
+    static constexpr unsigned hash(const char* s, size_t n)
+    {
+        return (static_cast<unsigned char>(s[0]) * 33u + static_cast<unsigned char>(s[1]) * 18u
+              + static_cast<unsigned char>(s[2]) * 33u + static_cast<unsigned>(n)) & 63u;
+    }
+};
+
+static_assert(sizeof(TOK_NAMES) / sizeof(TOK_NAMES[0]) == TokNameKeys::count, "TOK_NAMES 与 Tok 不一致");
+static_assert(PerfectHash<TokNameKeys>::perfect(), "种类名哈希出现冲突");
+
+constexpr PerfectHashTable<TokNameKeys::size> tokNameTable = PerfectHash<TokNameKeys>::build();
+
+/**
+ * @brief
+ * 由种类名得到记号种类，未知名称返回 Tok::END
+ * @param name
+ * @param n 名称长度
+ * @return Tok
+ */
+inline Tok tokFromName(const char* name, size_t n)
+{
+    if (n < 3) return Tok::END;
+    return probe(tokNameTable.slot, TokNameKeys::hash(name, n), name, n, Tok::END);
+}
+
+inline Tok tokFromName(const std::string& name)
+{
+    return tokFromName(name.data(), name.size());
+}
+
+/* 词素视图 (指针, 长度)，不持有内存 */
+struct Lexeme {
+    const char* ptr;
+    size_t len;
+
+    std::string str() const { return std::string(ptr, len); }
+};
+
+/**
+ * @brief 记号
+ * 词法分析器与语法分析器共用的紧凑记号，16 字节，不含指针与字符串：
+ * (off, len) 是词素在记号来源缓冲区中的区间（Lexer 为源程序，记号文件为词素池），
+ * (line, col) 是记号在源程序中的起始位置，line 为 0 表示位置未知。
+ */
+struct Token {
+    uint32_t off;
+    uint32_t len;
+    uint32_t line;
+    uint16_t col;    // 超过 65535 时饱和
+    Tok kind;
+};
+
+class Interner;
+
+/**
+ * @brief 记号来源
+ * 语法分析器通过它按需拉取记号，不要求整条记号流驻留内存。
+ * 标识符另由 atom() 给出其在原子表中的编号，默认使用进程内共用的 Interner::global()；
+ * 常数的值由 number() 给出，语法分析器不再解析词素。
+ */
+class TokenSource {
+public:
+    TokenSource();
+    virtual ~TokenSource() {}
+    /* 取下一个记号，记号流结束时返回 false */
+    virtual bool next(Token& tok) = 0;
+    /* 刚取出的记号的词素，只保证在下一次 next() 之前有效 */
+    virtual Lexeme lexeme(const Token& tok) const = 0;
+    /* 刚取出的标识符的原子编号，同一原子表中同名标识符编号相同（定义在 intern.cpp） */
+    virtual uint32_t atom(const Token& tok);
+    /* 刚取出的常数的整数部分（超出 int64 时取 INT64_MAX）；默认由词素求得，Lexer 直接给出扫描时算好的值 */
+    virtual int64_t number(const Token& tok) const
+    {
+        Lexeme l = lexeme(tok);
+        return numberValue(l.ptr, l.len);
+    }
+
+    std::string text(const Token& tok) const { return lexeme(tok).str(); }
+
+    /* 改用指定的原子表，须在取记号之前设置 */
+    void useInterner(Interner& table) { atoms = &table; }
+    Interner& interner() const { return *atoms; }
+
+protected:
+    Interner* atoms;
+};
+
+#endif
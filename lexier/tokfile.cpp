@@ -0,0 +1,425 @@
+#include "tokfile.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "intern.h"
+#include "profile.h"
+
+/* ------------ 小端整数与 varint ------------ */
+
+static void putU32(std::string& buf, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+static uint32_t getU32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+static void putVarint(std::string& buf, uint32_t v)
+{
+    while (v >= 0x80) {
+        buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+/**
+ * @brief
+ * 读取一个 varint，越界或超过 32 位时返回 false
+ */
+static bool getVarint(const unsigned char*& p, const unsigned char* end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) return false;
+        unsigned char b = *p++;
+        v |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+/* 有符号的增量映射为无符号数，绝对值小的编码短 */
+static uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+/* 一个记号在记号流中至少占的字节数 */
+static size_t minTokenBytes(unsigned char version) { return version == 1 ? 2 : 4; }
+
+/* ------------ 记号来源 ------------ */
+
+bool TokenFileSource::next(Token& tok)
+{
+    if (pos >= tf.size()) return false;
+    uint32_t id = tf.lexIds[pos];
+    lexId = id;
+    tok.kind = tf.kinds[pos];
+    tok.off = tf.lexOff[id];
+    tok.len = tf.lexOff[id + 1] - tf.lexOff[id];
+    tok.line = tf.lines.empty() ? 0 : tf.lines[pos];
+    tok.col = tf.cols.empty() ? 0 : tf.cols[pos];
+    ++pos;
+    return true;
+}
+
+uint32_t TokenFileSource::atom(const Token& tok)
+{
+    if (cachedFor != atoms) {
+        atomOf.assign(tf.lexemeCount(), Interner::NONE);
+        cachedFor = atoms;
+    }
+    uint32_t& a = atomOf[lexId];
+    if (a == Interner::NONE) a = atoms->intern(lexeme(tok));
+    return a;
+}
+
+/* ------------ 写出 ------------ */
+
+/**
+ * @brief
+ * 以 (type,lexeme) 文本格式写出记号流，每行一个记号
+ * @param out
+ * @param src 记号来源，边取边写，每攒满 64 KiB 写出一次
+ */
+void writeTokensText(std::ostream& out, TokenSource& src)
+{
+    PL0_ZONE(Zone::OUTPUT);
+    std::string buf;
+    Token tok;
+    while (src.next(tok)) {
+        Lexeme lx = src.lexeme(tok);
+        buf += '(';
+        buf += tokName(tok.kind);
+        buf += ',';
+        buf.append(lx.ptr, lx.len);
+        buf += ")\n";
+        if (buf.size() >= 64 * 1024) {      // 按块写出，写到管道时下游可以边读边分析
+            out.write(buf.data(), buf.size());
+            buf.clear();
+        }
+    }
+    out.write(buf.data(), buf.size());
+}
+
+/**
+ * @brief
+ * 以二进制格式写出记号流：边取记号边去重词素建表，最后一并写出；行号存相对上一个记号的增量
+ * @param out
+ * @param src 记号来源
+ * @return true 写出成功
+ */
+bool writeTokensBinary(std::ostream& out, TokenSource& src)
+{
+    PL0_ZONE(Zone::OUTPUT);
+    std::unordered_map<std::string, uint32_t> ids;
+    std::string lexTab, body;
+    uint32_t ntok = 0;
+    uint32_t prevLine = 0;
+
+    Token tok;
+    while (src.next(tok)) {
+        Lexeme lx = src.lexeme(tok);
+        auto ins = ids.insert(std::make_pair(lx.str(), static_cast<uint32_t>(ids.size())));
+        if (ins.second) {
+            putVarint(lexTab, static_cast<uint32_t>(lx.len));
+            lexTab.append(lx.ptr, lx.len);
+        }
+        body.push_back(static_cast<char>(tok.kind));
+        putVarint(body, ins.first->second);
+        putVarint(body, zigzag(static_cast<int32_t>(tok.line - prevLine)));
+        putVarint(body, tok.col);
+        prevLine = tok.line;
+        ++ntok;
+    }
+
+    std::string head(TOKFILE_MAGIC, sizeof(TOKFILE_MAGIC));
+    head.push_back(static_cast<char>(TOKFILE_VERSION));
+    head.append(3, '\0');
+    putU32(head, ntok);
+    putU32(head, static_cast<uint32_t>(ids.size()));
+
+    out.write(head.data(), head.size());
+    out.write(lexTab.data(), lexTab.size());
+    out.write(body.data(), body.size());
+    return static_cast<bool>(out);
+}
+
+/* ------------ 读入 ------------ */
+
+/**
+ * @brief
+ * 判断文件是否为二进制记号文件（检查魔数）
+ * @param path
+ */
+bool isBinaryTokenFile(const std::string& path)
+{
+    std::ifstream fin(path, std::ios::binary);
+    char magic[sizeof(TOKFILE_MAGIC)];
+    if (!fin.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, TOKFILE_MAGIC, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief
+ * 读取二进制记号文件：整块读入后一次性解码，词素只拷贝进词素池一次
+ * @param path
+ * @param tf 输出
+ * @param err 失败原因
+ */
+bool readTokensBinary(const std::string& path, TokenFile& tf, std::string& err)
+{
+    PL0_ZONE(Zone::TOKEN_FILE);
+    std::ifstream fin(path, std::ios::binary | std::ios::ate);
+    if (!fin) { err = "无法打开 " + path; return false; }
+    std::streamoff size = fin.tellg();
+    fin.seekg(0);
+    std::string data(static_cast<size_t>(size), '\0');
+    if (!fin.read(&data[0], size)) { err = "读取失败 " + path; return false; }
+
+    const unsigned char* p   = reinterpret_cast<const unsigned char*>(data.data());
+    const unsigned char* end = p + data.size();
+
+    if (data.size() < TOKFILE_HEADER_SIZE || std::memcmp(p, TOKFILE_MAGIC, sizeof(TOKFILE_MAGIC)) != 0) {
+        err = "不是二进制记号文件";
+        return false;
+    }
+    unsigned char version = p[4];
+    if (version != 1 && version != TOKFILE_VERSION) { err = "不支持的记号文件版本"; return false; }
+    uint32_t ntok = getU32(p + 8);
+    uint32_t nlex = getU32(p + 12);
+    p += TOKFILE_HEADER_SIZE;
+    // 每个词素至少 1 个字节，先与文件长度核对，免得按损坏的计数预留内存
+    if (nlex > static_cast<size_t>(end - p)) { err = "词素数超出文件长度"; return false; }
+
+    /* 词素表 */
+    tf.pool.clear();
+    tf.pool.reserve(data.size());
+    tf.lexOff.assign(1, 0);
+    tf.lexOff.reserve(nlex + 1);
+    for (uint32_t i = 0; i < nlex; ++i) {
+        uint32_t len;
+        if (!getVarint(p, end, len) || len > static_cast<size_t>(end - p)) {
+            err = "词素表损坏";
+            return false;
+        }
+        tf.pool.append(reinterpret_cast<const char*>(p), len);
+        tf.lexOff.push_back(static_cast<uint32_t>(tf.pool.size()));
+        p += len;
+    }
+
+    /* 记号流 */
+    if (ntok > static_cast<size_t>(end - p) / minTokenBytes(version)) { err = "记号数超出文件长度"; return false; }
+    tf.kinds.clear();
+    tf.lexIds.clear();
+    tf.lines.clear();
+    tf.cols.clear();
+    tf.kinds.reserve(ntok);
+    tf.lexIds.reserve(ntok);
+    if (version != 1) {
+        tf.lines.reserve(ntok);
+        tf.cols.reserve(ntok);
+    }
+    uint32_t line = 0;
+    for (uint32_t i = 0; i < ntok; ++i) {
+        uint32_t id;
+        if (p == end || *p >= static_cast<unsigned char>(Tok::END)) { err = "记号种类码非法"; return false; }
+        Tok k = static_cast<Tok>(*p++);
+        if (!getVarint(p, end, id) || id >= nlex) { err = "词素编号越界"; return false; }
+        tf.kinds.push_back(k);
+        tf.lexIds.push_back(id);
+        if (version == 1) continue;
+        uint32_t dline, col;
+        if (!getVarint(p, end, dline) || !getVarint(p, end, col)) { err = "记号位置损坏"; return false; }
+        line += static_cast<uint32_t>(unzigzag(dline));
+        tf.lines.push_back(line);
+        tf.cols.push_back(static_cast<uint16_t>(col > 0xffff ? 0xffff : col));
+    }
+    return true;
+}
+
+/**
+ * @brief
+ * 解析文本记号文件的一行 "(种类名,词素)"，种类名与词素各自去掉首尾空白
+ * @param lb, le 词素在 line 中的区间
+ * @return 1 为一个记号，0 为空行，-1 为格式错误（err 中给出原因）
+ */
+static int parseTokenLine(const std::string& line, Tok& kind, size_t& lb, size_t& le, std::string& err)
+{
+    size_t b = 0, e = line.size();
+    while (b < e && std::isspace(static_cast<unsigned char>(line[b]))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(line[e - 1]))) --e;
+    if (b == e) return 0;
+    if (line[b] != '(' || line[e - 1] != ')') { err = "格式错误: " + line; return -1; }
+    ++b; --e;                                       /* 去掉括号 */
+    size_t comma = line.find(',', b);
+    if (comma == std::string::npos || comma >= e) { err = "缺少逗号: " + line; return -1; }
+
+    size_t tb = b, te = comma;
+    lb = comma + 1; le = e;
+    while (tb < te && std::isspace(static_cast<unsigned char>(line[tb]))) ++tb;
+    while (te > tb && std::isspace(static_cast<unsigned char>(line[te - 1]))) --te;
+    while (lb < le && std::isspace(static_cast<unsigned char>(line[lb]))) ++lb;
+    while (le > lb && std::isspace(static_cast<unsigned char>(line[le - 1]))) --le;
+    kind = tokFromName(line.data() + tb, te - tb);
+    return 1;
+}
+
+/**
+ * @brief
+ * 读取 (type,lexeme) 文本记号文件：逐行解析后与二进制格式一样存入 TokenFile，
+ * 相同词素在词素池中只存一份
+ * @param path
+ * @param tf 输出
+ * @param err 失败原因
+ */
+bool readTokensText(const std::string& path, TokenFile& tf, std::string& err)
+{
+    PL0_ZONE(Zone::TOKEN_FILE);
+    std::ifstream fin(path);
+    if (!fin) { err = "无法打开 " + path; return false; }
+
+    std::unordered_map<std::string, uint32_t> ids;
+    tf.pool.clear();
+    tf.lexOff.assign(1, 0);
+    tf.kinds.clear();
+    tf.lexIds.clear();
+    tf.lines.clear();
+    tf.cols.clear();
+
+    std::string line;
+    Tok kind;
+    size_t lb, le;
+    while (std::getline(fin, line)) {
+        int r = parseTokenLine(line, kind, lb, le, err);
+        if (r < 0) return false;
+        if (r == 0) continue;
+        auto ins = ids.insert(std::make_pair(line.substr(lb, le - lb), static_cast<uint32_t>(ids.size())));
+        if (ins.second) {
+            tf.pool.append(line, lb, le - lb);
+            tf.lexOff.push_back(static_cast<uint32_t>(tf.pool.size()));
+        }
+        tf.kinds.push_back(kind);
+        tf.lexIds.push_back(ins.first->second);
+    }
+    return true;
+}
+
+/* ------------ 流式读入 ------------ */
+
+/* 从流中读一个 varint，流结束或超过 32 位时返回 false */
+static bool readVarint(std::istream& in, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int b = in.get();
+        if (b == std::char_traits<char>::eof()) return false;
+        v |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief
+ * 看开头是否为魔数以确定格式；二进制格式读入文件头与词素表
+ * @return 格式错误时返回 false，原因在 err 中
+ */
+bool TokenStreamSource::start()
+{
+    if (in.peek() != TOKFILE_MAGIC[0]) {    // 文本格式的行以 '(' 或空白开头；空输入也按文本处理
+        format = TEXT;
+        return true;
+    }
+    unsigned char head[TOKFILE_HEADER_SIZE];
+    if (!in.read(reinterpret_cast<char*>(head), sizeof(head))
+        || std::memcmp(head, TOKFILE_MAGIC, sizeof(TOKFILE_MAGIC)) != 0) {
+        err = "不是记号文件";
+        return false;
+    }
+    version = head[4];
+    if (version != 1 && version != TOKFILE_VERSION) { err = "不支持的记号文件版本"; return false; }
+    remaining = getU32(head + 8);
+    uint32_t nlex = getU32(head + 12);
+    prevLine = 0;
+    table.pool.clear();
+    table.lexOff.assign(1, 0);
+    for (uint32_t i = 0; i < nlex; ++i) {
+        uint32_t len;
+        if (!readVarint(in, len)) { err = "词素表损坏"; return false; }
+        // 按块扩大词素池，长度损坏时在流结束处失败，而不是先分配出巨大的缓冲区
+        for (uint32_t left = len; left; ) {
+            uint32_t n = left < 65536 ? left : 65536;
+            size_t at = table.pool.size();
+            table.pool.resize(at + n);
+            if (!in.read(&table.pool[at], n)) { err = "词素表损坏"; return false; }
+            left -= n;
+        }
+        table.lexOff.push_back(static_cast<uint32_t>(table.pool.size()));
+    }
+    format = BINARY;
+    return true;
+}
+
+bool TokenStreamSource::next(Token& tok)
+{
+    if (format == UNKNOWN && !start()) format = FAILED;
+    if (format == FAILED) return false;
+    tok.line = 0;
+    tok.col = 0;
+    if (format == BINARY) {
+        if (!remaining) return false;
+        int k = in.get();
+        uint32_t id;
+        if (k == std::char_traits<char>::eof()) { err = "记号流不完整"; format = FAILED; return false; }
+        if (k >= static_cast<int>(Tok::END)) { err = "记号种类码非法"; format = FAILED; return false; }
+        if (!readVarint(in, id) || id >= table.lexemeCount()) { err = "词素编号越界"; format = FAILED; return false; }
+        if (version != 1) {
+            uint32_t dline, col;
+            if (!readVarint(in, dline) || !readVarint(in, col)) { err = "记号位置损坏"; format = FAILED; return false; }
+            prevLine += static_cast<uint32_t>(unzigzag(dline));
+            tok.line = prevLine;
+            tok.col = static_cast<uint16_t>(col > 0xffff ? 0xffff : col);
+        }
+        --remaining;
+        lexId = id;
+        tok.kind = static_cast<Tok>(k);
+        tok.off = table.lexOff[id];
+        tok.len = table.lexOff[id + 1] - table.lexOff[id];
+        return true;
+    }
+    Tok kind;
+    size_t lb, le;
+    while (std::getline(in, line)) {
+        int r = parseTokenLine(line, kind, lb, le, err);
+        if (r < 0) { format = FAILED; return false; }
+        if (r == 0) continue;
+        tok.kind = kind;
+        tok.off = static_cast<uint32_t>(lb);
+        tok.len = static_cast<uint32_t>(le - lb);
+        return true;
+    }
+    return false;
+}
+
+Lexeme TokenStreamSource::lexeme(const Token& tok) const
+{
+    return Lexeme{ (format == BINARY ? table.pool.data() : line.data()) + tok.off, tok.len };
+}
+
+uint32_t TokenStreamSource::atom(const Token& tok)
+{
+    if (format != BINARY) return TokenSource::atom(tok);
+    if (cachedFor != atoms) {
+        atomOf.assign(table.lexemeCount(), Interner::NONE);
+        cachedFor = atoms;
+    }
+    uint32_t& a = atomOf[lexId];
+    if (a == Interner::NONE) a = atoms->intern(lexeme(tok));
+    return a;
+}
@@ -0,0 +1,109 @@
+#ifndef PL0_TOKFILE_H
+#define PL0_TOKFILE_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "token.h"
+
+/*
+ * 二进制记号文件格式 (.tokb)，所有整数均为小端
+ *
+ *   文件头 16 字节:
+ *     "PL0T" | 版本 u8 | 保留 3 字节 | 记号数 u32 | 词素数 u32
+ *   词素表 (去重后的词素，按首次出现顺序):
+ *     词素数 项，每项 varint 长度 + 原始字节
+ *   记号流:
+ *     记号数 项，每项 种类码 u8 (即 Tok 的值) + varint 词素编号
+ *                   + varint 行号增量 (相对上一个记号，zigzag 编码) + varint 列号
+ *
+ * 相同词素只存一份，行号按增量存，绝大多数记号只占 4 个字节。
+ * 版本 1 的记号没有行号与列号，仍可读入，读出的记号位置为 0。
+ */
+
+const char TOKFILE_MAGIC[4] = {'P', 'L', '0', 'T'};
+const unsigned char TOKFILE_VERSION = 2;
+const size_t TOKFILE_HEADER_SIZE = 16;
+
+/**
+ * @brief 读入内存的二进制记号文件
+ * 所有词素首尾相接存放在 pool 中，记号只保存 (种类, 词素编号)，
+ * 加载过程中不为单个记号分配字符串。
+ */
+struct TokenFile {
+    std::string pool;               // 词素池
+    std::vector<uint32_t> lexOff;   // 第 i 个词素为 pool[lexOff[i], lexOff[i+1])
+    std::vector<Tok> kinds;         // 记号种类
+    std::vector<uint32_t> lexIds;   // 记号对应的词素编号
+    std::vector<uint32_t> lines;    // 记号的行号与列号；文件不含位置（文本格式、版本 1）时为空
+    std::vector<uint16_t> cols;
+
+    size_t size() const { return kinds.size(); }
+    size_t lexemeCount() const { return lexOff.empty() ? 0 : lexOff.size() - 1; }
+};
+
+/* 依次给出 TokenFile 中的记号，词素区间即词素池中的区间；记号文件不含位置时行号、列号为 0 */
+class TokenFileSource : public TokenSource {
+public:
+    explicit TokenFileSource(const TokenFile& tf) : tf(tf) {}
+    bool next(Token& tok) override;
+    Lexeme lexeme(const Token& tok) const override { return Lexeme{ tf.pool.data() + tok.off, tok.len }; }
+    /* 记号文件中的词素已去重：每个词素只查一次原子表，按词素编号缓存 */
+    uint32_t atom(const Token& tok) override;
+private:
+    const TokenFile& tf;
+    size_t pos = 0;
+    uint32_t lexId = 0;                 // 刚取出的记号的词素编号
+    std::vector<uint32_t> atomOf;       // 词素编号 -> 原子，未查过为 NONE
+    const Interner* cachedFor = nullptr;
+};
+
+/**
+ * @brief 边读边给出记号的记号文件
+ * 从流中读取文本或二进制记号文件（按开头是否为魔数区分），不把整个文件读入内存：
+ * 文本格式只保留当前一行；二进制格式先读入词素表，记号流逐个解码。
+ * 可以直接读管道，如 ./lexer -v 0 a.pl0 /dev/stdout | ./parser --stream -
+ */
+class TokenStreamSource : public TokenSource {
+public:
+    explicit TokenStreamSource(std::istream& in) : in(in) {}
+    bool next(Token& tok) override;
+    Lexeme lexeme(const Token& tok) const override;
+    /* 二进制格式中的词素已去重，按词素编号缓存原子 */
+    uint32_t atom(const Token& tok) override;
+    /* 格式错误时 next() 返回 false，由此给出原因；正常结束时为空 */
+    const std::string& error() const { return err; }
+private:
+    bool start();
+    std::istream& in;
+    enum { UNKNOWN, TEXT, BINARY, FAILED } format = UNKNOWN;
+    std::string line;                   // 文本格式的当前行
+    TokenFile table;                    // 二进制格式的词素表（kinds 与 lexIds 不用）
+    uint32_t remaining = 0;             // 二进制格式尚未读出的记号数
+    unsigned char version = 0;          // 二进制格式的版本
+    uint32_t prevLine = 0;              // 上一个记号的行号，行号增量相对于它
+    uint32_t lexId = 0;
+    std::vector<uint32_t> atomOf;       // 词素编号 -> 原子，未查过为 NONE
+    const Interner* cachedFor = nullptr;
+    std::string err;
+};
+
+/* 取尽 src 中的记号，以 (type,lexeme) 文本格式写出 */
+void writeTokensText(std::ostream& out, TokenSource& src);
+
+/* 取尽 src 中的记号，以二进制格式写出 */
+bool writeTokensBinary(std::ostream& out, TokenSource& src);
+
+/* 文件是否以二进制记号文件魔数开头 */
+bool isBinaryTokenFile(const std::string& path);
+
+/* 读取二进制记号文件，失败时返回 false 并在 err 中给出原因 */
+bool readTokensBinary(const std::string& path, TokenFile& tf, std::string& err);
+
+/* 读取 (type,lexeme) 文本记号文件，失败时返回 false 并在 err 中给出原因 */
+bool readTokensText(const std::string& path, TokenFile& tf, std::string& err);
+
+#endif
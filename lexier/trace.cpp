@@ -0,0 +1,132 @@
+#include "trace.h"
+
+/* ------------ 输出端 ------------ */
+
+BufferedSink::BufferedSink(FILE* fp, size_t capacity) : fp(fp), capacity(capacity)
+{
+    buf.reserve(capacity);
+}
+
+BufferedSink::~BufferedSink()
+{
+    flush();
+}
+
+void BufferedSink::write(const char* s, size_t n)
+{
+    if (buf.size() + n > capacity) flush();
+    if (n >= capacity) {
+        if (fp) std::fwrite(s, 1, n, fp);
+        return;
+    }
+    buf.append(s, n);
+}
+
+void BufferedSink::flush()
+{
+    if (fp && !buf.empty()) {
+        std::fwrite(buf.data(), 1, buf.size(), fp);
+        std::fflush(fp);
+    }
+    buf.clear();
+}
+
+FileSink::FileSink(const std::string& path) : BufferedSink(std::fopen(path.c_str(), "w"))
+{
+}
+
+FileSink::~FileSink()
+{
+    flush();
+    if (fp) std::fclose(fp);
+    fp = 0;
+}
+
+/* ------------ 格式化 ------------ */
+
+static void appendUInt(std::string& s, unsigned v)
+{
+    char tmp[10];
+    int n = 0;
+    do { tmp[n++] = static_cast<char>('0' + v % 10); v /= 10; } while (v);
+    while (n) s.push_back(tmp[--n]);
+}
+
+static void appendPos(std::string& s, unsigned line, unsigned col)
+{
+    s += ") at Line ";
+    appendUInt(s, line);
+    s += ", Col ";
+    appendUInt(s, col);
+    s += '\n';
+}
+
+Tracer::Tracer(TraceSink& out, TraceSink& diag, TraceLevel level)
+    : out(out), diag(diag), lvl(level)
+{
+}
+
+void Tracer::token(Tok kind, Lexeme lx, unsigned ln, unsigned col)
+{
+    if (!on(TraceLevel::TOKEN)) return;
+    line.assign("Token: (");
+    line += tokName(kind);
+    line += ", ";
+    line.append(lx.ptr, lx.len);
+    appendPos(line, ln, col);
+    out.write(line.data(), line.size());
+}
+
+void Tracer::eof(unsigned ln, unsigned col)
+{
+    if (!on(TraceLevel::TOKEN)) return;
+    line.assign("Token: (EOF, ");
+    appendPos(line, ln, col);
+    out.write(line.data(), line.size());
+}
+
+void Tracer::info(const char* msg)
+{
+    if (!on(TraceLevel::INFO)) return;
+    line.assign(msg);
+    line += '\n';
+    out.write(line.data(), line.size());
+}
+
+void Tracer::error(int n, const char* msg)
+{
+    if (!on(TraceLevel::ERROR)) return;
+    char head[16];
+    std::snprintf(head, sizeof(head), "Error %3d: ", n);
+    line.assign(head);
+    line += msg;
+    line += '\n';
+    diag.write(line.data(), line.size());
+}
+
+void Tracer::badChar(char c, unsigned ln, unsigned col)
+{
+    if (!on(TraceLevel::ERROR)) return;
+    line.assign("报错字符：");
+    line += c;
+    line += " at Line ";
+    appendUInt(line, ln);
+    line += ", Column ";
+    appendUInt(line, col);
+    line += '\n';
+    diag.write(line.data(), line.size());
+}
+
+void Tracer::forward(const std::string& outText, const std::string& diagText)
+{
+    if (!outText.empty())
+        out.write(outText.data(), outText.size());
+    if (!diagText.empty())
+        diag.write(diagText.data(), diagText.size());
+}
+
+void Tracer::flush()
+{
+    out.flush();
+    diag.flush();
+}
@@ -0,0 +1,113 @@
+#ifndef PL0_TRACE_H
+#define PL0_TRACE_H
+
+#include <cstdio>
+#include <string>
+
+#include "token.h"
+
+/*
+ * 编译期开关：PL0_TRACE_TOKENS 为 0 时逐记号跟踪的代码整个不参与编译。
+ * 缺省在定义了 NDEBUG 的发布构建中关闭，也可以用 -DPL0_TRACE_TOKENS=0/1 显式指定。
+ */
+#ifndef PL0_TRACE_TOKENS
+#  ifdef NDEBUG
+#    define PL0_TRACE_TOKENS 0
+#  else
+#    define PL0_TRACE_TOKENS 1
+#  endif
+#endif
+
+/* 输出级别，数值越大输出越多 */
+enum class TraceLevel : unsigned char {
+    SILENT = 0,   // 什么都不输出
+    ERROR  = 1,   // 词法错误
+    INFO   = 2,   // 阶段信息，如 "Lexical analysis END."
+    TOKEN  = 3    // 逐个记号
+};
+
+/**
+ * @brief 输出端
+ * 跟踪信息写到哪里由它决定；Tracer 只负责格式化与级别过滤。
+ */
+class TraceSink {
+public:
+    virtual ~TraceSink() {}
+    virtual void write(const char* s, size_t n) = 0;
+    virtual void flush() {}
+};
+
+/* 丢弃一切输出 */
+class NullSink : public TraceSink {
+public:
+    void write(const char*, size_t) override {}
+};
+
+/* 攒在内存里，供分块并行分析先收集、再按顺序转发 */
+class StringSink : public TraceSink {
+public:
+    void write(const char* s, size_t n) override { text.append(s, n); }
+    std::string text;
+};
+
+/**
+ * @brief 带缓冲的 FILE* 输出
+ * 攒满缓冲区或 flush() 时才整块写出，不再每个记号刷新一次。
+ */
+class BufferedSink : public TraceSink {
+public:
+    explicit BufferedSink(FILE* fp, size_t capacity = 1 << 16);
+    ~BufferedSink();
+    void write(const char* s, size_t n) override;
+    void flush() override;
+
+protected:
+    FILE* fp;
+    std::string buf;
+    size_t capacity;
+};
+
+/* 写入文件，析构时关闭 */
+class FileSink : public BufferedSink {
+public:
+    explicit FileSink(const std::string& path);
+    ~FileSink();
+    bool ok() const { return fp != 0; }
+};
+
+/**
+ * @brief 跟踪与诊断
+ * 记号跟踪与阶段信息写到 out，错误诊断单独写到 diag，两者互不混杂；
+ * 高于 level 的信息在格式化之前就被丢弃。
+ */
+class Tracer {
+public:
+    Tracer(TraceSink& out, TraceSink& diag, TraceLevel level);
+    ~Tracer() { flush(); }
+
+    bool on(TraceLevel l) const { return l <= lvl; }
+    TraceLevel level() const { return lvl; }
+
+    /* Token: (种类, 词素) at Line .., Col .. */
+    void token(Tok kind, Lexeme lx, unsigned line, unsigned col);
+    /* Token: (EOF, ) at Line .., Col .. */
+    void eof(unsigned line, unsigned col);
+    /* 阶段信息，原样输出一行 */
+    void info(const char* msg);
+    /* Error nn: err_msg[n] */
+    void error(int n, const char* msg);
+    /* 非法字符 */
+    void badChar(char c, unsigned line, unsigned col);
+    /* 原样转发另一个 Tracer 已按级别过滤、格式化好的跟踪与诊断 */
+    void forward(const std::string& outText, const std::string& diagText);
+
+    void flush();
+
+private:
+    TraceSink& out;
+    TraceSink& diag;
+    TraceLevel lvl;
+    std::string line;   // 拼装当前行，避免逐段写入
+};
+
+#endif
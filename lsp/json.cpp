@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "json.h"
+
+const Json& Json::nil()
+{
+    static const Json empty;
+    return empty;
+}
+
+const Json& Json::operator[](const char* key) const
+{
+    for (const std::pair<std::string, Json>& m : members)
+        if (m.first == key) return m.second;
+    return nil();
+}
+
+bool Json::has(const char* key) const
+{
+    for (const std::pair<std::string, Json>& m : members)
+        if (m.first == key) return true;
+    return false;
+}
+
+Json& Json::push(Json v)
+{
+    type = Type::ARRAY;
+    items.push_back(std::move(v));
+    return *this;
+}
+
+Json& Json::set(const char* key, Json v)
+{
+    type = Type::OBJECT;
+    for (std::pair<std::string, Json>& m : members)
+        if (m.first == key) {
+            m.second = std::move(v);
+            return *this;
+        }
+    members.push_back(std::make_pair(std::string(key), std::move(v)));
+    return *this;
+}
+
+/* ------------ 解析 ------------ */
+
+/* 递归下降解析，嵌套深度有上限，免得恶意的输入耗尽栈 */
+class JsonReader {
+public:
+    JsonReader(const char* text, size_t n) : p(text), end(text + n) {}
+
+    bool document(Json& out)
+    {
+        if (!value(out, 0)) return false;
+        space();
+        return p == end;
+    }
+
+private:
+    static const int MAX_DEPTH = 256;
+    const char* p;
+    const char* end;
+
+    void space()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    bool literal(const char* word)
+    {
+        for (; *word; ++word, ++p)
+            if (p == end || *p != *word) return false;
+        return true;
+    }
+
+    static int hex(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool unit(unsigned& u)
+    {
+        if (end - p < 4) return false;
+        u = 0;
+        for (int k = 0; k < 4; ++k) {
+            int h = hex(*p++);
+            if (h < 0) return false;
+            u = u << 4 | static_cast<unsigned>(h);
+        }
+        return true;
+    }
+
+    static void utf8(std::string& out, unsigned c)
+    {
+        if (c < 0x80) out += static_cast<char>(c);
+        else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | c >> 6);
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | c >> 12);
+            out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | c >> 18);
+            out += static_cast<char>(0x80 | (c >> 12 & 0x3F));
+            out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    bool string(std::string& out)
+    {
+        ++p;    // '"'
+        for (;;) {
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            out.append(run, p);
+            if (p == end) return false;
+            if (*p++ == '"') return true;
+            if (p == end) return false;
+            char c = *p++;
+            switch (c) {
+                case '"': case '\\': case '/': out += c; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned u;
+                    if (!unit(u)) return false;
+                    // 代理对合成一个码点，落单的代理按原值写出
+                    if (u >= 0xD800 && u < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                        const char* save = p;
+                        p += 2;
+                        unsigned lo;
+                        if (unit(lo) && lo >= 0xDC00 && lo < 0xE000) u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                        else p = save;
+                    }
+                    utf8(out, u);
+                    break;
+                }
+                default: return false;
+            }
+        }
+    }
+
+    bool value(Json& out, int depth)
+    {
+        space();
+        if (p == end || depth > MAX_DEPTH) return false;
+        switch (*p) {
+            case 'n': return literal("null");
+            case 't': out = Json(true); return literal("true");
+            case 'f': out = Json(false); return literal("false");
+            case '"': out.type = Json::Type::STRING; return string(out.str);
+            case '[': {
+                ++p;
+                out = Json::array();
+                space();
+                if (p < end && *p == ']') { ++p; return true; }
+                for (;;) {
+                    out.items.push_back(Json());
+                    if (!value(out.items.back(), depth + 1)) return false;
+                    space();
+                    if (p == end) return false;
+                    if (*p == ']') { ++p; return true; }
+                    if (*p++ != ',') return false;
+                }
+            }
+            case '{': {
+                ++p;
+                out = Json::object();
+                space();
+                if (p < end && *p == '}') { ++p; return true; }
+                for (;;) {
+                    space();
+                    if (p == end || *p != '"') return false;
+                    out.members.push_back(std::make_pair(std::string(), Json()));
+                    if (!string(out.members.back().first)) return false;
+                    space();
+                    if (p == end || *p++ != ':') return false;
+                    if (!value(out.members.back().second, depth + 1)) return false;
+                    space();
+                    if (p == end) return false;
+                    if (*p == '}') { ++p; return true; }
+                    if (*p++ != ',') return false;
+                }
+            }
+            default: {
+                // strtod 需要以 NUL 结尾的串：数字不长，拷出来再转
+                const char* s = p;
+                while (p < end && (isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) ++p;
+                if (s == p || p - s > 64) return false;
+                char buf[72];
+                std::copy(s, p, buf);
+                buf[p - s] = '\0';
+                char* stop;
+                out = Json(std::strtod(buf, &stop));
+                return *stop == '\0';
+            }
+        }
+    }
+};
+
+bool Json::parse(const char* text, size_t n, Json& out)
+{
+    out = Json();
+    return JsonReader(text, n).document(out);
+}
+
+/* ------------ 输出 ------------ */
+
+void appendJsonString(std::string& out, const char* s, size_t n)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t k = 0; k < n; ++k) {
+        unsigned char c = static_cast<unsigned char>(s[k]);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += digits[c >> 4];
+                    out += digits[c & 15];
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+}
+
+void Json::write(std::string& out) const
+{
+    switch (type) {
+        case Type::NUL: out += "null"; break;
+        case Type::BOOL: out += flag ? "true" : "false"; break;
+        case Type::NUMBER: {
+            char buf[32];
+            if (num == std::floor(num) && std::fabs(num) < 9e15) snprintf(buf, sizeof buf, "%.0f", num);
+            else snprintf(buf, sizeof buf, "%.17g", num);
+            out += buf;
+            break;
+        }
+        case Type::STRING:
+            out += '"';
+            appendJsonString(out, str.data(), str.size());
+            out += '"';
+            break;
+        case Type::ARRAY:
+            out += '[';
+            for (size_t k = 0; k < items.size(); ++k) {
+                if (k) out += ',';
+                items[k].write(out);
+            }
+            out += ']';
+            break;
+        case Type::OBJECT:
+            out += '{';
+            for (size_t k = 0; k < members.size(); ++k) {
+                if (k) out += ',';
+                out += '"';
+                appendJsonString(out, members[k].first.data(), members[k].first.size());
+                out += "\":";
+                members[k].second.write(out);
+            }
+            out += '}';
+            break;
+    }
+}
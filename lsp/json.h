@@ -0,0 +1,75 @@
+#ifndef PL0_JSON_H
+#define PL0_JSON_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief JSON 值
+ * 只为语言服务器的消息而设：对象的成员按插入顺序存放，查找逐个比较（消息的对象都很小）；
+ * 数值一律为 double，足以表示请求编号、行列号等整数。
+ */
+class Json {
+public:
+    enum class Type : unsigned char { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    Json() {}
+    Json(bool b) : type(Type::BOOL), flag(b) {}
+    Json(int n) : type(Type::NUMBER), num(n) {}
+    Json(unsigned n) : type(Type::NUMBER), num(n) {}
+    Json(size_t n) : type(Type::NUMBER), num(static_cast<double>(n)) {}
+    Json(double n) : type(Type::NUMBER), num(n) {}
+    Json(const char* s) : type(Type::STRING), str(s) {}
+    Json(const std::string& s) : type(Type::STRING), str(s) {}
+    Json(std::string&& s) : type(Type::STRING), str(std::move(s)) {}
+
+    static Json array() { Json j; j.type = Type::ARRAY; return j; }
+    static Json object() { Json j; j.type = Type::OBJECT; return j; }
+
+    Type kind() const { return type; }
+    bool isNull() const { return type == Type::NUL; }
+    bool isNumber() const { return type == Type::NUMBER; }
+    bool isString() const { return type == Type::STRING; }
+    bool isArray() const { return type == Type::ARRAY; }
+    bool isObject() const { return type == Type::OBJECT; }
+
+    /* 取值；类型不符时返回 def */
+    bool boolean(bool def = false) const { return type == Type::BOOL ? flag : def; }
+    double number(double def = 0) const { return type == Type::NUMBER ? num : def; }
+    const std::string& string() const { return str; }
+
+    /* 数组元素与对象成员；不存在时返回空值 */
+    size_t size() const { return type == Type::ARRAY ? items.size() : type == Type::OBJECT ? members.size() : 0; }
+    const Json& operator[](size_t i) const { return i < items.size() ? items[i] : nil(); }
+    const Json& operator[](const char* key) const;
+    bool has(const char* key) const;
+
+    /* 追加数组元素；对象成员已有时覆盖 */
+    Json& push(Json v);
+    Json& set(const char* key, Json v);
+
+    /* 解析一段 JSON 文本，出错时返回 false */
+    static bool parse(const char* text, size_t n, Json& out);
+    static bool parse(const std::string& text, Json& out) { return parse(text.data(), text.size(), out); }
+
+    /* 紧凑地写成文本，追加到 out */
+    void write(std::string& out) const;
+
+private:
+    Type type = Type::NUL;
+    bool flag = false;
+    double num = 0;
+    std::string str;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;
+
+    static const Json& nil();
+    friend class JsonReader;
+};
+
+/* 把 s 转义成 JSON 字符串的内容（不含引号），追加到 out */
+void appendJsonString(std::string& out, const char* s, size_t n);
+
+#endif
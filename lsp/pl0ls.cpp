@@ -0,0 +1,28 @@
+#include <cstring>
+#include <iostream>
+
+#include "server.h"
+
+/*
+ * PL/0 语言服务器，经标准输入输出与编辑器通信（LSP），见 server.h
+ *
+ * 用法: ./pl0ls [--log]
+ *   --log  每条消息的方法名与处理耗时写到标准错误
+ */
+
+int main(int argc, char* argv[])
+{
+    bool log = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--log")) log = true;
+        else if (!std::strcmp(argv[i], "--stdio")) {}      // 编辑器常加的选项，本来就走标准输入输出
+        else {
+            std::cerr << "用法: " << argv[0] << " [--log]\n";
+            return 1;
+        }
+    }
+    std::ios::sync_with_stdio(false);
+    Server server(std::cin, std::cout);
+    if (log) server.setLog(&std::cerr);
+    return server.run();
+}
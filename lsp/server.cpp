@@ -0,0 +1,502 @@
+#include <chrono>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+
+#include "server.h"
+
+namespace {
+
+// JSON-RPC 与 LSP 的错误码
+const int PARSE_ERROR = -32700;
+const int INVALID_REQUEST = -32600;
+const int METHOD_NOT_FOUND = -32601;
+const int INVALID_PARAMS = -32602;
+const int SERVER_NOT_INITIALIZED = -32002;
+
+// LSP 的 SymbolKind
+const int SYMBOL_FUNCTION = 12;
+const int SYMBOL_VARIABLE = 13;
+const int SYMBOL_CONSTANT = 14;
+
+bool isWordChar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/* 偏移 offset 处记号的字节数：标识符与数取整个词，其余取一个字符（UTF-8 多字节字符取整个） */
+size_t tokenBytes(const Document& doc, size_t offset)
+{
+    size_t k = offset;
+    if (k >= doc.size() || doc.at(k) == '\n') return 0;
+    if (isWordChar(doc.at(k))) {
+        while (k < doc.size() && isWordChar(doc.at(k))) ++k;
+        return k - offset;
+    }
+    ++k;
+    while (k < doc.size() && (static_cast<unsigned char>(doc.at(k)) & 0xC0) == 0x80) ++k;
+    return k - offset;
+}
+
+}
+
+Server::Server(std::istream& in, std::ostream& out) : in(in), out(out) {}
+
+/* ------------ 消息的收发 ------------ */
+
+/* 读一条消息的正文；输入结束或头部无效时返回 false */
+bool Server::readMessage(std::string& body)
+{
+    size_t length = std::string::npos;
+    std::string line;
+    for (;;) {
+        if (!std::getline(in, line)) return false;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) {
+            if (length != std::string::npos) break;
+            continue;
+        }
+        if (line.compare(0, 15, "Content-Length:") == 0) length = std::strtoul(line.c_str() + 15, 0, 10);
+    }
+    body.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&body[0], static_cast<std::streamsize>(length)));
+}
+
+void Server::send(const Json& msg)
+{
+    buffer.clear();
+    msg.write(buffer);
+    out << "Content-Length: " << buffer.size() << "\r\n\r\n";
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+}
+
+void Server::reply(const Json& id, Json result)
+{
+    Json msg = Json::object();
+    msg.set("jsonrpc", "2.0");
+    msg.set("id", id);
+    msg.set("result", std::move(result));
+    send(msg);
+}
+
+void Server::replyError(const Json& id, int code, const std::string& message)
+{
+    Json error = Json::object();
+    error.set("code", code);
+    error.set("message", message);
+    Json msg = Json::object();
+    msg.set("jsonrpc", "2.0");
+    msg.set("id", id);
+    msg.set("error", std::move(error));
+    send(msg);
+}
+
+int Server::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    std::string body;
+    while (!exiting && readMessage(body)) {
+        Clock::time_point t0 = Clock::now();
+        Json msg;
+        if (!Json::parse(body, msg) || !msg.isObject()) {
+            replyError(Json(), PARSE_ERROR, "消息不是有效的 JSON");
+            continue;
+        }
+        handle(msg);
+        if (log) {
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+            *log << msg["method"].string() << ' ' << static_cast<long>(us) << " us\n";
+        }
+    }
+    return shuttingDown ? 0 : 1;
+}
+
+void Server::handle(const Json& msg)
+{
+    if (!msg.has("method")) return;     // 客户端对请求的回复：服务器不发请求，忽略
+    const std::string& method = msg["method"].string();
+    const Json& id = msg["id"];
+    const Json& params = msg["params"];
+    bool request = msg.has("id");
+
+    if (method == "exit") {
+        exiting = true;
+        return;
+    }
+    if (method == "initialize") {
+        initialized = true;
+        Json sync = Json::object();
+        sync.set("openClose", true);
+        sync.set("change", 2);          // 增量
+        Json caps = Json::object();
+        caps.set("textDocumentSync", std::move(sync));
+        caps.set("documentSymbolProvider", true);
+        caps.set("definitionProvider", true);
+        caps.set("hoverProvider", true);
+        Json info = Json::object();
+        info.set("name", "pl0ls");
+        Json result = Json::object();
+        result.set("capabilities", std::move(caps));
+        result.set("serverInfo", std::move(info));
+        reply(id, std::move(result));
+        return;
+    }
+    if (!initialized || shuttingDown) {
+        if (request) {
+            if (shuttingDown) replyError(id, INVALID_REQUEST, "服务器正在关闭");
+            else replyError(id, SERVER_NOT_INITIALIZED, "尚未收到 initialize");
+        }
+        return;
+    }
+
+    if (method == "textDocument/didOpen") didOpen(params);
+    else if (method == "textDocument/didChange") didChange(params);
+    else if (method == "textDocument/didClose") didClose(params);
+    else if (method == "shutdown") {
+        shuttingDown = true;
+        reply(id, Json());
+    } else if (method == "textDocument/documentSymbol") {
+        Document* doc = find(params);
+        if (doc) reply(id, documentSymbols(*doc));
+        else replyError(id, INVALID_PARAMS, "文档未打开");
+    } else if (method == "textDocument/definition") {
+        if (find(params)) reply(id, definition(params));
+        else replyError(id, INVALID_PARAMS, "文档未打开");
+    } else if (method == "textDocument/hover") {
+        if (find(params)) reply(id, hover(params));
+        else replyError(id, INVALID_PARAMS, "文档未打开");
+    } else if (request) {
+        replyError(id, METHOD_NOT_FOUND, "不支持的方法 " + method);
+    }
+    // 其余通知（initialized、$/cancelRequest 等）不需要处理
+}
+
+/* ------------ 文档 ------------ */
+
+Document* Server::find(const Json& params)
+{
+    std::unordered_map<std::string, Open>::iterator it = docs.find(params["textDocument"]["uri"].string());
+    return it == docs.end() ? nullptr : it->second.doc.get();
+}
+
+void Server::didOpen(const Json& params)
+{
+    const Json& td = params["textDocument"];
+    Open& open = docs[td["uri"].string()];
+    open.doc.reset(new Document(td["text"].string()));
+    open.version = td["version"];
+    publish(td["uri"].string(), open);
+}
+
+void Server::didChange(const Json& params)
+{
+    const Json& td = params["textDocument"];
+    std::unordered_map<std::string, Open>::iterator it = docs.find(td["uri"].string());
+    if (it == docs.end()) return;
+    Document& doc = *it->second.doc;
+    const Json& changes = params["contentChanges"];
+    for (size_t k = 0; k < changes.size(); ++k) {
+        const Json& c = changes[k];
+        if (!c.has("range")) {
+            doc.setText(c["text"].string());
+            continue;
+        }
+        size_t from, to;
+        if (!toOffset(doc, c["range"]["start"], from) || !toOffset(doc, c["range"]["end"], to) || to < from) continue;
+        doc.edit(from, to - from, c["text"].string());
+    }
+    it->second.version = td["version"];
+    publish(td["uri"].string(), it->second);
+}
+
+void Server::didClose(const Json& params)
+{
+    const std::string& uri = params["textDocument"]["uri"].string();
+    docs.erase(uri);
+    Json p = Json::object();
+    p.set("uri", uri);
+    p.set("diagnostics", Json::array());
+    Json msg = Json::object();
+    msg.set("jsonrpc", "2.0");
+    msg.set("method", "textDocument/publishDiagnostics");
+    msg.set("params", std::move(p));
+    send(msg);
+}
+
+/* 发布文档的全部诊断：位置取报错处的记号 */
+void Server::publish(const std::string& uri, Open& open)
+{
+    Document& doc = *open.doc;
+    Json list = Json::array();
+    for (const Diagnostic& d : doc.diagnostics()) {
+        Pos p{ static_cast<uint32_t>(d.line), static_cast<uint32_t>(d.col) };
+        if (p.line == 0) p = Pos{ 1, 1 };
+        Json item = Json::object();
+        item.set("range", lspRange(doc, p, tokenBytes(doc, doc.offsetOf(p.line, p.col))));
+        item.set("severity", 1);
+        item.set("source", "pl0");
+        item.set("message", d.message);
+        list.push(std::move(item));
+    }
+    Json p = Json::object();
+    p.set("uri", uri);
+    if (!open.version.isNull()) p.set("version", open.version);
+    p.set("diagnostics", std::move(list));
+    Json msg = Json::object();
+    msg.set("jsonrpc", "2.0");
+    msg.set("method", "textDocument/publishDiagnostics");
+    msg.set("params", std::move(p));
+    send(msg);
+}
+
+/* ------------ 位置换算 ------------ */
+
+Json Server::lspPosition(Document& doc, Pos p)
+{
+    size_t start = doc.offsetOf(p.line, 1), end = doc.offsetOf(p.line, p.col);
+    unsigned units = 0;
+    for (size_t k = start; k < end; ++k) {
+        unsigned char c = static_cast<unsigned char>(doc.at(k));
+        if ((c & 0xC0) != 0x80) units += c >= 0xF0 ? 2 : 1;    // 四字节的字符在 UTF-16 中为代理对
+    }
+    Json pos = Json::object();
+    pos.set("line", p.line ? p.line - 1 : 0);
+    pos.set("character", units);
+    return pos;
+}
+
+Json Server::lspRange(Document& doc, Pos p, size_t bytes)
+{
+    Json range = Json::object();
+    range.set("start", lspPosition(doc, p));
+    range.set("end", lspPosition(doc, Pos{ p.line, p.col + static_cast<uint32_t>(bytes) }));
+    return range;
+}
+
+/* LSP 的位置换成文本偏移；列超出行尾时取行尾 */
+bool Server::toOffset(Document& doc, const Json& position, size_t& offset)
+{
+    if (!position["line"].isNumber() || !position["character"].isNumber()) return false;
+    double line = position["line"].number(), character = position["character"].number();
+    if (line < 0 || character < 0) return false;
+    if (line >= static_cast<double>(doc.lineCount())) {
+        offset = doc.size();
+        return true;
+    }
+    size_t k = doc.offsetOf(static_cast<uint32_t>(line) + 1, 1);
+    for (double units = 0; units < character && k < doc.size() && doc.at(k) != '\n';) {
+        units += static_cast<unsigned char>(doc.at(k)) >= 0xF0 ? 2 : 1;
+        ++k;
+        while (k < doc.size() && (static_cast<unsigned char>(doc.at(k)) & 0xC0) == 0x80) ++k;
+    }
+    offset = k;
+    return true;
+}
+
+bool Server::toPos(Document& doc, const Json& position, Pos& p)
+{
+    size_t offset;
+    if (!toOffset(doc, position, offset)) return false;
+    doc.positionOf(offset, p.line, p.col);
+    return true;
+}
+
+/* ------------ 名字 ------------ */
+
+Server::Pos Server::nodePos(Document& doc, uint32_t id)
+{
+    Pos p;
+    doc.position(id, p.line, p.col);
+    return p;
+}
+
+/**
+ * @brief
+ * 自根向下找位置 p 上的标识符叶子，经过的块依次放入 scopes
+ * @return 标识符结点，p 不在标识符上时为 NIL
+ */
+uint32_t Server::identAt(Document& doc, Pos p, std::vector<Scope>& scopes)
+{
+    const Ast& ast = doc.nodes();
+    if (ast.empty()) return Ast::NIL;
+    uint32_t node = ast.root(), proc = Ast::NIL;
+    for (;;) {
+        const Node& n = ast[node];
+        if (n.kind == NodeKind::PROC_DECL) proc = node;
+        else if (n.kind == NodeKind::BLOCK) scopes.push_back(Scope{ node, proc });
+        if (isLeaf(n.kind)) break;
+        // 子结点按位置排列：二分找最后一个从 p 或 p 之前开始的，位置未知的结点不算在 p 之后
+        const std::vector<uint32_t>& kids = doc.children(node);
+        size_t lo = 0, hi = kids.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            const Node& c = ast[kids[mid]];
+            if (c.line != 0 && c.col != 0xFFFF && p < nodePos(doc, kids[mid])) hi = mid;
+            else lo = mid + 1;
+        }
+        if (lo == 0) return Ast::NIL;
+        node = kids[lo - 1];
+    }
+    const Node& n = ast[node];
+    if (ast.atom(n) == Ast::NIL) return Ast::NIL;
+    Pos q = nodePos(doc, node);
+    if (q.line != p.line || p.col >= q.col + ast.text(n).len) return Ast::NIL;
+    return node;
+}
+
+/**
+ * @brief
+ * 标识符 ident 所指的声明：从最内层的块起，找位置不在它之后的同名声明，同一块中有多个时取最后一个
+ * @param decl 声明结点（CONST_DECL、VAR_DECL 或 PROC_DECL）
+ * @param owner 声明所在块所属的过程，主程序为 NIL
+ * @return 声明处的标识符结点，找不到时为 NIL
+ */
+uint32_t Server::resolve(Document& doc, const std::vector<Scope>& scopes, uint32_t ident, uint32_t& decl, uint32_t& owner)
+{
+    const Ast& ast = doc.nodes();
+    uint32_t name = ast.atom(ast[ident]);
+    Pos at = nodePos(doc, ident);
+    for (size_t k = scopes.size(); k-- > 0;) {
+        uint32_t found = Ast::NIL;
+        for (uint32_t c = ast[scopes[k].block].first; c != Ast::NIL; c = ast[c].next) {
+            NodeKind kind = ast[c].kind;
+            uint32_t x;
+            if (kind == NodeKind::CONST_DECL || kind == NodeKind::VAR_DECL) x = ast[c].first;
+            else if (kind == NodeKind::PROC_DECL) x = ast.child(c, 1);
+            else break;     // 声明之后是语句
+            for (; x != Ast::NIL; x = kind == NodeKind::PROC_DECL ? Ast::NIL : ast[x].next) {
+                if (ast.atom(ast[x]) != name || at < nodePos(doc, x)) continue;
+                found = x;
+                decl = c;
+            }
+        }
+        if (found != Ast::NIL) {
+            owner = scopes[k].proc;
+            return found;
+        }
+    }
+    return Ast::NIL;
+}
+
+Json Server::definition(const Json& params)
+{
+    Document& doc = *find(params);
+    Pos p;
+    std::vector<Scope> scopes;
+    uint32_t decl, owner;
+    if (!toPos(doc, params["position"], p)) return Json();
+    uint32_t ident = identAt(doc, p, scopes);
+    if (ident == Ast::NIL) return Json();
+    uint32_t target = resolve(doc, scopes, ident, decl, owner);
+    if (target == Ast::NIL) return Json();
+    Json loc = Json::object();
+    loc.set("uri", params["textDocument"]["uri"]);
+    loc.set("range", lspRange(doc, nodePos(doc, target), doc.nodes().text(doc.nodes()[target]).len));
+    return loc;
+}
+
+Json Server::hover(const Json& params)
+{
+    Document& doc = *find(params);
+    const Ast& ast = doc.nodes();
+    Pos p;
+    std::vector<Scope> scopes;
+    uint32_t decl, owner;
+    if (!toPos(doc, params["position"], p)) return Json();
+    uint32_t ident = identAt(doc, p, scopes);
+    if (ident == Ast::NIL) return Json();
+    uint32_t target = resolve(doc, scopes, ident, decl, owner);
+    if (target == Ast::NIL) return Json();
+
+    std::string text = "```pl0\n";
+    std::string name = ast.text(ast[target]).str();
+    switch (ast[decl].kind) {
+        case NodeKind::CONST_DECL: {
+            text += "const " + name;
+            uint32_t eq = ast[target].next;
+            uint32_t num = eq != Ast::NIL ? ast[eq].next : Ast::NIL;
+            if (num != Ast::NIL && ast[num].kind == NodeKind::NUMBER) text += " = " + ast.text(ast[num]).str();
+            break;
+        }
+        case NodeKind::VAR_DECL: text += "var " + name; break;
+        default: text += "procedure " + name; break;
+    }
+    text += "\n```\n";
+    if (owner == Ast::NIL) {
+        text += "主程序中声明";
+    } else {
+        uint32_t procName = ast.child(owner, 1);
+        text += "过程 `";
+        if (procName != Ast::NIL && ast.atom(ast[procName]) != Ast::NIL) text += ast.text(ast[procName]).str();
+        text += "` 中声明";
+    }
+    text += "，第 " + std::to_string(nodePos(doc, target).line) + " 行";
+
+    Json contents = Json::object();
+    contents.set("kind", "markdown");
+    contents.set("value", std::move(text));
+    Json result = Json::object();
+    result.set("contents", std::move(contents));
+    result.set("range", lspRange(doc, nodePos(doc, ident), ast.text(ast[ident]).len));
+    return result;
+}
+
+/* ------------ 文档大纲 ------------ */
+
+Json Server::documentSymbols(Document& doc)
+{
+    Json out = Json::array();
+    const Ast& ast = doc.nodes();
+    if (ast.empty()) return out;
+    uint32_t main = ast.child(ast.root(), 0);
+    if (main != Ast::NIL && ast[main].kind == NodeKind::BLOCK) blockSymbols(doc, main, out);
+    return out;
+}
+
+/* 块中的声明；过程的范围从 procedure 到下一个声明或语句之前 */
+void Server::blockSymbols(Document& doc, uint32_t block, Json& out)
+{
+    const Ast& ast = doc.nodes();
+    for (uint32_t c = ast[block].first; c != Ast::NIL; c = ast[c].next) {
+        NodeKind kind = ast[c].kind;
+        if (kind == NodeKind::CONST_DECL || kind == NodeKind::VAR_DECL) {
+            for (uint32_t x = ast[c].first; x != Ast::NIL; x = ast[x].next) {
+                if (ast.atom(ast[x]) == Ast::NIL) continue;
+                Lexeme name = ast.text(ast[x]);
+                Json range = lspRange(doc, nodePos(doc, x), name.len);
+                Json sym = Json::object();
+                sym.set("name", name.str());
+                sym.set("kind", kind == NodeKind::CONST_DECL ? SYMBOL_CONSTANT : SYMBOL_VARIABLE);
+                uint32_t eq = ast[x].next, num = eq != Ast::NIL ? ast[eq].next : Ast::NIL;
+                if (kind == NodeKind::CONST_DECL && num != Ast::NIL && ast[num].kind == NodeKind::NUMBER)
+                    sym.set("detail", "= " + ast.text(ast[num]).str());
+                sym.set("range", range);
+                sym.set("selectionRange", std::move(range));
+                out.push(std::move(sym));
+            }
+        } else if (kind == NodeKind::PROC_DECL) {
+            uint32_t x = ast.child(c, 1);
+            if (x == Ast::NIL || ast.atom(ast[x]) == Ast::NIL) continue;
+            Lexeme name = ast.text(ast[x]);
+            Pos from = nodePos(doc, c), at = nodePos(doc, x), to{ at.line, at.col + static_cast<uint32_t>(name.len) };
+            uint32_t after = ast[c].next;
+            if (after != Ast::NIL && ast[after].line != 0) to = nodePos(doc, after);
+            Json range = Json::object();
+            range.set("start", lspPosition(doc, from));
+            range.set("end", lspPosition(doc, to));
+            Json sym = Json::object();
+            sym.set("name", name.str());
+            sym.set("kind", SYMBOL_FUNCTION);
+            sym.set("range", std::move(range));
+            sym.set("selectionRange", lspRange(doc, at, name.len));
+            Json children = Json::array();
+            uint32_t body = ast.child(c, 3);
+            if (body != Ast::NIL && ast[body].kind == NodeKind::BLOCK) blockSymbols(doc, body, children);
+            sym.set("children", std::move(children));
+            out.push(std::move(sym));
+        } else {
+            break;
+        }
+    }
+}
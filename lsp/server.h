@@ -0,0 +1,91 @@
+#ifndef PL0_LSP_SERVER_H
+#define PL0_LSP_SERVER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../parser/incremental.h"
+#include "json.h"
+
+/**
+ * @brief PL/0 语言服务器
+ * 经一对流按 LSP 收发消息：每条消息为 "Content-Length: N\r\n\r\n" 加 N 字节的 JSON-RPC 2.0 正文。
+ * 打开的文档各由一个 Document 持有，进程不退出，语法树与诊断一直留在内存中；
+ * 编辑按范围传来（textDocumentSync 为增量），交给 Document::edit() 只重新分析改动所在的语句或过程。
+ *
+ *   textDocument/didOpen, didChange, didClose   维护文档，每次改动后发布诊断
+ *   textDocument/documentSymbol                 常量、变量与过程，过程内的声明为其子结点
+ *   textDocument/definition                     标识符所指的声明
+ *   textDocument/hover                          标识符所指的声明及其所在的过程
+ *
+ * 名字按作用域解析：从光标所在的块由内向外，找位置在光标之前的同名声明，与分析时的符号表一致。
+ * 行号从 0 起，列按 UTF-16 码元计（LSP 的约定），与语法树中按字节计的列在这里换算。
+ */
+class Server {
+public:
+    Server(std::istream& in, std::ostream& out);
+
+    /* 处理消息直到收到 exit 或输入结束；返回进程的退出码（先收到 shutdown 时为 0） */
+    int run();
+
+    /* 每条消息的方法名与处理耗时写到 log，为 nullptr 时不写 */
+    void setLog(std::ostream* log) { this->log = log; }
+
+private:
+    /* 行列都从 1 起、列按字节计的位置，与语法树一致 */
+    struct Pos {
+        uint32_t line, col;
+        bool operator<(const Pos& o) const { return line != o.line ? line < o.line : col < o.col; }
+    };
+    /* 光标所在的作用域：块及其所属的过程声明（主程序为 NIL） */
+    struct Scope {
+        uint32_t block, proc;
+    };
+    struct Open {
+        std::unique_ptr<Document> doc;
+        Json version;
+    };
+
+    std::istream& in;
+    std::ostream& out;
+    std::ostream* log = nullptr;
+    std::unordered_map<std::string, Open> docs;
+    bool initialized = false;
+    bool shuttingDown = false;
+    bool exiting = false;
+    std::string buffer;
+
+    bool readMessage(std::string& body);
+    void send(const Json& msg);
+    void reply(const Json& id, Json result);
+    void replyError(const Json& id, int code, const std::string& message);
+    void handle(const Json& msg);
+
+    void didOpen(const Json& params);
+    void didChange(const Json& params);
+    void didClose(const Json& params);
+    void publish(const std::string& uri, Open& open);
+    Document* find(const Json& params);
+
+    Json documentSymbols(Document& doc);
+    Json definition(const Json& params);
+    Json hover(const Json& params);
+
+    // 位置换算
+    Json lspPosition(Document& doc, Pos p);
+    Json lspRange(Document& doc, Pos p, size_t bytes);
+    bool toOffset(Document& doc, const Json& position, size_t& offset);
+    bool toPos(Document& doc, const Json& position, Pos& p);
+
+    // 在语法树上找名字
+    Pos nodePos(Document& doc, uint32_t id);
+    uint32_t identAt(Document& doc, Pos p, std::vector<Scope>& scopes);
+    uint32_t resolve(Document& doc, const std::vector<Scope>& scopes, uint32_t ident, uint32_t& decl, uint32_t& owner);
+    void blockSymbols(Document& doc, uint32_t block, Json& out);
+};
+
+#endif
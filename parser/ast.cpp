@@ -0,0 +1,632 @@
+#include "ast.h"
+
+#include "../lexier/profile.h"
+#include "../lexier/stack.h"
+
+/* ------------ 结点存储 ------------ */
+
+/**
+ * @brief
+ * 分配结点、填好公共字段并挂到父结点的子结点末尾
+ */
+Node& Ast::alloc(uint32_t parent, uint32_t prev, NodeKind kind, const Token& at, uint32_t& id)
+{
+    id = count;
+    if ((id >> BLOCK_BITS) == blocks.size())
+        blocks.emplace_back(new Node[BLOCK_MASK + 1]);
+    ++count;
+
+    Node& n = this->at(id);
+    n.kind = kind;
+    n.tok = at.kind;
+    n.line = at.line;
+    n.col = at.col;
+    n.text = static_cast<uint32_t>(pool.size());
+    n.len = 0;
+    n.first = n.next = NIL;
+
+    if (prev != NIL) this->at(prev).next = id;
+    else if (parent != NIL) this->at(parent).first = id;
+    return n;
+}
+
+/**
+ * @brief
+ * 追加结点并挂到父结点的子结点末尾
+ */
+uint32_t Ast::add(uint32_t parent, uint32_t prev, NodeKind kind, const Token& at, Lexeme text)
+{
+    uint32_t id;
+    Node& n = alloc(parent, prev, kind, at, id);
+    if (isLeaf(kind) && text.len) {
+        pool.append(text.ptr, text.len);
+        n.len = static_cast<uint32_t>(text.len);
+    }
+    return id;
+}
+
+/**
+ * @brief
+ * 追加标识符叶子，只记原子编号
+ */
+uint32_t Ast::addIdent(uint32_t parent, uint32_t prev, const Token& at, uint32_t atom)
+{
+    uint32_t id;
+    Node& n = alloc(parent, prev, NodeKind::IDENT, at, id);
+    n.text = atom;
+    n.len = static_cast<uint32_t>(atoms->name(atom).len);
+    return id;
+}
+
+/**
+ * @brief
+ * 追加常数叶子：词素池中先放 8 字节的值，再放词素，text 指向词素
+ */
+uint32_t Ast::addNumber(uint32_t parent, uint32_t prev, const Token& at, Lexeme text, int64_t value)
+{
+    uint32_t id;
+    Node& n = alloc(parent, prev, NodeKind::NUMBER, at, id);
+    pool.append(reinterpret_cast<const char*>(&value), sizeof value);
+    pool.append(text.ptr, text.len);
+    n.text += sizeof value;
+    n.len = static_cast<uint32_t>(text.len);
+    return id;
+}
+
+/**
+ * @brief
+ * 把一串子结点换成另一串，新串的末尾接上 oldLast 的后继兄弟
+ */
+void Ast::splice(uint32_t parent, uint32_t prev, uint32_t oldLast, uint32_t first, uint32_t last)
+{
+    at(last).next = at(oldLast).next;
+    if (prev != NIL) at(prev).next = first;
+    else at(parent).first = first;
+}
+
+/**
+ * @brief
+ * 删去下标不小于 n 的结点；词素池退回到其中第一个占用词素池的结点建好之前
+ * （标识符叶子的 text 为原子编号，不占词素池；常数叶子的 text 在它的值之后；其余结点的 text 为建好时词素池的大小）
+ */
+void Ast::truncate(uint32_t n)
+{
+    for (uint32_t k = n; k < count; ++k) {
+        const Node& x = at(k);
+        if (!isAtom(x)) {
+            pool.resize(x.kind == NodeKind::NUMBER ? x.text - sizeof(int64_t) : x.text);
+            break;
+        }
+    }
+    if (n < count) count = n;
+}
+
+/**
+ * @brief
+ * 结点的第 k 个子结点
+ */
+uint32_t Ast::child(uint32_t id, unsigned k) const
+{
+    uint32_t c = (*this)[id].first;
+    while (c != NIL && k--) c = (*this)[c].next;
+    return c;
+}
+
+/* ------------ 遍历 ------------ */
+
+/**
+ * @brief
+ * 先序遍历以 from 为根的子树；栈不够时换到新的栈段上，深度不受线程栈的限制
+ */
+void walk(const Ast& ast, AstVisitor& v, uint32_t from, int depth)
+{
+    if (Stack::low()) return Stack::run([&] { walk(ast, v, from, depth); });
+    if (!v.enter(ast, from, depth)) return;
+    for (uint32_t c = ast[from].first; c != Ast::NIL; c = ast[c].next)
+        walk(ast, v, c, depth + 1);
+    v.leave(ast, from, depth);
+}
+
+/* ------------ 标签 ------------ */
+
+/* 非终结符的标签，与 NodeKind 顺序一致 */
+static const char* const kindLabels[] = {
+    "Program", "Block", "Const Declaration", "Var Declaration", "Procedure Declaration",
+    "Statement", "Assignment", "Procedure Call", "Begin-End Block", "If Statement",
+    "While Loop", "Read Statement", "Write Statement",
+    "Condition", "Expression", "Term", "Factor"
+};
+
+/* SYMBOL 叶子的标签：关键字为大写名字，界符带上符号本身 */
+static const char* symbolLabel(Tok t)
+{
+    switch (t) {
+        case Tok::BEGINSYM: return "BEGIN";
+        case Tok::ENDSYM: return "END";
+        case Tok::CONSTSYM: return "CONST";
+        case Tok::VARSYM: return "VAR";
+        case Tok::PROCEDURESYM: return "PROCEDURE";
+        case Tok::CALLSYM: return "CALL";
+        case Tok::IFSYM: return "IF";
+        case Tok::ELSESYM: return "ELSE";
+        case Tok::THENSYM: return "THEN";
+        case Tok::WHILESYM: return "WHILE";
+        case Tok::DOSYM: return "DO";
+        case Tok::ODDSYM: return "ODD";
+        case Tok::READSYM: return "READ";
+        case Tok::WRITESYM: return "WRITE";
+        case Tok::EQL: return "EQL '='";
+        case Tok::BECOMES: return "BECOMES ':='";
+        case Tok::LPAREN: return "LPAREN '('";
+        case Tok::RPAREN: return "RPAREN ')'";
+        case Tok::COMMA: return "COMMA ','";
+        case Tok::SEMICOLON: return "SEMICOLON ';'";
+        case Tok::PERIOD: return "PERIOD '.'";
+        default: return tokName(t);
+    }
+}
+
+/**
+ * @brief
+ * 把结点的标签追加到 out
+ */
+void appendLabel(std::string& out, const Ast& ast, const Node& n)
+{
+    Lexeme t = ast.text(n);
+    switch (n.kind) {
+        case NodeKind::IDENT:      out += "IDENT: "; break;
+        case NodeKind::NUMBER:     out += "NUMBER: "; break;
+        case NodeKind::UNARY_OP:   out += "UnaryOp:"; break;
+        case NodeKind::BINARY_OP:  out += "BinaryOp: "; break;
+        case NodeKind::COMPARE_OP: out += "CompareOp: "; break;
+        case NodeKind::SYMBOL:     out += symbolLabel(n.tok); return;
+        case NodeKind::PAREN:      out += n.tok == Tok::LPAREN ? '(' : ')'; return;
+        default:                   out += kindLabels[static_cast<int>(n.kind)]; return;
+    }
+    out.append(t.ptr, t.len);
+}
+
+/* 结点种类名，与 NodeKind 顺序一致 */
+static const char* const kindNames[] = {
+    "PROGRAM", "BLOCK", "CONST_DECL", "VAR_DECL", "PROC_DECL",
+    "STATEMENT", "ASSIGN", "CALL", "COMPOUND", "IF", "WHILE", "READ", "WRITE",
+    "CONDITION", "EXPRESSION", "TERM", "FACTOR",
+    "IDENT", "NUMBER", "SYMBOL", "PAREN", "UNARY_OP", "BINARY_OP", "COMPARE_OP"
+};
+
+const char* nodeKindName(NodeKind k)
+{
+    return kindNames[static_cast<int>(k)];
+}
+
+/* ------------ 输出 ------------ */
+
+namespace {
+
+void appendEscaped(std::string& buf, const char* s, size_t n);
+
+/* 带缓冲的输出：子类在 buf 上拼接，攒满一块再写入 out */
+class OutputBuffer {
+public:
+    OutputBuffer(std::ostream& out, const TreeLimits& lim) : out(out), lim(lim) { buf.reserve(BUF_SIZE + 256); }
+    ~OutputBuffer() { flush(); }
+
+protected:
+    static const size_t BUF_SIZE = 64 * 1024;
+    std::ostream& out;
+    TreeLimits lim;
+    std::string buf;
+
+    /* 是否在该深度截断子结点 */
+    bool cut(const Node& n, int depth) const
+    {
+        return lim.maxDepth >= 0 && depth >= lim.maxDepth && n.first != Ast::NIL;
+    }
+
+    void spill()
+    {
+        if (buf.size() >= BUF_SIZE) flush();
+    }
+
+    void flush()
+    {
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+
+    void number(uint32_t v)
+    {
+        char tmp[12];
+        int k = 0;
+        do { tmp[k++] = static_cast<char>('0' + v % 10); v /= 10; } while (v);
+        while (k) buf += tmp[--k];
+    }
+
+    /* DOT 的结点行，depth 大于 0 时另加一行来自 parent 的边 */
+    void dotNode(uint32_t id, const std::string& label, int depth, uint32_t parent)
+    {
+        buf += "  n";
+        number(id);
+        buf += " [label=\"";
+        appendEscaped(buf, label.data(), label.size());
+        buf += "\"];\n";
+        if (depth > 0) {
+            buf += "  n";
+            number(parent);
+            buf += " -> n";
+            number(id);
+            buf += ";\n";
+        }
+    }
+
+    /* JSON 结点对象的开头，到 children 之前为止 */
+    void jsonHead(const Ast& ast, const Node& n, uint32_t id, std::string& label)
+    {
+        buf += "{\"id\":";
+        number(id);
+        buf += ",\"kind\":\"";
+        buf += nodeKindName(n.kind);
+        buf += "\",\"label\":\"";
+        label.clear();
+        appendLabel(label, ast, n);
+        appendEscaped(buf, label.data(), label.size());
+        buf += "\",\"line\":";
+        number(n.line);
+        buf += ",\"col\":";
+        number(n.col);
+        if (n.len) {
+            Lexeme t = ast.text(n);
+            buf += ",\"text\":\"";
+            appendEscaped(buf, t.ptr, t.len);
+            buf += '"';
+        }
+    }
+};
+
+/* 遍历建好的树输出 */
+class TreeWriter : public AstVisitor, protected OutputBuffer {
+public:
+    using OutputBuffer::OutputBuffer;
+
+    /* 从 lim.root（或整棵树的根）开始遍历 */
+    void run(const Ast& ast)
+    {
+        uint32_t from = lim.root != Ast::NIL ? lim.root : ast.root();
+        if (from != Ast::NIL && from < ast.size()) walk(ast, *this, from);
+    }
+};
+
+/* 缩进文本 */
+class TreePrinter : public TreeWriter {
+public:
+    using TreeWriter::TreeWriter;
+
+    bool enter(const Ast& ast, uint32_t id, int depth) override
+    {
+        const Node& n = ast[id];
+        if (n.kind == NodeKind::PROC_DECL) {    // 原格式不输出过程头，分程序与外层的语句同级
+            uint32_t body = ast.child(id, 3);
+            if (body != Ast::NIL) walk(ast, *this, body, depth);
+            return false;
+        }
+        buf.append(static_cast<size_t>(depth) * 2, ' ');
+        appendLabel(buf, ast, n);
+        buf += '\n';
+        spill();
+        return lim.maxDepth < 0 || depth < lim.maxDepth;
+    }
+};
+
+/* 在 buf 末尾追加转义后的字符串：DOT 与 JSON 都只需处理引号、反斜杠和控制字符 */
+void appendEscaped(std::string& buf, const char* s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (size_t k = 0; k < n; ++k) {
+        unsigned char c = static_cast<unsigned char>(s[k]);
+        if (c == '"' || c == '\\') {
+            buf += '\\';
+            buf += static_cast<char>(c);
+        } else if (c < 0x20) {
+            buf += "\\u00";
+            buf += hex[c >> 4];
+            buf += hex[c & 15];
+        } else {
+            buf += static_cast<char>(c);
+        }
+    }
+}
+
+/* DOT：每个结点一行，其后一行是来自父结点的边，与原先脚本的输出顺序相同 */
+class DotWriter : public TreeWriter {
+public:
+    using TreeWriter::TreeWriter;
+
+    void run(const Ast& ast)
+    {
+        buf += "digraph ParseTree {\n";
+        buf += "  node [shape=box, style=filled, fillcolor=lightgray];\n";
+        TreeWriter::run(ast);
+        buf += "}\n";
+    }
+
+    bool enter(const Ast& ast, uint32_t id, int depth) override
+    {
+        const Node& n = ast[id];
+        if (n.kind == NodeKind::PROC_DECL) {    // 与缩进文本同形：过程的分程序直接挂在外层分程序下
+            uint32_t body = ast.child(id, 3);
+            if (body != Ast::NIL) walk(ast, *this, body, depth);
+            return false;
+        }
+        bool stop = cut(n, depth);
+        label.clear();
+        appendLabel(label, ast, n);
+        if (stop) label += " ...";
+        dotNode(id, label, depth, depth > 0 ? parents[depth - 1] : 0);
+        if (parents.size() <= static_cast<size_t>(depth)) parents.resize(depth + 1);
+        parents[depth] = id;
+        spill();
+        return !stop;
+    }
+
+private:
+    std::vector<uint32_t> parents;      // 各深度上最近输出的结点，即下一层结点的父结点
+    std::string label;
+};
+
+/* JSON：结点嵌套输出，进入时写对象头与 children 的开头，离开时收尾 */
+class JsonWriter : public TreeWriter {
+public:
+    using TreeWriter::TreeWriter;
+
+    void run(const Ast& ast)
+    {
+        TreeWriter::run(ast);
+        buf += '\n';
+    }
+
+    bool enter(const Ast& ast, uint32_t id, int depth) override
+    {
+        const Node& n = ast[id];
+        if (depth > 0) {
+            if (hasChild[depth - 1]) buf += ',';
+            hasChild[depth - 1] = true;
+        }
+        jsonHead(ast, n, id, label);
+        spill();
+        if (cut(n, depth)) {
+            buf += ",\"truncated\":true}";
+            return false;
+        }
+        if (n.first == Ast::NIL) {
+            buf += '}';
+            return false;
+        }
+        buf += ",\"children\":[";
+        if (hasChild.size() <= static_cast<size_t>(depth)) hasChild.resize(depth + 1);
+        hasChild[depth] = false;
+        return true;
+    }
+
+    void leave(const Ast&, uint32_t, int) override
+    {
+        buf += "]}";
+    }
+
+private:
+    std::vector<bool> hasChild;     // 各深度上是否已写过子结点，决定是否先写逗号
+    std::string label;
+};
+
+/* ------------ 流式输出 ------------ */
+
+/*
+ * 缩进文本与 DOT 的流式输出共用：按 TreePrinter / DotWriter 的规则算出结点输出时的深度，
+ * 过程声明本身不输出，由其第 4 个子结点（分程序）顶替在它的位置上，其余子结点不输出
+ */
+class ShapedStream : public TreeStream, protected OutputBuffer {
+public:
+    using OutputBuffer::OutputBuffer;
+
+protected:
+    struct Frame {
+        int out;            // 输出的深度
+        unsigned kids;      // 已交来的子结点数
+        bool proc;          // 过程声明
+        bool hidden;        // 不输出：过程头部，或超出深度限制
+    };
+    std::vector<Frame> frames;      // 当前路径上的结点，下标为其在树中的深度
+
+    /* 登记刚建好的结点；返回的 Frame 中 proc 与 hidden 都为 false 时应输出 */
+    const Frame& push(const Node& n, int depth)
+    {
+        Frame f = { 0, 0, n.kind == NodeKind::PROC_DECL, false };
+        if (depth > 0) {
+            Frame& p = frames[depth - 1];
+            f.hidden = p.hidden;
+            if (p.proc) {
+                f.out = p.out;
+                if (p.kids != 3) f.hidden = true;
+            } else {
+                f.out = p.out + 1;
+            }
+            ++p.kids;
+        }
+        if (lim.maxDepth >= 0 && f.out > lim.maxDepth) f.hidden = true;
+        frames.resize(depth);
+        frames.push_back(f);
+        return frames.back();
+    }
+};
+
+class TextStream : public ShapedStream {
+public:
+    using ShapedStream::ShapedStream;
+
+    void node(const Ast& ast, uint32_t id, uint32_t, int depth) override
+    {
+        const Node& n = ast[id];
+        const Frame& f = push(n, depth);
+        if (f.proc || f.hidden) return;
+        buf.append(static_cast<size_t>(f.out) * 2, ' ');
+        appendLabel(buf, ast, n);
+        buf += '\n';
+        spill();
+    }
+
+    void end(int) override {}
+    void finish() override { flush(); }
+};
+
+/* 深度限制处的结点要等知道有没有子结点（标签是否加 " ..."）才输出，最多压着一个 */
+class DotStream : public ShapedStream {
+public:
+    DotStream(std::ostream& out, const TreeLimits& lim) : ShapedStream(out, lim)
+    {
+        buf += "digraph ParseTree {\n";
+        buf += "  node [shape=box, style=filled, fillcolor=lightgray];\n";
+    }
+
+    void node(const Ast& ast, uint32_t id, uint32_t seq, int depth) override
+    {
+        if (held && depth == heldDepth + 1) emit(true);
+        const Node& n = ast[id];
+        const Frame& f = push(n, depth);
+        if (f.proc || f.hidden) return;
+        label.clear();
+        appendLabel(label, ast, n);
+        heldSeq = seq;
+        heldOut = f.out;
+        heldDepth = depth;
+        heldParent = f.out > 0 ? parents[f.out - 1] : 0;
+        if (parents.size() <= static_cast<size_t>(f.out)) parents.resize(f.out + 1);
+        parents[f.out] = seq;
+        held = true;
+        if (lim.maxDepth < 0 || f.out < lim.maxDepth) emit(false);
+    }
+
+    void end(int depth) override
+    {
+        if (held && depth == heldDepth) emit(false);
+    }
+
+    void finish() override
+    {
+        buf += "}\n";
+        flush();
+    }
+
+private:
+    std::vector<uint32_t> parents;      // 各输出深度上最近输出的结点
+    std::string label;
+    bool held = false;
+    uint32_t heldSeq = 0, heldParent = 0;
+    int heldOut = 0, heldDepth = 0;
+
+    void emit(bool truncated)
+    {
+        if (truncated) label += " ...";
+        dotNode(heldSeq, label, heldOut, heldParent);
+        spill();
+        held = false;
+    }
+};
+
+/* 子结点数组在第一个子结点到来时才打开，结点结束时按有无子结点、是否截断收尾 */
+class JsonStream : public TreeStream, protected OutputBuffer {
+public:
+    using OutputBuffer::OutputBuffer;
+
+    void node(const Ast& ast, uint32_t id, uint32_t seq, int depth) override
+    {
+        Frame f = { true, false, lim.maxDepth >= 0 && depth >= lim.maxDepth };
+        if (depth > 0) {
+            Frame& p = frames[depth - 1];
+            if (!p.shown || p.cut) f.shown = false;
+            else buf += p.kids ? "," : ",\"children\":[";
+            p.kids = true;
+        }
+        frames.resize(depth);
+        frames.push_back(f);
+        if (!f.shown) return;
+        jsonHead(ast, ast[id], seq, label);
+        spill();
+    }
+
+    void end(int depth) override
+    {
+        const Frame& f = frames[depth];
+        if (f.shown) buf += !f.kids ? "}" : f.cut ? ",\"truncated\":true}" : "]}";
+    }
+
+    void finish() override
+    {
+        buf += '\n';
+        flush();
+    }
+
+private:
+    struct Frame {
+        bool shown, kids, cut;
+    };
+    std::vector<Frame> frames;
+    std::string label;
+};
+
+}
+
+/**
+ * @brief
+ * 以缩进文本打印语法树
+ */
+void printTree(const Ast& ast, std::ostream& out, const TreeLimits& lim)
+{
+    TreePrinter p(out, lim);
+    p.run(ast);
+}
+
+/**
+ * @brief
+ * 以 DOT 格式输出语法树
+ */
+void writeDot(const Ast& ast, std::ostream& out, const TreeLimits& lim)
+{
+    DotWriter w(out, lim);
+    w.run(ast);
+}
+
+/**
+ * @brief
+ * 以 JSON 输出语法树
+ */
+void writeJson(const Ast& ast, std::ostream& out, const TreeLimits& lim)
+{
+    JsonWriter w(out, lim);
+    w.run(ast);
+}
+
+/**
+ * @brief
+ * 按格式输出语法树
+ */
+void writeTree(const Ast& ast, std::ostream& out, TreeFormat fmt, const TreeLimits& lim)
+{
+    PL0_ZONE(Zone::OUTPUT);
+    switch (fmt) {
+        case TreeFormat::TEXT: printTree(ast, out, lim); break;
+        case TreeFormat::DOT:  writeDot(ast, out, lim); break;
+        case TreeFormat::JSON: writeJson(ast, out, lim); break;
+    }
+}
+
+/**
+ * @brief
+ * 按格式建立流式输出
+ */
+std::unique_ptr<TreeStream> streamTree(std::ostream& out, TreeFormat fmt, const TreeLimits& lim)
+{
+    switch (fmt) {
+        case TreeFormat::DOT:  return std::unique_ptr<TreeStream>(new DotStream(out, lim));
+        case TreeFormat::JSON: return std::unique_ptr<TreeStream>(new JsonStream(out, lim));
+        default:               return std::unique_ptr<TreeStream>(new TextStream(out, lim));
+    }
+}
@@ -0,0 +1,264 @@
+#ifndef PL0_AST_H
+#define PL0_AST_H
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../lexier/intern.h"
+#include "../lexier/token.h"
+
+/**
+ * @brief 语法树结点种类
+ * 前一段是非终结符，对应 Parser 的各个文法函数；后一段是叶子，对应一个记号。
+ */
+enum class NodeKind : unsigned char {
+    PROGRAM, BLOCK, CONST_DECL, VAR_DECL, PROC_DECL,
+    STATEMENT, ASSIGN, CALL, COMPOUND, IF, WHILE, READ, WRITE,
+    CONDITION, EXPRESSION, TERM, FACTOR,
+    /* 叶子 */
+    IDENT, NUMBER,          // 词素即名字 / 常数
+    SYMBOL,                 // 关键字或界符，只看 tok
+    PAREN,                  // 因子中的括号
+    UNARY_OP, BINARY_OP, COMPARE_OP
+};
+
+/**
+ * @brief 语法树结点，24 字节
+ * 子结点以下标相连：first 为首个子结点，next 为下一个兄弟，Ast::NIL 表示没有。
+ * 叶子的词素拷贝在 Ast 的词素池中，(text, len) 为其区间，不依赖记号来源的缓冲区；
+ * 标识符叶子（kind 与 tok 都为 IDENT）不拷贝词素，text 存其原子编号，名字在原子表中；
+ * 常数叶子的值（8 字节）存在词素池中紧挨词素之前。
+ */
+struct Node {
+    NodeKind kind;
+    Tok tok;            // 叶子的记号种类，非终结符为其首记号的种类
+    uint16_t col;
+    uint32_t line;      // 结点首记号的位置，0 表示未知
+    uint32_t text;
+    uint32_t len;
+    uint32_t first;
+    uint32_t next;
+};
+
+/**
+ * @brief 语法树
+ * 结点按创建顺序（即先序）从竞技场中顺序分配：竞技场由若干固定大小的块组成，
+ * 块内结点连续存放，一块用完再取下一块，已有结点从不搬动，也不单独 new；
+ * 整棵树随 Ast 一起释放，clear() 后保留已分配的块供下一棵树复用。
+ * 结点以下标 id 访问，根结点（PROGRAM）的下标为 0。
+ */
+class Ast {
+public:
+    static const uint32_t NIL = 0xFFFFFFFFu;
+
+    Ast() {}
+
+    uint32_t root() const { return count ? 0 : NIL; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Node& operator[](uint32_t id) const { return blocks[id >> BLOCK_BITS][id & BLOCK_MASK]; }
+
+    /* 叶子的词素；非终结符为空 */
+    Lexeme text(const Node& n) const
+    {
+        return isAtom(n) ? atoms->name(n.text) : Lexeme{ pool.data() + n.text, n.len };
+    }
+    /* 标识符叶子的原子编号，其他结点返回 NIL */
+    uint32_t atom(const Node& n) const { return isAtom(n) ? n.text : NIL; }
+    /* 常数叶子的值，即词法分析时算好的 TokenSource::number()，不再解析词素 */
+    int64_t number(const Node& n) const
+    {
+        int64_t v;
+        std::memcpy(&v, pool.data() + n.text - sizeof v, sizeof v);
+        return v;
+    }
+
+    /* 标识符叶子的名字所在的原子表，由 Parser 在建树前设置 */
+    void setInterner(const Interner* table) { atoms = table; }
+
+    /* 结点的第 k 个子结点，不存在时返回 NIL */
+    uint32_t child(uint32_t id, unsigned k) const;
+
+    /**
+     * @brief 追加结点并挂到父结点的子结点末尾
+     * prev 为父结点当前的末个子结点，没有子结点时为 NIL，此时需给出 parent；
+     * 两者都为 NIL 时新结点作为根。text 只在叶子上保存。
+     * @return 新结点的下标
+     */
+    uint32_t add(uint32_t parent, uint32_t prev, NodeKind kind, const Token& at,
+                 Lexeme text = Lexeme{ "", 0 });
+    /* 追加标识符叶子，只记原子编号 */
+    uint32_t addIdent(uint32_t parent, uint32_t prev, const Token& at, uint32_t atom);
+    /* 追加常数叶子，连同其值 */
+    uint32_t addNumber(uint32_t parent, uint32_t prev, const Token& at, Lexeme text, int64_t value);
+
+    /*
+     * 增量分析用：把 parent 的子结点 old .. oldLast（相连的一串兄弟）换成另建好的一串兄弟 first .. last，
+     * prev 为 old 的前一个兄弟，没有时为 NIL。换下的子树不再可达，结点留在竞技场中直到 clear()，
+     * 此后按先序分配的性质不再成立。
+     */
+    void splice(uint32_t parent, uint32_t prev, uint32_t oldLast, uint32_t first, uint32_t last);
+    /* 增量分析用：改写结点的位置 */
+    void setPos(uint32_t id, uint32_t line, uint16_t col) { at(id).line = line; at(id).col = col; }
+
+    void clear() { count = 0; pool.clear(); }
+    /* 删去下标不小于 n 的结点及其词素，流式分析用：删去的须是最后建的一段结点，不再有别的结点指向它们 */
+    void truncate(uint32_t n);
+
+private:
+    Ast(const Ast&);                // 不可拷贝
+    Ast& operator=(const Ast&);
+
+    static const unsigned BLOCK_BITS = 14;      // 每块 16K 个结点，384 KiB
+    static const uint32_t BLOCK_MASK = (1u << BLOCK_BITS) - 1;
+
+    Node& at(uint32_t id) { return blocks[id >> BLOCK_BITS][id & BLOCK_MASK]; }
+    Node& alloc(uint32_t parent, uint32_t prev, NodeKind kind, const Token& at, uint32_t& id);
+    static bool isAtom(const Node& n) { return n.kind == NodeKind::IDENT && n.tok == Tok::IDENT; }
+
+    std::vector<std::unique_ptr<Node[]>> blocks;
+    uint32_t count = 0;
+    std::string pool;       // 叶子词素首尾相接存放
+    const Interner* atoms = nullptr;
+};
+
+/* 是否为叶子结点 */
+inline bool isLeaf(NodeKind k) { return k >= NodeKind::IDENT; }
+
+/**
+ * @brief 语法树访问者
+ * walk() 先序遍历子树，enter 返回 false 时跳过该结点的子结点（也不调用 leave）。
+ * depth 为相对遍历起点的深度，起点为调用 walk() 时给出的值。
+ */
+class AstVisitor {
+public:
+    virtual ~AstVisitor() {}
+    virtual bool enter(const Ast& ast, uint32_t id, int depth) = 0;
+    virtual void leave(const Ast&, uint32_t, int) {}
+};
+
+void walk(const Ast& ast, AstVisitor& v, uint32_t from, int depth = 0);
+
+inline void walk(const Ast& ast, AstVisitor& v)
+{
+    if (!ast.empty()) walk(ast, v, ast.root());
+}
+
+/* 把结点的标签（如 "IDENT: x"、"SEMICOLON ';'"）追加到 out */
+void appendLabel(std::string& out, const Ast& ast, const Node& n);
+
+/* 结点种类名，如 "PROGRAM"、"IDENT" */
+const char* nodeKindName(NodeKind k);
+
+/**
+ * @brief 树输出的范围
+ * root 为 NIL 时输出整棵树，否则只输出以 root 为根的子树；
+ * maxDepth 小于 0 时不限深度，否则只输出相对 root 深度不超过 maxDepth 的结点，
+ * 被截掉子结点的结点在 DOT 中标签后加 " ..."，在 JSON 中带 "truncated": true。
+ */
+struct TreeLimits {
+    uint32_t root = Ast::NIL;
+    int maxDepth = -1;
+};
+
+/*
+ * 以下三种输出都是 walk() 上的访问者，一趟写完，不生成中间文本；
+ * 输出先攒在 64 KiB 缓冲区里，按块写入 out。
+ */
+
+/**
+ * @brief 以缩进文本打印语法树
+ * 每层缩进两个空格，每个结点一行，格式与原先边分析边打印的输出一致；
+ * 过程声明沿用原格式，只输出其分程序。
+ */
+void printTree(const Ast& ast, std::ostream& out, const TreeLimits& lim = TreeLimits());
+
+/**
+ * @brief 以 Graphviz DOT 格式输出语法树
+ * 树的形状与 printTree 相同，与原先用脚本转换缩进文本得到的图一致；
+ * 结点名为 n<结点下标>，可据此用 TreeLimits::root 选取子树。
+ */
+void writeDot(const Ast& ast, std::ostream& out, const TreeLimits& lim = TreeLimits());
+
+/**
+ * @brief 以 JSON 输出语法树
+ * 每个结点为 {"id","kind","label","line","col"[,"text"][,"children"][,"truncated"]}，
+ * 子结点嵌套在 children 数组中。JSON 给出完整的树，过程声明带有过程名等全部子结点。
+ */
+void writeJson(const Ast& ast, std::ostream& out, const TreeLimits& lim = TreeLimits());
+
+/* 树的输出格式 */
+enum class TreeFormat : unsigned char { TEXT, DOT, JSON };
+
+/* 按格式输出语法树 */
+void writeTree(const Ast& ast, std::ostream& out, TreeFormat fmt, const TreeLimits& lim = TreeLimits());
+
+/**
+ * @brief 流式建树的接收端
+ * 结点按先序逐个交来：node() 在结点刚建好时调用，此时只有它和它的祖先可读，子结点还没有建；
+ * end() 在结点的子结点全部交完后调用（叶子紧接在 node() 之后）。交完之后结点可能即被回收，
+ * 接收端须在 node() 中取走所需的内容。seq 为结点的先序编号，与整篇建树时的下标相同。
+ */
+class TreeStream {
+public:
+    virtual ~TreeStream() {}
+    virtual void node(const Ast& ast, uint32_t id, uint32_t seq, int depth) = 0;
+    virtual void end(int depth) = 0;
+    /* 整棵树交完后调用，写出收尾部分 */
+    virtual void finish() {}
+};
+
+/*
+ * 按格式边建树边输出：与 writeTree() 对建好的整棵树的输出逐字节相同，只缓存当前路径上的结点信息；
+ * 不支持 lim.root
+ */
+std::unique_ptr<TreeStream> streamTree(std::ostream& out, TreeFormat fmt, const TreeLimits& lim = TreeLimits());
+
+/* 把 s 解析为不大于 max 的非负整数；不是纯数字或超出范围时返回 false */
+inline bool parseCount(const char* s, unsigned long max, unsigned long& v)
+{
+    if (*s < '0' || *s > '9') return false;
+    char* end;
+    errno = 0;
+    v = std::strtoul(s, &end, 10);
+    return *end == '\0' && errno == 0 && v <= max;
+}
+
+/**
+ * @brief 解析一个树输出选项，成功时消耗其参数并返回 true，parser 与 pl0c 共用
+ *   --dot / --json   输出格式（默认缩进文本）
+ *   --depth N        只输出深度不超过 N 的结点
+ *   --root ID        只输出下标为 ID 的结点为根的子树（ID 见 DOT 结点名或 JSON 的 id）
+ * 最后一个参数留给输入文件，不当作 N 或 ID；N、ID 不是非负整数时返回 false，由调用方报告用法
+ */
+inline bool parseTreeOption(int argc, char* argv[], int& i, TreeFormat& fmt, TreeLimits& lim)
+{
+    std::string a = argv[i];
+    unsigned long v;
+    if (a == "--dot") fmt = TreeFormat::DOT;
+    else if (a == "--json") fmt = TreeFormat::JSON;
+    else if (a == "--depth") {
+        if (i + 2 >= argc || !parseCount(argv[i + 1], INT_MAX, v)) return false;
+        lim.maxDepth = static_cast<int>(v);
+        ++i;
+    } else if (a == "--root") {
+        if (i + 2 >= argc || !parseCount(argv[i + 1], Ast::NIL - 1, v)) return false;
+        lim.root = static_cast<uint32_t>(v);
+        ++i;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* lim.root 是否为树中的结点；没有给出 --root 时总是 */
+inline bool hasRoot(const Ast& ast, const TreeLimits& lim) { return lim.root == Ast::NIL || lim.root < ast.size(); }
+
+#endif
@@ -0,0 +1,755 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "../lexier/lexer.h"
+#include "../lexier/stack.h"
+
+namespace {
+
+/* 子结点多于此数时缓存其下标，按位置二分查找 */
+const size_t CACHE_CHILDREN = 32;
+
+bool isSpace(char c)
+{
+    unsigned char k = charClass[static_cast<unsigned char>(c)];
+    return k == C_SPACE || k == C_NEWLINE;
+}
+
+bool allSpace(const char* p, size_t n)
+{
+    for (size_t k = 0; k < n; ++k)
+        if (!isSpace(p[k])) return false;
+    return true;
+}
+
+/* 可能与紧随其后的字符连成一个记号（标识符、数、:=、<=、>=、<> 等） */
+bool joins(char c)
+{
+    switch (charClass[static_cast<unsigned char>(c)]) {
+    case C_LETTER: case C_DIGIT: case C_COLON: case C_GTR: case C_LSS:
+    case C_PERIOD: case C_SLASH: case C_HASH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isAlnum(char c)
+{
+    unsigned char k = charClass[static_cast<unsigned char>(c)];
+    return k == C_LETTER || k == C_DIGIT;
+}
+
+/* 可以作为重新分析单位的子结点 */
+bool isUnit(NodeKind parent, NodeKind child)
+{
+    if (child == NodeKind::STATEMENT) return true;
+    return parent == NodeKind::BLOCK && child == NodeKind::PROC_DECL;
+}
+
+}
+
+/* ------------ 文本 ------------ */
+
+Document::Document(const std::string& text) : quiet(quietSink, quietSink, TraceLevel::SILENT)
+{
+    setText(text);
+}
+
+void Document::setText(const std::string& text)
+{
+    buf = text;
+    gapBegin = gapEnd = buf.size();
+    lines.assign(1, 0);
+    for (size_t k = 0; k < buf.size(); ++k)
+        if (buf[k] == '\n') lines.push_back(static_cast<uint32_t>(k + 1));
+    lineGapBegin = lineGapEnd = lines.size();
+    reparseAll();
+    stats = EditStats();
+}
+
+std::string Document::text() const
+{
+    std::string s(buf, 0, gapBegin);
+    s.append(buf, gapEnd, std::string::npos);
+    return s;
+}
+
+/**
+ * @brief
+ * 把间隙移到 pos 处，只搬动两者之间的文本
+ * @param pos
+ */
+void Document::moveGap(size_t pos)
+{
+    if (pos < gapBegin) {
+        size_t n = gapBegin - pos;
+        std::memmove(&buf[gapEnd - n], &buf[pos], n);
+        gapBegin -= n;
+        gapEnd -= n;
+    } else if (pos > gapBegin) {
+        size_t n = pos - gapBegin;
+        std::memmove(&buf[gapBegin], &buf[gapEnd], n);
+        gapBegin += n;
+        gapEnd += n;
+    }
+}
+
+void Document::replaceText(size_t offset, size_t removed, const char* ins, size_t n)
+{
+    moveGap(offset);
+    gapEnd += removed;
+    if (gapEnd - gapBegin < n) {        // 间隙不够时加倍
+        size_t tail = buf.size() - gapEnd;
+        size_t cap = std::max(buf.size() * 2, size() + n + 4096);
+        std::string grown(cap, '\0');
+        std::memcpy(&grown[0], buf.data(), gapBegin);
+        std::memcpy(&grown[cap - tail], buf.data() + gapEnd, tail);
+        buf.swap(grown);
+        gapEnd = cap - tail;
+    }
+    std::memcpy(&buf[gapBegin], ins, n);
+    gapBegin += n;
+}
+
+/* 第 k 行（从 0 起）行首的偏移 */
+uint32_t Document::lineStart(size_t k) const
+{
+    if (k < lineGapBegin) return lines[k];
+    return static_cast<uint32_t>(size() - lines[k + (lineGapEnd - lineGapBegin)]);
+}
+
+size_t Document::lineAfter(size_t offset) const
+{
+    size_t lo = 0, hi = lineCount();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (lineStart(mid) <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief
+ * 在改动文本之前更新行首表：去掉被删文本中的行首，加入插入文本中的行首。
+ * 间隙之后的项记的是到文本末尾的距离，改动前后不变
+ */
+void Document::editLines(size_t offset, size_t removed, const char* ins, size_t n)
+{
+    size_t lo = lineAfter(offset), hi = lineAfter(offset + removed);
+    size_t total = size();
+    // 间隙移到 lo 处
+    while (lineGapBegin > lo) lines[--lineGapEnd] = static_cast<uint32_t>(total - lines[--lineGapBegin]);
+    while (lineGapBegin < lo) lines[lineGapBegin++] = static_cast<uint32_t>(total - lines[lineGapEnd++]);
+    lineGapEnd += hi - lo;
+    for (size_t k = 0; k < n; ++k) {
+        if (ins[k] != '\n') continue;
+        if (lineGapBegin == lineGapEnd) {
+            size_t tail = lines.size() - lineGapEnd;
+            size_t cap = std::max<size_t>(lines.size() * 2, 64);
+            std::vector<uint32_t> grown(cap);
+            std::copy(lines.begin(), lines.begin() + lineGapBegin, grown.begin());
+            std::copy(lines.end() - tail, lines.end(), grown.end() - tail);
+            lines.swap(grown);
+            lineGapEnd = cap - tail;
+        }
+        lines[lineGapBegin++] = static_cast<uint32_t>(offset + k + 1);
+    }
+}
+
+size_t Document::offsetOf(uint32_t line, uint32_t col) const
+{
+    if (line == 0) return 0;
+    if (line > lineCount()) return size();
+    return std::min(size(), static_cast<size_t>(lineStart(line - 1)) + (col ? col - 1 : 0));
+}
+
+void Document::positionOf(size_t offset, uint32_t& line, uint32_t& col) const
+{
+    size_t k = lineAfter(offset) - 1;
+    line = static_cast<uint32_t>(k + 1);
+    col = static_cast<uint32_t>(offset - lineStart(k) + 1);
+}
+
+/* ------------ 结点位置 ------------ */
+
+/* 按平移记录换算结点 id 记下的位置 p */
+Document::Pos Document::mapped(uint32_t id, Pos p) const
+{
+    if (p.line == 0) return p;
+    for (const Shift& s : shifts) {
+        if (id >= s.watermark || p < s.from) continue;
+        if (p.line == s.from.line) {
+            p.col = p.col - s.from.col + s.to.col;
+            p.line = s.to.line;
+        } else {
+            p.line = p.line - s.from.line + s.to.line;
+        }
+    }
+    return p;
+}
+
+void Document::position(uint32_t id, uint32_t& line, uint32_t& col) const
+{
+    const Node& n = parser.tree()[id];
+    Pos p = mapped(id, Pos{ n.line, n.col });
+    line = p.line;
+    col = p.col;
+}
+
+/* 结点首记号的位置与偏移；位置未知或列号饱和时返回 false */
+bool Document::nodeStart(uint32_t id, Pos& p, size_t& offset) const
+{
+    const Node& n = parser.tree()[id];
+    if (n.line == 0 || n.col == 0xFFFF) return false;
+    p = mapped(id, Pos{ n.line, n.col });
+    offset = offsetOf(p.line, p.col);
+    return true;
+}
+
+const Ast& Document::tree()
+{
+    if (!shifts.empty()) {
+        Ast& ast = parser.tree();
+        for (uint32_t id = 0; id < ast.size(); ++id) {
+            const Node& n = ast[id];
+            if (n.line == 0 || n.col == 0xFFFF) continue;
+            Pos p = mapped(id, Pos{ n.line, n.col });
+            ast.setPos(id, p.line, static_cast<uint16_t>(std::min<uint32_t>(p.col, 0xFFFF)));
+        }
+        shifts.clear();
+    }
+    return parser.tree();
+}
+
+/* 结点的子结点下标；子结点多的缓存起来，其余的放在 scratch 中，到下一次调用为止有效 */
+const std::vector<uint32_t>& Document::children(uint32_t id)
+{
+    std::unordered_map<uint32_t, std::vector<uint32_t>>::const_iterator it = kids.find(id);
+    if (it != kids.end()) return it->second;
+    const Ast& ast = parser.tree();
+    scratch.clear();
+    for (uint32_t c = ast[id].first; c != Ast::NIL; c = ast[c].next) scratch.push_back(c);
+    if (scratch.size() <= CACHE_CHILDREN) return scratch;
+    return kids[id] = scratch;
+}
+
+/**
+ * @brief
+ * 在 node 的子结点中找包住改动 [s, e) 的单位，有多个时取靠后的一个（改动恰在两者交界处时归后一个）。
+ * 单位的区间为从它的首记号到下一个兄弟的首记号，没有下一个兄弟时到 parent 的末尾
+ * @param parent node 自身的区间
+ */
+bool Document::findChild(uint32_t node, size_t s, size_t e, const Found& parent, Found& f)
+{
+    const Ast& ast = parser.tree();
+    const std::vector<uint32_t>& ch = children(node);
+    NodeKind kind = ast[node].kind;
+    Pos p;
+    size_t off;
+    // 最后一个首记号不晚于 s 的子结点
+    size_t lo = 0, hi = ch.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (!nodeStart(ch[mid], p, off)) return false;
+        if (off <= s) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t j = lo; j-- > 0;) {
+        Found c;
+        c.id = ch[j];
+        c.slot = static_cast<uint32_t>(j);
+        c.prev = j ? ch[j - 1] : Ast::NIL;
+        if (!nodeStart(c.id, c.startPos, c.start)) return false;
+        if (j + 1 < ch.size()) {
+            c.endKind = ast[ch[j + 1]].tok;
+            c.hasEnd = true;
+            if (!nodeStart(ch[j + 1], c.endPos, c.end)) return false;
+        } else {
+            c.endKind = parent.endKind;
+            c.hasEnd = parent.hasEnd;
+            c.end = parent.end;
+            c.endPos = parent.endPos;
+        }
+        if (c.hasEnd && c.end < e) return false;       // 更靠前的子结点结束得更早
+        if (!isUnit(kind, ast[c.id].kind)) continue;
+        // 改动紧接在前一个字符之后且可能与它连成记号时，单位的首记号会变，不能从这里开始
+        if (c.start == s && s > 0 && joins(at(s - 1))) continue;
+        f = c;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief
+ * 复合语句中包住改动 [s, e) 的一串子结点：从 s 之前最近的 ';'（或 begin 后的首条语句）起，
+ * 到区间终点不早于 e 的第一条语句止。用于在语句之间插入、删除整条语句
+ * @param last 一串的末个结点
+ */
+bool Document::findRun(uint32_t node, size_t s, size_t e, Found& f, uint32_t& last)
+{
+    const Ast& ast = parser.tree();
+    const std::vector<uint32_t>& ch = children(node);
+    Pos p;
+    size_t off;
+    size_t lo = 0, hi = ch.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (!nodeStart(ch[mid], p, off)) return false;
+        if (off <= s) lo = mid + 1;
+        else hi = mid;
+    }
+    // 首个结点：';' 或第 1 个子结点（begin 之后的首条语句）
+    size_t i = lo;
+    while (i-- > 1) {
+        const Node& n = ast[ch[i]];
+        if (!(n.kind == NodeKind::SYMBOL && n.tok == Tok::SEMICOLON) && i != 1) continue;
+        if (!nodeStart(ch[i], f.startPos, f.start)) return false;
+        if (f.start == s && s > 0 && joins(at(s - 1))) continue;
+        break;
+    }
+    if (i == 0 || i + 1 >= ch.size()) return false;
+    // 末个结点：区间终点不早于 e 的第一条语句
+    lo = i + 1;
+    hi = ch.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (!nodeStart(ch[mid], p, off)) return false;
+        if (off < e) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t j = lo - 1;
+    if (ast[ch[j]].kind != NodeKind::STATEMENT) ++j;
+    if (j == i || j + 1 >= ch.size() || ast[ch[j]].kind != NodeKind::STATEMENT) return false;
+    f.id = ch[i];
+    f.slot = static_cast<uint32_t>(i);
+    f.prev = ch[i - 1];
+    f.endKind = ast[ch[j + 1]].tok;
+    f.hasEnd = true;
+    last = ch[j];
+    return nodeStart(ch[j + 1], f.endPos, f.end) && f.end >= e;
+}
+
+/* 诊断的位置 */
+static inline bool diagBefore(const Diagnostic& d, uint32_t line, uint32_t col)
+{
+    return static_cast<uint32_t>(d.line) != line ? static_cast<uint32_t>(d.line) < line : static_cast<uint32_t>(d.col) < col;
+}
+
+/**
+ * @brief
+ * 单位的边界上没有外层文法报的语法错误：首记号上的语法错误可能由外层引起（如语句之间缺少 ';'），一律不行；
+ * 单位之后那个记号上的，最后一次报错来自单位内部时外层在这个记号上没有报过错，重新分析后也不会报
+ * @param first, last 单位的首尾结点（兄弟）
+ */
+bool Document::boundaryClean(const Pos& start, const Pos& end, uint32_t first, uint32_t last) const
+{
+    const Pos ends[2] = { start, end };
+    for (int k = 0; k < 2; ++k) {
+        const Pos& p = ends[k];
+        std::vector<Diagnostic>::const_iterator it = std::lower_bound(diags.begin(), diags.end(), p,
+            [](const Diagnostic& d, const Pos& q) { return diagBefore(d, q.line, q.col); });
+        for (; it != diags.end() && diagBefore(*it, p.line, p.col + 1); ++it)
+            if (it->syntax && (k == 0 || !inUnit(it->node, first, last))) return false;
+    }
+    return true;
+}
+
+/* node 是否在 first 到 last 这几个兄弟的子树中 */
+bool Document::inUnit(uint32_t node, uint32_t first, uint32_t last) const
+{
+    const Ast& ast = parser.tree();
+    if (node == Ast::NIL || node >= ast.size()) return false;
+    std::vector<uint32_t> stack;
+    for (uint32_t c = first; c != Ast::NIL; c = c == last ? Ast::NIL : ast[c].next) stack.push_back(c);
+    while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        if (id == node) return true;
+        for (uint32_t c = ast[id].first; c != Ast::NIL; c = ast[c].next) stack.push_back(c);
+    }
+    return false;
+}
+
+/**
+ * @brief
+ * 程序末尾的 '.'：跳过文本末尾的空白与注释。找到的只是猜测，重新分析时由单位之后的记号核对
+ * @param offset '.' 的偏移
+ */
+bool Document::programEnd(size_t& offset) const
+{
+    size_t k = size();
+    while (k > 0) {
+        char c = at(k - 1);
+        if (isSpace(c)) --k;
+        else if (c == '}') {
+            while (k > 0 && at(k - 1) != '{') --k;
+            if (k == 0) return false;
+            --k;
+        } else break;
+    }
+    if (k == 0 || at(k - 1) != '.') return false;
+    offset = k - 1;
+    return true;
+}
+
+/**
+ * @brief
+ * 自根向下找包住改动 [s, e) 的单位，由外到内放入 out：
+ * 块中的语句与过程声明，复合语句、if、while 中的语句；改动在过程体内时进入其块
+ */
+void Document::locate(size_t s, size_t e, std::vector<Candidate>& out)
+{
+    const Ast& ast = parser.tree();
+    if (ast.empty()) return;
+    std::vector<uint32_t> path(1, ast.root());
+    uint32_t node = ast.child(ast.root(), 0);
+    if (node == Ast::NIL || ast[node].kind != NodeKind::BLOCK) return;
+
+    Found span;                 // node 的区间：主程序块之后的 '.' 不在树中，从文本末尾找
+    span.endKind = Tok::PERIOD;
+    span.hasEnd = programEnd(span.end);
+    span.endPos = Pos{ 0, 0 };
+    if (span.hasEnd) positionOf(span.end, span.endPos.line, span.endPos.col);
+    for (;;) {
+        path.push_back(node);
+        NodeKind kind = ast[node].kind;
+        if (kind == NodeKind::STATEMENT) {
+            uint32_t c = ast[node].first;
+            if (c == Ast::NIL) break;
+            NodeKind k = ast[c].kind;
+            if (k != NodeKind::COMPOUND && k != NodeKind::IF && k != NodeKind::WHILE) break;
+            node = c;
+            continue;
+        }
+        Found f;
+        uint32_t last;
+        if (kind == NodeKind::COMPOUND && findRun(node, s, e, f, last) && boundaryClean(f.startPos, f.endPos, f.id, last)) {
+            Candidate c;
+            c.unit.path = path;
+            c.unit.path.push_back(f.id);
+            c.unit.last = last;
+            c.unit.prev = f.prev;
+            c.parent = node;
+            c.slot = f.slot;
+            c.endKind = f.endKind;
+            c.start = f.start;
+            c.end = f.end;
+            c.startPos = f.startPos;
+            c.endPos = f.endPos;
+            out.push_back(c);
+        }
+        if (!findChild(node, s, e, span, f)) break;
+        if (f.hasEnd && boundaryClean(f.startPos, f.endPos, f.id, f.id)) {
+            Candidate c;
+            c.unit.path = path;
+            c.unit.path.push_back(f.id);
+            c.unit.prev = f.prev;
+            if (f.prev != Ast::NIL && ast[f.prev].tok == Tok::SEMICOLON) {
+                Pos q;
+                size_t off;
+                c.unit.mustStart = nodeStart(f.prev, q, off) && q == f.startPos;  // 缺少 ';' 时补的结点在语句开头
+            }
+            c.parent = node;
+            c.slot = f.slot;
+            c.endKind = f.endKind;
+            c.start = f.start;
+            c.end = f.end;
+            c.startPos = f.startPos;
+            c.endPos = f.endPos;
+            out.push_back(c);
+        }
+        if (ast[f.id].kind != NodeKind::PROC_DECL) {
+            node = f.id;
+            span = f;
+            continue;
+        }
+        // 改动落在过程体内时进入其块，否则在过程头或声明的结尾处，只能整个过程重新分析
+        uint32_t body = ast.child(f.id, 3);
+        if (body == Ast::NIL || ast[body].kind != NodeKind::BLOCK) break;
+        Found b;
+        if (!nodeStart(body, b.startPos, b.start) || b.start > s) break;
+        uint32_t after = ast[body].next;
+        if (after != Ast::NIL) {
+            b.endKind = ast[after].tok;
+            b.hasEnd = true;
+            if (!nodeStart(after, b.endPos, b.end)) break;
+        } else {
+            b.endKind = f.endKind;
+            b.hasEnd = f.hasEnd;
+            b.end = f.end;
+            b.endPos = f.endPos;
+        }
+        if (b.hasEnd && e > b.end) break;
+        path.push_back(f.id);
+        node = body;
+        span = b;
+    }
+}
+
+/**
+ * @brief
+ * 收集 node 子树中位于 [from, end) 内的结点（都在同一行上），按先序
+ * @return false 遇到位置未知的结点
+ */
+bool Document::collectLine(uint32_t node, Pos from, Pos end, std::vector<uint32_t>& out)
+{
+    if (Stack::low()) {
+        bool ok;
+        Stack::run([&] { ok = collectLine(node, from, end, out); });
+        return ok;
+    }
+    const Ast& ast = parser.tree();
+    Pos p;
+    size_t off;
+    uint32_t c = ast[node].first;
+    std::unordered_map<uint32_t, std::vector<uint32_t>>::const_iterator it = kids.find(node);
+    if (it != kids.end()) {     // 子结点多时跳过整个在 from 之前的部分
+        const std::vector<uint32_t>& ch = it->second;
+        size_t lo = 0, hi = ch.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (!nodeStart(ch[mid], p, off)) return false;
+            if (p < from) lo = mid + 1;
+            else hi = mid;
+        }
+        c = ch[lo ? lo - 1 : 0];
+    }
+    for (; c != Ast::NIL; c = ast[c].next) {
+        const Node& n = ast[c];
+        if (n.line == 0 || n.col == 0xFFFF) return false;
+        p = mapped(c, Pos{ n.line, n.col });
+        if (!(p < end)) break;
+        // 下一个兄弟仍在 from 之前时，这个子树整个在 from 之前（缺少记号时补的结点可以与下一个兄弟同位置）
+        if (n.next != Ast::NIL) {
+            const Node& m = ast[n.next];
+            if (m.line != 0 && m.col != 0xFFFF && mapped(n.next, Pos{ m.line, m.col }) < from) continue;
+        }
+        if (!(p < from)) out.push_back(c);
+        if (!isLeaf(n.kind) && !collectLine(c, from, end, out)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief
+ * 同一行内的编辑：这一行上 from 之后的旧结点（下标小于 watermark）列号加 delta，直接改写结点（换算前的位置同样加 delta）。
+ * 平移记录使改写后的位置换算出错时不改，返回 false，由调用方记一条平移
+ */
+bool Document::shiftLine(Pos from, int32_t delta, uint32_t watermark)
+{
+    Ast& ast = parser.tree();
+    std::vector<uint32_t> hit;
+    Pos at;
+    size_t off;
+    if (!nodeStart(ast.root(), at, off)) return false;
+    if (!(at < from) && at.line == from.line) hit.push_back(ast.root());
+    if (!collectLine(ast.root(), from, Pos{ from.line + 1, 0 }, hit)) return false;
+    // 新建的子树已按编辑后的文本定位
+    hit.erase(std::remove_if(hit.begin(), hit.end(), [watermark](uint32_t id) { return id >= watermark; }), hit.end());
+    for (uint32_t id : hit) {
+        const Node& n = ast[id];
+        Pos want = mapped(id, Pos{ n.line, n.col });
+        want.col += delta;
+        int64_t col = static_cast<int64_t>(n.col) + delta;
+        if (col <= 0 || col >= 0xFFFF || !(mapped(id, Pos{ n.line, static_cast<uint32_t>(col) }) == want)) return false;
+    }
+    for (uint32_t id : hit) ast.setPos(id, ast[id].line, static_cast<uint16_t>(ast[id].col + delta));
+    return true;
+}
+
+/* 第 first 条起的诊断按编辑平移 */
+void Document::shiftDiags(const Shift& sh, size_t first)
+{
+    for (size_t k = first; k < diags.size(); ++k) {
+        Diagnostic& d = diags[k];
+        Pos p{ static_cast<uint32_t>(d.line), static_cast<uint32_t>(d.col) };
+        if (d.line == 0 || p < sh.from) continue;
+        if (p.line == sh.from.line) {
+            d.col = static_cast<int>(p.col - sh.from.col + sh.to.col);
+            d.line = static_cast<int>(sh.to.line);
+        } else {
+            d.line = static_cast<int>(p.line - sh.from.line + sh.to.line);
+        }
+    }
+}
+
+/* ------------ 重新分析 ------------ */
+
+/* 子树的结点数 */
+static size_t subtreeSize(const Ast& ast, uint32_t id)
+{
+    size_t n = 0;
+    std::vector<uint32_t> stack(1, id);
+    while (!stack.empty()) {
+        uint32_t x = stack.back();
+        stack.pop_back();
+        ++n;
+        for (uint32_t c = ast[x].first; c != Ast::NIL; c = ast[c].next) stack.push_back(c);
+    }
+    return n;
+}
+
+/**
+ * @brief
+ * 对编辑后的文本重新分析单位 c；c 的区间按编辑前的文本，其终点随改动平移
+ */
+bool Document::tryReparse(Candidate& c, size_t removed, size_t n)
+{
+    const Ast& ast = parser.tree();
+    size_t end = c.end + n - removed;
+    c.unit.end = static_cast<uint32_t>(end);
+    c.unit.endKind = c.endKind;
+
+    // 分析到单位之后的记号为止：让词法分析器看到它的全部字符与其后的一个字符
+    size_t win = end;
+    while (win < size() && isAlnum(at(win))) ++win;
+    win = std::min(size(), win + 2);
+    moveGap(win);
+
+    LexStart from;
+    from.begin = c.start;
+    from.line = static_cast<int>(c.startPos.line);
+    from.lineStart = lineStart(c.startPos.line - 1);
+    from.inComment = false;
+    from.last = win == size();
+    Lexer lexer(buf.data(), win, from, &quiet);
+
+    size_t before = ast.size();
+    uint32_t first = c.unit.path.back(), last = c.unit.last != Ast::NIL ? c.unit.last : first;
+    uint32_t after = ast[last].next, repl;
+    if (!parser.reparse(c.unit, lexer, repl)) return false;
+
+    // 换下的结点的 next 不变，仍能沿着走到 last
+    std::vector<uint32_t> fresh;
+    size_t dropped = 0, added = 0, count = 0;
+    for (uint32_t x = first;; x = ast[x].next) {
+        dropped += subtreeSize(ast, x);
+        kids.erase(x);
+        ++count;
+        if (x == last) break;
+    }
+    for (uint32_t x = repl; x != after; x = ast[x].next) {
+        added += subtreeSize(ast, x);
+        fresh.push_back(x);
+    }
+    live = live + added - dropped;
+    std::unordered_map<uint32_t, std::vector<uint32_t>>::iterator it = kids.find(c.parent);
+    if (it != kids.end()) {
+        std::vector<uint32_t>& v = it->second;
+        v.erase(v.begin() + c.slot, v.begin() + c.slot + count);
+        v.insert(v.begin() + c.slot, fresh.begin(), fresh.end());
+    }
+    // 单位是首个子结点时，与它同位置的祖先（没有声明的块、主程序）随新的首记号移动，由 edit() 在平移之后改写
+    c.heads.clear();
+    for (size_t k = c.unit.path.size() - 1; k > 0 && c.unit.prev == Ast::NIL; --k) {
+        uint32_t up = c.unit.path[k - 1];
+        const Node& u = ast[up];
+        if (u.first != (k + 1 == c.unit.path.size() ? repl : c.unit.path[k]) || !(mapped(up, Pos{ u.line, u.col }) == c.startPos)) break;
+        c.heads.push_back(up);
+    }
+    c.headPos = Pos{ ast[repl].line, ast[repl].col };
+    stats.kind = ast[repl].kind == NodeKind::PROC_DECL ? EditStats::PROCEDURE : EditStats::STATEMENT;
+    stats.relexed = end - c.start;
+    stats.nodes = ast.size() - before;
+    return true;
+}
+
+/* 整篇重新分析 */
+void Document::reparseAll()
+{
+    moveGap(size());
+    Lexer lexer(buf.data(), size(), &quiet);
+    parser.parse(lexer);
+    diags = parser.diagnostics();
+    std::stable_sort(diags.begin(), diags.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        return a.line != b.line ? a.line < b.line : a.col < b.col;
+    });
+    shifts.clear();
+    kids.clear();
+    live = parser.tree().size();
+    stats.kind = EditStats::FULL;
+    stats.relexed = size();
+    stats.nodes = live;
+}
+
+/**
+ * @brief
+ * 编辑：先在旧树上找出包住改动的单位，再改文本，由内到外逐个尝试重新分析，都不行时整篇重新分析
+ */
+void Document::edit(size_t offset, size_t removed, const char* ins, size_t n)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+    stats = EditStats();
+    size_t total = size();
+    offset = std::min(offset, total);
+    removed = std::min(removed, total - offset);
+    size_t e = offset + removed;
+
+    Pos from, to;
+    positionOf(e, from.line, from.col);
+    // 只动记号之间的空白：两侧至少一侧是空白（或文本两端），或两侧都隔着空白
+    bool space = true;
+    for (size_t k = offset; k < e && space; ++k) space = isSpace(at(k));
+    space = space && allSpace(ins, n)
+         && ((removed && n) || offset == 0 || e == total || isSpace(at(offset - 1)) || isSpace(at(e)));
+
+    std::vector<Candidate> cands;
+    if (!space) locate(offset, e, cands);
+
+    uint32_t watermark = static_cast<uint32_t>(parser.tree().size());
+    editLines(offset, removed, ins, n);
+    replaceText(offset, removed, ins, n);
+    positionOf(offset + n, to.line, to.col);
+
+    bool done = space;
+    const Candidate* chosen = nullptr;
+    if (space) stats.kind = EditStats::SPACE;
+    for (size_t k = cands.size(); k-- > 0 && !done;) {
+        ++stats.attempts;
+        done = tryReparse(cands[k], removed, n);
+        if (!done) continue;
+        // 单位 [start, end) 内的诊断与单位之后那个记号上来自单位内部的语法错误换成新的，其后的随编辑平移
+        const Candidate& c = cands[k];
+        chosen = &c;
+        std::vector<Diagnostic> kept;
+        kept.reserve(diags.size() + parser.diagnostics().size());
+        size_t j = 0;
+        for (; j < diags.size() && diagBefore(diags[j], c.startPos.line, c.startPos.col); ++j) kept.push_back(diags[j]);
+        for (const Diagnostic& d : parser.diagnostics()) kept.push_back(d);
+        for (; j < diags.size() && diagBefore(diags[j], c.endPos.line, c.endPos.col); ++j) {}
+        size_t rest = kept.size();
+        for (; j < diags.size() && diagBefore(diags[j], c.endPos.line, c.endPos.col + 1); ++j)
+            if (!diags[j].syntax) kept.push_back(diags[j]);
+        kept.insert(kept.end(), diags.begin() + j, diags.end());
+        diags.swap(kept);
+        shiftDiags(Shift{ watermark, from, to }, rest);
+    }
+    if (!done) {
+        reparseAll();
+    } else {
+        if (space) shiftDiags(Shift{ watermark, from, to }, 0);
+        // 单位之后的结点随编辑平移：同一行内的直接改写，改变行数的记下来
+        if (!(from == to)) {
+            if (from.line != to.line || !shiftLine(from, static_cast<int32_t>(to.col) - static_cast<int32_t>(from.col), watermark))
+                shifts.push_back(Shift{ watermark, from, to });
+        }
+        if (chosen && !chosen->heads.empty()) {
+            Ast& ast = parser.tree();
+            uint32_t h = chosen->heads.front();
+            if (!(mapped(h, Pos{ ast[h].line, ast[h].col }) == chosen->headPos)) {
+                tree();
+                for (uint32_t id : chosen->heads) ast.setPos(id, chosen->headPos.line, static_cast<uint16_t>(chosen->headPos.col));
+            }
+        }
+        if (parser.tree().size() - live > live + 65536) reparseAll();
+        else if (shifts.size() >= MAX_SHIFTS) tree();
+    }
+    stats.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+}
@@ -0,0 +1,145 @@
+#ifndef PL0_INCREMENTAL_H
+#define PL0_INCREMENTAL_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../lexier/trace.h"
+#include "parser.h"
+
+/**
+ * @brief 增量分析的源程序文档
+ * 持有源程序文本及其语法树、诊断。edit() 把一段文本换掉之后，找出包住改动的最小单位
+ * （一条语句；复合语句中语句之间的改动为前后相连的几条语句；改动落在声明部分时为所在的过程声明），
+ * 只对它重新做词法与语法分析，其余子树原样保留，新子树换入原处：
+ *
+ * - 单位从首记号开始重新分析，DFA 从 START 出发；分析完后下一个记号须恰好从原来单位之后的
+ *   那个记号处开始，这时两边的 DFA 都在 START，其后的记号流必定相同。
+ *   改动打开了没有闭合的 `{`、删掉了注释的 `}`、把相邻记号连成一个等情形都过不了这一检查，
+ *   改为分析外一层的单位，最坏整篇重新分析；
+ * - 只改动记号之间空白的编辑不重新分析；
+ * - 文本与行首表都是间隙缓冲区，编辑只搬动间隙与上次编辑处之间的内容，不随文件大小增长；
+ * - 结点位置：同一行内的编辑只改这一行上单位之后的结点；改变行数的编辑记一条平移，
+ *   旧结点的位置在读取时按平移换算（结点下标小于记录时的树大小即为旧结点），
+ *   tree() 把全部平移落实到结点上，平移累计到 MAX_SHIFTS 条时也落实一次；
+ *   被换下的结点多于在用的结点时整篇重新分析一次，回收语法树的空间。
+ *
+ * 词法错误（非法字符等）不进入诊断列表，与分析时一样跳过该字符。
+ */
+class Document {
+public:
+    explicit Document(const std::string& text = std::string());
+
+    /* 整篇换成 text 并重新分析 */
+    void setText(const std::string& text);
+    /* 把 [offset, offset + removed) 换成 ins 的 n 个字节，更新语法树与诊断；越界部分截掉 */
+    void edit(size_t offset, size_t removed, const char* ins, size_t n);
+    void edit(size_t offset, size_t removed, const std::string& ins) { edit(offset, removed, ins.data(), ins.size()); }
+
+    /* 语法树，结点位置已按全部编辑更新（有未落实的平移时遍历一遍整棵树） */
+    const Ast& tree();
+    /* 语法树本身，不落实平移：其中结点的位置须经 position() 读取 */
+    const Ast& nodes() const { return parser.tree(); }
+    /* 结点的子结点下标；子结点多的缓存起来，编辑后随之更新，其余的到下一次调用为止有效 */
+    const std::vector<uint32_t>& children(uint32_t id);
+    /* 单个结点在当前文本中的位置，不必先更新整棵树 */
+    void position(uint32_t id, uint32_t& line, uint32_t& col) const;
+    /* 语法与语义诊断，按位置排序 */
+    const std::vector<Diagnostic>& diagnostics() const { return diags; }
+
+    size_t size() const { return buf.size() - (gapEnd - gapBegin); }
+    char at(size_t i) const { return buf[i < gapBegin ? i : i + (gapEnd - gapBegin)]; }
+    std::string text() const;
+
+    /* 偏移与 (行, 列) 互换，行、列从 1 起，列按字节计 */
+    size_t lineCount() const { return lines.size() - (lineGapEnd - lineGapBegin); }
+    size_t offsetOf(uint32_t line, uint32_t col) const;
+    void positionOf(size_t offset, uint32_t& line, uint32_t& col) const;
+
+    /* 上一次 edit() 做了什么 */
+    struct EditStats {
+        enum Kind : unsigned char { SPACE, STATEMENT, PROCEDURE, FULL };
+        Kind kind = FULL;
+        int attempts = 0;       // 尝试过的单位数，失败的退到外一层
+        size_t relexed = 0;     // 重新分析的字节数
+        size_t nodes = 0;       // 新子树的结点数
+        double seconds = 0;
+    };
+    const EditStats& lastEdit() const { return stats; }
+
+    static const size_t MAX_SHIFTS = 16;
+
+private:
+    Document(const Document&);              // 不可拷贝
+    Document& operator=(const Document&);
+
+    struct Pos {
+        uint32_t line, col;
+        bool operator<(const Pos& o) const { return line != o.line ? line < o.line : col < o.col; }
+        bool operator==(const Pos& o) const { return line == o.line && col == o.col; }
+    };
+    /* 一次改变行数的编辑：(line, col) 及其后的位置移到 (newLine, newCol) 起，只作用于下标小于 watermark 的结点 */
+    struct Shift {
+        uint32_t watermark;
+        Pos from, to;
+    };
+    /* 可以重新分析的单位及其在编辑前文本中的区间 */
+    struct Candidate {
+        ReparseUnit unit;
+        uint32_t parent, slot;  // 单位是 parent 的第 slot 个子结点
+        Tok endKind;            // 单位之后的第一个记号的种类
+        size_t start, end;
+        Pos startPos, endPos;
+        std::vector<uint32_t> heads;    // 重新分析后要移到新子树开头 headPos 的祖先
+        Pos headPos;
+    };
+    /* 查找子结点的结果 */
+    struct Found {
+        uint32_t id, prev, slot;
+        Tok endKind;
+        size_t start, end;
+        bool hasEnd;
+        Pos startPos, endPos;
+    };
+
+    // 源程序文本：间隙缓冲区，[gapBegin, gapEnd) 为间隙
+    std::string buf;
+    size_t gapBegin = 0, gapEnd = 0;
+    // 各行行首的偏移，也带间隙；间隙之后的记为到文本末尾的距离，编辑不必逐行改写
+    std::vector<uint32_t> lines;
+    size_t lineGapBegin = 0, lineGapEnd = 0;
+
+    Parser parser;
+    NullSink quietSink;
+    Tracer quiet;                       // 词法分析器的错误不输出
+    std::vector<Diagnostic> diags;
+    std::vector<Shift> shifts;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> kids;  // 子结点多的结点缓存其子结点下标
+    std::vector<uint32_t> scratch;
+    size_t live = 0;                    // 树中可达的结点数
+    EditStats stats;
+
+    void moveGap(size_t pos);
+    void replaceText(size_t offset, size_t removed, const char* ins, size_t n);
+    uint32_t lineStart(size_t k) const;
+    size_t lineAfter(size_t offset) const;      // 行首偏移大于 offset 的第一行（下标从 0 起）
+    void editLines(size_t offset, size_t removed, const char* ins, size_t n);
+
+    Pos mapped(uint32_t id, Pos p) const;
+    bool nodeStart(uint32_t id, Pos& p, size_t& offset) const;
+    bool findChild(uint32_t node, size_t s, size_t e, const Found& parent, Found& f);
+    bool findRun(uint32_t node, size_t s, size_t e, Found& f, uint32_t& last);
+    void locate(size_t s, size_t e, std::vector<Candidate>& out);
+    bool boundaryClean(const Pos& start, const Pos& end, uint32_t first, uint32_t last) const;
+    bool inUnit(uint32_t node, uint32_t first, uint32_t last) const;
+    bool programEnd(size_t& offset) const;
+    bool collectLine(uint32_t node, Pos from, Pos end, std::vector<uint32_t>& out);
+    bool shiftLine(Pos from, int32_t delta, uint32_t watermark);
+    void shiftDiags(const Shift& sh, size_t first);
+    bool tryReparse(Candidate& c, size_t removed, size_t n);
+    void reparseAll();
+};
+
+#endif
@@ -1,50 +1,96 @@
 #include "parser.h"
 #include <fstream>
-#include <sstream>
 #include <iostream>
-#include <cctype>
 
-/* ---------- 工具：去掉行首行尾空白 ---------- */
-static inline void trim(std::string& s){
-    while(!s.empty() && std::isspace(s.front())) s.erase(s.begin());
-    while(!s.empty() && std::isspace(s.back()))  s.pop_back();
-}
+#include "../lexier/profile.h"
+#include "../lexier/ring.h"
 
-int main(int argc,char* argv[])
+/*
+ * 用法: ./parser [--dot | --json] [--depth N] [--root ID | --stream] [--profile 文件] <tokens.txt>
+ * 默认输出缩进文本的语法树并在最后一行打印“语法正确”；
+ * --dot / --json 时标准输出只有树本身，“语法正确”改写到标准错误。
+ * 有错误时输出恢复后的语法树，再在标准错误按出现的先后列出全部语法、语义错误。
+ *
+ * --stream 时边读边分析边输出：记号文件（为 "-" 时读标准输入，可接管道）由后台线程逐个解码，
+ * 经定长的环形缓冲区交给语法分析器，树的结点建好即输出、分析完即回收，
+ * 内存与程序长度无关，只随嵌套深度增长；输出与不加 --stream 时相同，但不支持 --root。
+ *
+ * --profile 文件 给载入记号文件、取记号、各文法函数与输出计时，结束时把 Chrome 跟踪事件格式的 JSON
+ * 写到文件，汇总表写标准错误（见 ../lexier/profile.h）。
+ */
+static int streamMain(const char* path, TreeFormat fmt, const TreeLimits& lim)
 {
-    if(argc!=2){
-        std::cerr << "用法: " << argv[0] << " <tokens.txt>\n";
+    std::ifstream file;
+    if (std::string(path) != "-") {
+        file.open(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "无法打开 " << path << '\n';
+            return 1;
+        }
+    }
+    std::istream& in = file.is_open() ? static_cast<std::istream&>(file) : std::cin;
+    TokenStreamSource tokens(in);
+    std::unique_ptr<TreeStream> out = streamTree(std::cout, fmt, lim);
+    Parser p;
+    p.setStream(out.get());
+    {
+        TokenRing ring(tokens);
+        p.parse(ring);
+    }
+    if (!tokens.error().empty()) {
+        std::cerr << tokens.error() << '\n';
         return 1;
     }
+    std::cout.flush();
+    p.writeDiagnostics(std::cerr);
+    if(!p.getSyntaxErrorCount()) (fmt == TreeFormat::TEXT ? std::cout : std::cerr) << "语法正确\n";
+    return p.getErrorCount() ? 1 : 0;
+}
 
-    std::ifstream fin(argv[1]);
-    if(!fin){
-        std::cerr << "无法打开 " << argv[1] << '\n';
+int main(int argc,char* argv[])
+{
+    TreeFormat fmt = TreeFormat::TEXT;
+    TreeLimits lim;
+    bool streaming = false;
+    std::string profilePath;
+    int argi = 1;
+    for(; argi < argc - 1; ++argi){
+        if(std::string(argv[argi]) == "--stream") streaming = true;
+        else if(std::string(argv[argi]) == "--profile") profilePath = argv[++argi];
+        else if(!parseTreeOption(argc, argv, argi, fmt, lim)) break;
+    }
+    if(argi != argc - 1 || (streaming && lim.root != Ast::NIL)){
+        std::cerr << "用法: " << argv[0] << " [--dot | --json] [--depth N] [--root ID | --stream] [--profile 文件] <tokens.txt>\n";
         return 1;
     }
+    const char* path = argv[argi];
+    ProfileSession profile(profilePath);
+    if(streaming){
+        std::ios::sync_with_stdio(false);   // 从标准输入读记号时不经 stdio 逐字符同步
+        return streamMain(path, fmt, lim);
+    }
 
-    /* 1️⃣ 读取 token 文件 -> vector<RawToken> */
-    std::vector<RawToken> tokens;
-    std::string line;
-    while(std::getline(fin,line)){
-        trim(line);
-        if(line.empty()) continue;
-        if(line.front()!='(' || line.back()!=')'){
-            std::cerr<<"格式错误: "<<line<<'\n'; return 1;
-        }
-        std::string inner = line.substr(1,line.size()-2);
-        auto comma = inner.find(',');
-        if(comma==std::string::npos){
-            std::cerr<<"缺少逗号: "<<line<<'\n'; return 1;
-        }
-        std::string type  = inner.substr(0,comma);
-        std::string lexeme= inner.substr(comma+1);
-        trim(type); trim(lexeme);
-        tokens.push_back({type,lexeme});
+    /* 1️⃣ 读取记号文件：二进制 (lexer -b 生成) 整块加载，否则按 (type,lexeme) 文本逐行读取 */
+    TokenFile tf;
+    std::string why;
+    bool ok = isBinaryTokenFile(path) ? readTokensBinary(path,tf,why)
+                                      : readTokensText(path,tf,why);
+    if(!ok){
+        std::cerr << why << '\n';
+        return 1;
     }
 
     /* 2️⃣ 语法分析 */
-    Parser p(tokens);
-    p.parse();                 // 成功打印“语法正确”
-    return 0;
-}
\ No newline at end of file
+    TokenFileSource src(tf);
+    Parser p(src);
+    const Ast& ast = p.parse();
+    if(!hasRoot(ast, lim)){
+        std::cerr << "--root " << lim.root << ": 语法树只有 " << ast.size() << " 个结点\n";
+        return 1;
+    }
+    writeTree(ast, std::cout, fmt, lim);
+    std::cout.flush();
+    p.writeDiagnostics(std::cerr);
+    if(!p.getSyntaxErrorCount()) (fmt == TreeFormat::TEXT ? std::cout : std::cerr) << "语法正确\n";
+    return p.getErrorCount() ? 1 : 0;   // 有错误时以 1 退出
+}
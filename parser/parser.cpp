@@ -1,63 +1,35 @@
 #include "parser.h"
-#include <iostream>
+#include <cstdio>
 #include <cstdlib>
 
-/* —— 将字符串映射到枚举 —— */
-static const std::unordered_map<std::string,Tok> tbl = {
- /* 关键字 */
- {"beginsym",Tok::BEGINSYM}, {"endsym",Tok::ENDSYM},
- {"constsym",Tok::CONSTSYM}, {"varsym",Tok::VARSYM},
- {"proceduresym",Tok::PROCEDURESYM}, {"callsym",Tok::CALLSYM},
- {"ifsym",Tok::IFSYM}, {"elsesym",Tok::ELSESYM},{"thensym",Tok::THENSYM},
- {"whilesym",Tok::WHILESYM}, {"dosym",Tok::DOSYM},
- {"oddsym",Tok::ODDSYM},
- {"readsym",Tok::READSYM}, {"writesym",Tok::WRITESYM},
- /* 标识符 / 常数 */
- {"ident",Tok::IDENT}, {"number",Tok::NUMBER},
- /* 运算符 */
- {"plus",Tok::PLUS}, {"minus",Tok::MINUS},
- {"times",Tok::TIMES}, {"slash",Tok::SLASH},
- {"eql",Tok::EQL}, {"neq",Tok::NEQ},
- {"lss",Tok::LSS}, {"leq",Tok::LEQ},
- {"gtr",Tok::GTR}, {"geq",Tok::GEQ},
- {"becomes",Tok::BECOMES},
- /* 分隔符 */
- {"lparen",Tok::LPAREN}, {"rparen",Tok::RPAREN},
- {"comma",Tok::COMMA}, {"semicolon",Tok::SEMICOLON},
- {"period",Tok::PERIOD}
-};
-
-// 当前缩进层次
-int indent_level = 0;
-
-/**
- * @brief 
- * 输出ast树
- * @param label 
- */
-void printNode(const std::string& label) {
-    for (int i = 0; i < indent_level; ++i) std::cout << "  ";
-    std::cout << label << std::endl;
-}
+#include "../lexier/errmsg.h"
+#include "../lexier/profile.h"
+#include "../lexier/stack.h"
 
 /* ------------ 构造 & 小工具 ------------ */
 /**
  * @brief Construct a new Parser:: Parser object
- * 将原始Tokens符号流转换为解析后的Tok类型
- * @param raw 
+ * 预取第一个记号
+ * @param src 记号来源
  */
-Parser::Parser(const std::vector<RawToken>& raw)
+Parser::Parser(TokenSource& src) : src(&src)
 {
-    for (auto& r: raw) {
-        auto it = tbl.find(r.type);
-        toks.push_back({ it==tbl.end()?Tok::END : it->second, r.lexeme });
-    }
-    toks.push_back({Tok::END,""});
+    adv();
+}
+
+/**
+ * @brief Construct a new Parser:: Parser object
+ * 不带记号来源，当前记号为虚拟 EOF
+ */
+Parser::Parser() : src(nullptr)
+{
+    look.kind = Tok::END;
 }
+
 /**
  * @brief 获取当前Token
  */
-Parser::Token& Parser::cur()            { return toks[pos]; }
+Token& Parser::cur()                    { return look; }
 /**
  * @brief 
  * 当前是否是特定Token
@@ -65,382 +37,909 @@ Parser::Token& Parser::cur()            { return toks[pos]; }
  * @return true 
  * @return false 
  */
-bool  Parser::is(Tok t)                 { return cur().t==t; }
+bool  Parser::is(Tok t)                 { return cur().kind==t; }
+/**
+ * @brief 
+ * 当前记号是否属于集合 s
+ * @param s 
+ */
+bool  Parser::in(TokSet s)              { return (s >> static_cast<int>(cur().kind)) & 1; }
 
 /**
  * @brief 
- * 移动到下一个Token
+ * 移动到下一个Token，记号流结束后停在虚拟的 EOF 上
  */
-void Parser::adv()                     { ++pos; }
+void Parser::adv()
+{
+    PL0_ZONE(Zone::FETCH);
+    lookAtom = Interner::NONE;
+    errorRecoveryMode = false;      // 消耗了记号，恢复结束
+    if (!src->next(look)) {      /* 虚拟 EOF：词素为空，位置沿用最后一个记号 */
+        look.kind = Tok::END;
+        look.len = 0;
+    }
+}
 
 /**
  * @brief 
- * 报错
+ * 当前记号的词素
+ * @return std::string 
+ */
+std::string Parser::lex()              { return src->text(cur()); }
+
+/**
+ * @brief 
+ * 报告语法错误并进入恢复模式，不退出、不跳过记号；
+ * 恢复模式下（上一个语法错误之后还没有消耗记号）不再报告，免得同一处出现连串的错误
  * @param m 
  */
 void Parser::err(const std::string& m)
 {
-    std::cerr<<"语法错误: "<<m<<"，near '"<<cur().lex<<"'\n"; 
-    std::exit(1);
+    if (errorRecoveryMode) {
+        diags[recoveryDiag].node = path.empty() ? Ast::NIL : path.back().id;
+        return;
+    }
+    errorRecoveryMode = true;
+    recoveryDiag = diags.size();
+    reportError("语法错误: " + m + "，near '" + lex() + "'", true);
+}
+
+/**
+ * @brief 
+ * 跳过记号，直到当前记号属于 sync 或到达 EOF
+ * @param sync 同步集
+ */
+void Parser::errorRecovery(TokSet sync)
+{
+    while (!in(sync) && !is(Tok::END)) adv();
+}
+
+/**
+ * @brief 
+ * 当前记号不属于 expected 时报错 m，并跳到 expected 或 stop 中的记号
+ * @param expected 此处合法的记号
+ * @param stop 另外可以停下的记号
+ * @param m 
+ */
+void Parser::test(TokSet expected, TokSet stop, const std::string& m)
+{
+    if (in(expected)) return;
+    err(m);
+    errorRecovery(expected | stop);
+}
+
+/**
+ * @brief 
+ * 新建结点，挂到当前所在结点的子结点末尾；路径为空时作为根
+ * @return uint32_t 新结点的下标
+ */
+uint32_t Parser::attach(NodeKind k, const Token& at, Lexeme text)
+{
+    uint32_t id;
+    if (path.empty()) id = ast.add(Ast::NIL, Ast::NIL, k, at, text);
+    else path.back().last = id = ast.add(path.back().id, path.back().last, k, at, text);
+    if (stream) emit(id);
+    return id;
+}
+
+/**
+ * @brief 
+ * 流式分析：把刚建好的结点交给 stream，叶子随即删去；父结点不再记着它，下一个子结点从头挂起
+ * @param id 
+ */
+void Parser::emit(uint32_t id)
+{
+    int depth = static_cast<int>(path.size());
+    stream->node(ast, id, streamed++, depth);
+    if (isLeaf(ast[id].kind)) {
+        stream->end(depth);
+        ast.truncate(id);
+        path.back().last = Ast::NIL;
+    }
+}
+
+/**
+ * @brief 
+ * 新建非终结符结点并进入，之后建的结点都挂在它下面，直到 close()
+ * @param k 
+ */
+void Parser::open(NodeKind k)
+{
+    uint32_t id = attach(k, cur());
+    path.push_back(Open{ id, Ast::NIL });
 }
 
 /**
  * @brief 
- * 预期的Token
+ * 退回上一层结点
+ */
+void Parser::close()
+{
+    if (stream) {       // 子树分析完毕，连同结点本身一起删去
+        stream->end(static_cast<int>(path.size()) - 1);
+        ast.truncate(path.back().id);
+    }
+    path.pop_back();
+    if (stream && !path.empty()) path.back().last = Ast::NIL;
+}
+
+/**
+ * @brief 
+ * 以当前记号建叶子，词素拷入语法树
+ * @param k 
+ */
+void Parser::leaf(NodeKind k)
+{
+    if (k == NodeKind::IDENT && is(Tok::IDENT)) {   // 标识符只记原子编号
+        Open& top = path.back();
+        top.last = ast.addIdent(top.id, top.last, cur(), atom());
+        if (stream) emit(top.last);
+        return;
+    }
+    if (k == NodeKind::NUMBER && is(Tok::NUMBER)) {  // 常数连同词法分析时算好的值
+        Open& top = path.back();
+        top.last = ast.addNumber(top.id, top.last, cur(), src->lexeme(cur()), src->number(cur()));
+        if (stream) emit(top.last);
+        return;
+    }
+    attach(k, cur(), src->lexeme(cur()));
+}
+
+/**
+ * @brief 
+ * 建关键字或界符叶子，位置取当前记号
+ * @param t 
+ */
+void Parser::sym(Tok t)
+{
+    Token at = cur();
+    at.kind = t;
+    attach(NodeKind::SYMBOL, at);
+}
+
+/**
+ * @brief 
+ * 建因子中的括号叶子
+ * @param t 
+ */
+void Parser::paren(Tok t)
+{
+    Token at = cur();
+    at.kind = t;
+    attach(NodeKind::PAREN, at);
+}
+
+/* 记号在错误消息中的写法 */
+static std::string tokToString(Tok t)
+{
+    switch (t) {
+        case Tok::BEGINSYM: return "begin";
+        case Tok::ENDSYM: return "end";
+        case Tok::CONSTSYM: return "const";
+        case Tok::VARSYM: return "var";
+        case Tok::PROCEDURESYM: return "procedure";
+        case Tok::CALLSYM: return "call";
+        case Tok::IFSYM: return "if";
+        case Tok::ELSESYM: return "else";
+        case Tok::THENSYM: return "then";
+        case Tok::WHILESYM: return "while";
+        case Tok::DOSYM: return "do";
+        case Tok::ODDSYM: return "odd";
+        case Tok::READSYM: return "read";
+        case Tok::WRITESYM: return "write";
+        case Tok::IDENT: return "标识符";
+        case Tok::NUMBER: return "常数";
+        case Tok::PLUS: return "+";
+        case Tok::MINUS: return "-";
+        case Tok::TIMES: return "*";
+        case Tok::SLASH: return "/";
+        case Tok::EQL: return "=";
+        case Tok::NEQ: return "<>";
+        case Tok::LSS: return "<";
+        case Tok::LEQ: return "<=";
+        case Tok::GTR: return ">";
+        case Tok::GEQ: return ">=";
+        case Tok::BECOMES: return ":=";
+        case Tok::LPAREN: return "(";
+        case Tok::RPAREN: return ")";
+        case Tok::COMMA: return ",";
+        case Tok::SEMICOLON: return ";";
+        case Tok::PERIOD: return ".";
+        case Tok::END: return "<EOF>";
+        default: return "<未知符号>";
+    }
+}
+
+/**
+ * @brief 
+ * 预期的Token：是则消耗，否则报错并当作已补上，不跳过当前记号
  * @param t 
  */
 void Parser::expect(Tok t)
 {
     if (!is(t)) {
         std::string expected = tokToString(t);
-        std::string found = tokToString(cur().t);
+        std::string found = tokToString(cur().kind);
         err("缺少预期符号: '" + expected + "'，但遇到 '" + found + "'");
+        return;
     }
     adv();
 }
 
-/* ------------ 递归下降实现 ------------ */
+/* ------------ 符号表与语义检查 ------------ */
+
+/* checkIdent 的 allowed：允许出现的符号种类 */
+static unsigned typeBit(Symbol::Type t) { return 1u << static_cast<int>(t); }
+static const unsigned VAR_ONLY = 1u << static_cast<int>(Symbol::Type::VAR);
+static const unsigned PROC_ONLY = 1u << static_cast<int>(Symbol::Type::PROCEDURE);
+static const unsigned CONST_OR_VAR = VAR_ONLY | 1u << static_cast<int>(Symbol::Type::CONST);
 
 /**
  * @brief 
- * 语法分析总函数
+ * 当前标识符的原子编号
+ * @return uint32_t 
  */
-void Parser::parse(){ 
-    program(); 
-    if(!is(Tok::END)) err("多余符号"); 
-    else std::cout << "语法正确\n";
+uint32_t Parser::atom()
+{
+    if (lookAtom == Interner::NONE) lookAtom = src->atom(cur());
+    return lookAtom;
 }
 
 /**
  * @brief 
- * 程序=[块][结束符]
+ * 在当前层登记符号；同层重名时新符号遮住旧的
+ * @param name 
+ * @param type 
+ * @param value 常量的值
  */
-void Parser::program(){ 
-    printNode("Program");
-    indent_level++;
-    block();
-    if(!is(Tok::PERIOD)) err("缺少 '.'"); adv();
-    indent_level--;
+void Parser::enterSymbol(uint32_t name, Symbol::Type type, int64_t value)
+{
+    symbols.declare(name, type, value);
 }
 
 /**
  * @brief 
- * 块=[常量声明][变量声明][过程声明]<语句>
+ * 按作用域规则查找名字，找不到返回 nullptr
+ * @param name 
+ * @return Symbol* 
  */
-void Parser::block()
+Symbol* Parser::findSymbol(uint32_t name)
 {
-    printNode("Block");
-    indent_level++;
-    
-    // 常量声明
-    if (is(Tok::CONSTSYM)) {
-    printNode("Const Declaration");
-    indent_level++;
+    return symbols.find(name);
+}
 
-    printNode("CONST");
-    adv();
+/**
+ * @brief 
+ * 检查当前标识符：未声明报 11，种类不在 allowed 中报 bad；只报告，不中止分析
+ * @param allowed typeBit 的组合
+ * @param bad 种类不符时的错误号
+ */
+void Parser::checkIdent(unsigned allowed, int bad)
+{
+    if (!is(Tok::IDENT)) return;
+    Symbol* s = findSymbol(atom());
+    if (!s) semanticError(11);
+    else if (!(allowed & typeBit(s->type))) semanticError(bad);
+}
 
-    if (!is(Tok::IDENT)) err("const 后应为标识符");
-    printNode("IDENT: " + cur().lex);
-    adv();
+/**
+ * @brief 
+ * 报告语义错误，格式同词法错误，附上当前标识符及其位置
+ * @param n 错误号，对应 err_msg
+ */
+void Parser::semanticError(int n)
+{
+    char head[16];
+    std::snprintf(head, sizeof(head), "Error %3d: ", n);
+    reportError(std::string(head) + err_msg[n] + " '" + lex() + "'");
+}
 
-    if (!is(Tok::EQL)) err("缺少 '='");
-    printNode("EQL '='");
-    adv();
+/**
+ * @brief 
+ * 记下一条诊断，位置取当前记号，计入错误数；分析结束后统一输出
+ * @param message 
+ * @param syntax 是否为语法错误
+ */
+void Parser::reportError(const std::string& message, bool syntax)
+{
+    ++errorCount;
+    if (syntax) ++syntaxErrorCount;
+    uint32_t node = path.empty() ? Ast::NIL : path.back().id;
+    diags.push_back(Diagnostic{ syntax, static_cast<int>(cur().line), static_cast<int>(cur().col), message, node });
+}
 
-    if (!is(Tok::NUMBER)) err("常数缺失");
-    printNode("NUMBER: " + cur().lex);
-    adv();
+/**
+ * @brief 
+ * 按出现的先后输出全部诊断
+ * @param out 
+ */
+void Parser::writeDiagnostics(std::ostream& out) const
+{
+    for (const Diagnostic& d : diags) {
+        out << d.message;
+        if (d.line) out << " at Line " << d.line << ", Col " << d.col;
+        out << '\n';
+    }
+}
 
-    while (is(Tok::COMMA)) {
-        printNode("COMMA ','");
-        adv();
-        if (!is(Tok::IDENT)) err("标识符缺失");
-        printNode("IDENT: " + cur().lex);
-        adv();
+/* ------------ 递归下降实现 ------------ */
 
-        if (!is(Tok::EQL)) err("缺少 '='");
-        printNode("EQL '='");
-        adv();
+/*
+ * block、statement、expression 各在一个递归环上，入口处检查栈：嵌套太深、当前栈段快用完时
+ * 换到新的栈段上继续（见 ../lexier/stack.h），嵌套深度只受内存限制
+ */
 
-        if (!is(Tok::NUMBER)) err("常数缺失");
-        printNode("NUMBER: " + cur().lex);
-        adv();
-    }
+/* 同步集：声明、语句、因子的 FIRST 集与比较运算符；语句的 FIRST 集不含标识符，免得恢复时停在表达式中的名字上 */
+static const TokSet DECL_BEGIN = toks(Tok::CONSTSYM, Tok::VARSYM, Tok::PROCEDURESYM);
+static const TokSet STMT_BEGIN = toks(Tok::BEGINSYM, Tok::CALLSYM, Tok::IFSYM, Tok::WHILESYM, Tok::READSYM, Tok::WRITESYM);
+static const TokSet FACTOR_BEGIN = toks(Tok::IDENT, Tok::NUMBER, Tok::LPAREN);
+static const TokSet REL_OPS = toks(Tok::EQL, Tok::NEQ, Tok::LSS, Tok::LEQ, Tok::GTR, Tok::GEQ);
+/* 主程序块的 follow：缺少 '.' 时停在 EOF 上报告 */
+static const TokSet PROGRAM_FOLLOW = toks(Tok::PERIOD, Tok::END) | DECL_BEGIN | STMT_BEGIN;
 
-    if (!is(Tok::SEMICOLON)) err("缺少 ';'");
-    printNode("SEMICOLON ';'");
+/**
+ * @brief 
+ * 语法分析总函数，建好的语法树在下一次 parse() 之前有效；
+ * 出错后跳到同步记号继续分析，一趟报告全部错误
+ * @return const Ast& 
+ */
+const Ast& Parser::parse(){ 
+    PL0_ZONE(Zone::PARSE);
+    ast.clear();
+    ast.setInterner(&src->interner());
+    path.clear();
+    symbols.clear();
+    scopeKey.clear();
+    diags.clear();
+    errorCount = syntaxErrorCount = 0;
+    errorRecoveryMode = false;
+    streamed = 0;
+    program(); 
+    if(!is(Tok::END)) err("多余符号"); 
+    if(stream) stream->finish();
+    PL0_COUNT(Counter::AST_NODES, stream ? streamed : ast.size());
+    return ast;
+}
+
+/**
+ * @brief 
+ * 改从 from 取记号，整篇重新分析
+ * @param from 
+ * @return const Ast& 
+ */
+const Ast& Parser::parse(TokenSource& from)
+{
+    src = &from;
+    look = Token();     // 没有记号时虚拟 EOF 的位置为未知，不沿用上一次分析的
     adv();
+    return parse();
+}
+
+/**
+ * @brief 
+ * 程序=[块][结束符]
+ */
+void Parser::program(){ 
+    PL0_ZONE(Zone::PROGRAM);
+    open(NodeKind::PROGRAM);
+    block(PROGRAM_FOLLOW);
+    if(is(Tok::PERIOD)) adv(); else err("缺少 '.'");
+    close();
+}
 
-    indent_level--;
+/**
+ * @brief 
+ * 块=[常量声明][变量声明][过程声明]<语句>
+ * 声明次序不对时报错后照常分析，再回到声明部分
+ * @param follow 
+ */
+void Parser::block(TokSet follow)
+{
+    if (Stack::low()) return Stack::run([&] { block(follow); });
+    PL0_ZONE(Zone::BLOCK);
+    open(NodeKind::BLOCK);
+    TokSet declFollow = follow | DECL_BEGIN | STMT_BEGIN | toks(Tok::IDENT);
+
+    for (;;) {
+        // 常量声明
+        if (is(Tok::CONSTSYM)) constDecl(declFollow);
+        // 变量声明
+        if (is(Tok::VARSYM)) varDecl(declFollow);
+        // 过程声明
+        while(is(Tok::PROCEDURESYM)) procDecl(follow);
+        test(STMT_BEGIN | toks(Tok::IDENT) | follow, DECL_BEGIN, "声明后应为语句");
+        if (!in(DECL_BEGIN)) break;
+        err("声明应按 const、var、procedure 的次序出现");
     }
-    // 变量声明
-    if (is(Tok::VARSYM)) {
-    printNode("Var Declaration");
-    indent_level++;
+    statement(follow);
+    close();
+}
 
-    printNode("VAR");
+/**
+ * @brief
+ * 过程声明=procedure <标识符>;<块>;
+ * @param follow 所在块的 follow
+ */
+void Parser::procDecl(TokSet follow)
+{
+    PL0_ZONE(Zone::PROC_DECL);
+    TokSet declFollow = follow | DECL_BEGIN | STMT_BEGIN | toks(Tok::IDENT);
+    open(NodeKind::PROC_DECL);
+    sym(Tok::PROCEDURESYM);
     adv();
+    if(is(Tok::IDENT)){
+        leaf(NodeKind::IDENT);
+        enterSymbol(atom(), Symbol::Type::PROCEDURE);    // 过程名属于外层，过程体内可递归调用
+        adv();
+    }else err("过程名缺失");
+    sym(Tok::SEMICOLON);
+    if(is(Tok::SEMICOLON)) adv(); else err("缺少 ;");
+    symbols.enterScope();
+    block(declFollow | toks(Tok::SEMICOLON));
+    symbols.leaveScope();
+    sym(Tok::SEMICOLON);
+    if(is(Tok::SEMICOLON)){
+        adv();
+        test(STMT_BEGIN | toks(Tok::IDENT, Tok::PROCEDURESYM) | follow, DECL_BEGIN, "过程声明后应为语句或过程声明");
+    }else err("缺少 ;");
+    close();
+}
 
-    if (!is(Tok::IDENT)) err("var 后应为标识符");
-    printNode("IDENT: " + cur().lex);
+/**
+ * @brief
+ * 常量声明=CONST<常量定义>{,<常量定义>};
+ * @param follow 
+ */
+void Parser::constDecl(TokSet follow)
+{
+    PL0_ZONE(Zone::CONST_DECL);
+    open(NodeKind::CONST_DECL);
+    sym(Tok::CONSTSYM);
     adv();
-
+    TokSet sync = follow | toks(Tok::COMMA, Tok::SEMICOLON);
+    constDef("const 后应为标识符", sync);
     while (is(Tok::COMMA)) {
-        printNode("COMMA ','");
-        adv();
-        if (!is(Tok::IDENT)) err("标识符缺失");
-        printNode("IDENT: " + cur().lex);
+        sym(Tok::COMMA);
         adv();
+        constDef("标识符缺失", sync);
     }
+    endDecl(follow);
+    close();
+}
 
-    if (!is(Tok::SEMICOLON)) err("缺少 ';'");
-    printNode("SEMICOLON ';'");
+/**
+ * @brief
+ * 常量定义=<标识符>=<无符号整数>，出错时跳到 follow
+ * @param missing 缺少标识符时的消息
+ * @param follow 
+ */
+void Parser::constDef(const char* missing, TokSet follow)
+{
+    if (!is(Tok::IDENT)) {
+        err(missing);
+        errorRecovery(follow);
+        if (!is(Tok::IDENT)) return;    // 停在标识符上时把它当作常量名
+    }
+    leaf(NodeKind::IDENT);
+    uint32_t name = atom();
     adv();
 
-    indent_level--;
-    }
-    while(is(Tok::PROCEDURESYM)){
-        adv(); if(!is(Tok::IDENT)) err("过程名缺失"); adv();
-        if(!is(Tok::SEMICOLON)) err("缺少 ;"); adv();
-        block(); if(!is(Tok::SEMICOLON)) err("缺少 ;"); adv();
+    sym(Tok::EQL);
+    if (is(Tok::EQL)) adv();
+    else if (is(Tok::BECOMES)) { err("常量定义应为 '=' 而不是 ':='"); adv(); }
+    else err("缺少 '='");
+
+    if (!is(Tok::NUMBER)) {
+        err("常数缺失");
+        errorRecovery(follow);
+        return;
     }
-    statement();
-    indent_level--;
+    leaf(NodeKind::NUMBER);
+    enterSymbol(name, Symbol::Type::CONST, src->number(cur()));
+    adv();
 }
 
 /**
- * @brief
- * 常量声明=CONST<常量定义>{,<常量定义>};
+ * @brief 
+ * 变量声明=VAR<变量定义>{,<变量定义>};
+ * @param follow 
  */
-void Parser::constDecl()
+void Parser::varDecl(TokSet follow)
 {
-    if(!is(Tok::IDENT)) err("const 后应为标识符"); adv();
-    if(!is(Tok::EQL))   err("= 缺失");            adv();
-    if(!is(Tok::NUMBER))err("常数缺失");          adv();
-    while(is(Tok::COMMA)){
-        adv(); if(!is(Tok::IDENT)) err("标识符缺失"); adv();
-        if(!is(Tok::EQL)) err("= 缺失"); adv();
-        if(!is(Tok::NUMBER)) err("常数缺失"); adv();
+    PL0_ZONE(Zone::VAR_DECL);
+    open(NodeKind::VAR_DECL);
+    sym(Tok::VARSYM);
+    adv();
+    TokSet sync = follow | toks(Tok::COMMA, Tok::SEMICOLON);
+    const char* missing = "var 后应为标识符";
+    for (;;) {
+        if (!is(Tok::IDENT)) {
+            err(missing);
+            errorRecovery(sync);        // 停在标识符上时把它当作变量名
+        }
+        if (is(Tok::IDENT)) {
+            leaf(NodeKind::IDENT);
+            enterSymbol(atom(), Symbol::Type::VAR);
+            adv();
+        }
+        if (!is(Tok::COMMA)) break;
+        sym(Tok::COMMA);
+        adv();
+        missing = "标识符缺失";
     }
+    endDecl(follow);
+    close();
 }
 
 /**
  * @brief 
- * 变量声明=VAR<变量定义>{,<变量定义>};
+ * 声明末尾的 ';'；缺少时报错，跳过记号直到 ';' 或 follow 中除标识符以外的记号，
+ * 免得把声明里多出来的名字当成赋值语句
+ * @param follow 
  */
-void Parser::varDecl()
+void Parser::endDecl(TokSet follow)
 {
-    if(!is(Tok::IDENT)) err("var 后应为标识符"); adv();
-    while(is(Tok::COMMA)){ adv(); if(!is(Tok::IDENT)) err("标识符缺失"); adv(); }
+    sym(Tok::SEMICOLON);
+    if (!is(Tok::SEMICOLON)) {
+        err("缺少 ';'");
+        errorRecovery((follow & ~toks(Tok::IDENT)) | toks(Tok::SEMICOLON));
+    }
+    if (is(Tok::SEMICOLON)) adv();
 }
 
 /**
  * @brief 
  * 语句=<赋值语句>|<条件语句>|<当循环语句>|<过程调用语句>
  |<复合语句>|<读语句><写语句>|<空>
+ * 语句之后的记号不在 follow 中时报错并跳到 follow
+ * @param follow 
  */
-void Parser::statement()
+void Parser::statement(TokSet follow)
 {
-    printNode("Statement");
-    indent_level++;
+    if (Stack::low()) return Stack::run([&] { statement(follow); });
+    PL0_ZONE(Zone::STATEMENT);
+    open(NodeKind::STATEMENT);
 
     // 赋值语句=<标识符>=<表达式>;
     if (is(Tok::IDENT)) {
-        printNode("Assignment");
-        indent_level++;
-        printNode("IDENT: " + cur().lex);
+        open(NodeKind::ASSIGN);
+        checkIdent(VAR_ONLY, 12);
+        leaf(NodeKind::IDENT);
         adv();
-        printNode("BECOMES ':='");
-        expect(Tok::BECOMES);
-        expression();
-        indent_level--;
+        sym(Tok::BECOMES);
+        if (is(Tok::EQL)) { err("赋值应为 ':=' 而不是 '='"); adv(); }
+        else expect(Tok::BECOMES);
+        expression(follow);
+        close();
     }
     // 过程调用语句=call <标识符>;
     else if (is(Tok::CALLSYM)) {
-        printNode("Procedure Call");
-        indent_level++;
-        printNode("CALL");
+        open(NodeKind::CALL);
+        sym(Tok::CALLSYM);
         adv();
-        printNode("IDENT: " + cur().lex);
+        checkIdent(PROC_ONLY, 15);
+        leaf(NodeKind::IDENT);
         expect(Tok::IDENT);
-        indent_level--;
+        close();
     }
     // 复合语句=begin<语句>{;<语句>}end
     else if (is(Tok::BEGINSYM)) {
-        printNode("Begin-End Block");
-        indent_level++;
-        printNode("BEGIN");
+        open(NodeKind::COMPOUND);
+        sym(Tok::BEGINSYM);
         adv();
-        statement();
-        while (is(Tok::SEMICOLON)) {
-            printNode("SEMICOLON ';'");
-            adv();
-            statement();
+        // 语句之间缺少 ';' 时，下一条语句的开头也算同步点
+        TokSet inner = follow | STMT_BEGIN | toks(Tok::IDENT, Tok::SEMICOLON, Tok::ENDSYM);
+        statement(inner);
+        while (is(Tok::SEMICOLON) || in(STMT_BEGIN | toks(Tok::IDENT))) {
+            sym(Tok::SEMICOLON);
+            if (is(Tok::SEMICOLON)) adv();
+            else err("语句之间缺少 ';'");
+            statement(inner);
         }
-        printNode("END");
+        sym(Tok::ENDSYM);
         expect(Tok::ENDSYM);
-        indent_level--;
+        close();
     }
     // 条件语句=if <条件> then <语句> [else <语句>]
     else if (is(Tok::IFSYM)) {
-        printNode("If Statement");
-        indent_level++;
-        printNode("IF");
+        open(NodeKind::IF);
+        sym(Tok::IFSYM);
         adv();
-        condition();
-        printNode("THEN");
+        condition(follow | toks(Tok::THENSYM, Tok::DOSYM));
+        sym(Tok::THENSYM);
         expect(Tok::THENSYM);
-        statement();
+        statement(follow | toks(Tok::ELSESYM));
         if (is(Tok::ELSESYM)) {
-            printNode("ELSE");
+            sym(Tok::ELSESYM);
             adv();
-            statement();
+            statement(follow);
         }
-        indent_level--;
+        close();
     }
     // 当循环语句=while <条件> do <语句>
     else if (is(Tok::WHILESYM)) {
-        printNode("While Loop");
-        indent_level++;
-        printNode("WHILE");
+        open(NodeKind::WHILE);
+        sym(Tok::WHILESYM);
         adv();
-        condition();
-        printNode("DO");
+        condition(follow | toks(Tok::DOSYM));
+        sym(Tok::DOSYM);
         expect(Tok::DOSYM);
-        statement();
-        indent_level--;
+        statement(follow);
+        close();
     }
     // 读语句=read(<标识符>);
     else if (is(Tok::READSYM)) {
-        printNode("Read Statement");
-        indent_level++;
-        printNode("READ");
+        open(NodeKind::READ);
+        sym(Tok::READSYM);
         adv();
-        printNode("LPAREN '('");
+        sym(Tok::LPAREN);
         expect(Tok::LPAREN);
-        printNode("IDENT: " + cur().lex);
+        checkIdent(VAR_ONLY, 12);
+        leaf(NodeKind::IDENT);
         expect(Tok::IDENT);
-        printNode("RPAREN ')'");
+        sym(Tok::RPAREN);
         expect(Tok::RPAREN);
-        indent_level--;
+        close();
     }
     // 写语句=write(<表达式>);
     else if (is(Tok::WRITESYM)) {
-        printNode("Write Statement");
-        indent_level++;
-        printNode("WRITE");
+        open(NodeKind::WRITE);
+        sym(Tok::WRITESYM);
         adv();
-        printNode("LPAREN '('");
+        sym(Tok::LPAREN);
         expect(Tok::LPAREN);
-        expression();
-        printNode("RPAREN ')'");
+        expression(follow | toks(Tok::RPAREN));
+        sym(Tok::RPAREN);
         expect(Tok::RPAREN);
-        indent_level--;
+        close();
     }
     /* 空语句允许 —— 什么都不做 */
-    indent_level--;
+    test(follow, 0, "语句后出现非法符号");
+    close();
 }
 
 /**
  * @brief 
  * 条件=ODD<表达式>|<表达式><比较运算符><表达式>
+ * @param follow 
  */
-void Parser::condition()
+void Parser::condition(TokSet follow)
 {
-    printNode("Condition");
-    indent_level++;
+    PL0_ZONE(Zone::CONDITION);
+    open(NodeKind::CONDITION);
 
     if (is(Tok::ODDSYM)) {
-        printNode("ODD");
+        sym(Tok::ODDSYM);
         adv();
-        expression();
+        expression(follow);
     } else {
-        expression();
-        if (is(Tok::EQL)||is(Tok::NEQ)||is(Tok::LSS)||is(Tok::LEQ)||is(Tok::GTR)||is(Tok::GEQ)) {
-            printNode("CompareOp: " + cur().lex);
+        expression(follow | REL_OPS);
+        if (in(REL_OPS)) {
+            leaf(NodeKind::COMPARE_OP);
             adv();
         } else {
             err("比较运算符缺失");
         }
-        expression();
+        expression(follow);
     }
 
-    indent_level--;
+    close();
 }
 
 /**
  * @brief 
  * 表达式=[+ | -]<项>{<加法运算符><项>}
+ * @param follow 
  */
-void Parser::expression()
+void Parser::expression(TokSet follow)
 {
-    printNode("Expression");
-    indent_level++;
+    if (Stack::low()) return Stack::run([&] { expression(follow); });
+    PL0_ZONE(Zone::EXPRESSION);
+    open(NodeKind::EXPRESSION);
     // 检查第一个合法的项是否存在
-    if (!(is(Tok::PLUS) || is(Tok::MINUS) || is(Tok::IDENT) || is(Tok::NUMBER) || is(Tok::LPAREN)))
+    if (!in(FACTOR_BEGIN | toks(Tok::PLUS, Tok::MINUS)))
         err("表达式应以标识符、数字或 '(' 开始");
 
+    TokSet termFollow = follow | toks(Tok::PLUS, Tok::MINUS);
     if(is(Tok::PLUS)||is(Tok::MINUS)) {
-        printNode("UnaryOp:"+cur().lex);
+        leaf(NodeKind::UNARY_OP);
         adv();
     }
-    term();
+    term(termFollow);
     while (is(Tok::PLUS) || is(Tok::MINUS)) {
-        printNode("BinaryOp: " + cur().lex);
+        leaf(NodeKind::BINARY_OP);
         adv();
-        term();
+        term(termFollow);
     }
-    indent_level--;
+    close();
 }
 
 /**
  * @brief 
  * 项=<因子>{<乘法运算符><因子>}
+ * @param follow 
  */
-void Parser::term()
+void Parser::term(TokSet follow)
 {
-    printNode("Term");
-    indent_level++;
+    PL0_ZONE(Zone::TERM);
+    open(NodeKind::TERM);
 
-    factor();
+    TokSet factorFollow = follow | toks(Tok::TIMES, Tok::SLASH);
+    factor(factorFollow);
     while(is(Tok::TIMES)||is(Tok::SLASH)) {
-        printNode("BinaryOp: " + cur().lex);
+        leaf(NodeKind::BINARY_OP);
         adv(); 
-        factor();
+        factor(factorFollow);
     }
 
-    indent_level--;
+    close();
 }
 
 /**
  * @brief 
  * 因子=<标识符>|<无符号整数>|(<表达式>)
+ * 不以因子开头时报错并跳到因子开头或 follow；因子之后的记号不在 follow 中时同样跳过
+ * @param follow 
  */
-void Parser::factor()
+void Parser::factor(TokSet follow)
 {
-    printNode("Factor");
-    indent_level++;
+    PL0_ZONE(Zone::FACTOR);
+    open(NodeKind::FACTOR);
 
+    test(FACTOR_BEGIN, follow, "非法因子");
     if (is(Tok::IDENT)) {
-        printNode("IDENT: " + cur().lex);
+        checkIdent(CONST_OR_VAR, 21);
+        leaf(NodeKind::IDENT);
         adv();
     } 
     else if (is(Tok::NUMBER)) {
-        printNode("NUMBER: " + cur().lex);
+        leaf(NodeKind::NUMBER);
         adv();
     } 
     else if (is(Tok::LPAREN)) {
-        printNode("(");
-        adv();
-        expression();
-        if(!is(Tok::RPAREN)) err("')' 缺失");
-        printNode(")");
+        paren(Tok::LPAREN);
         adv();
+        expression(follow | toks(Tok::RPAREN));
+        paren(Tok::RPAREN);
+        if(is(Tok::RPAREN)) adv(); else err("')' 缺失");
     } 
-    else {
-        err("非法因子");
+    test(follow, 0, "因子后出现非法符号");
+
+    close();
+}
+
+/* ------------ 增量分析 ------------ */
+
+/**
+ * @brief 
+ * 按树重放块中 stop 之前的声明，与分析时登记的顺序、内容相同（含出错后恢复得到的声明）
+ * @param block BLOCK 结点
+ * @param stop 到此为止（不含），NIL 表示全部
+ */
+void Parser::replayDecls(uint32_t block, uint32_t stop)
+{
+    for (uint32_t c = ast[block].first; c != stop && c != Ast::NIL; c = ast[c].next) {
+        const Node& n = ast[c];
+        if (n.kind == NodeKind::CONST_DECL) {
+            // IDENT '=' NUMBER，缺少常数的定义分析时没有登记
+            uint32_t name = Ast::NIL;
+            for (uint32_t k = n.first; k != Ast::NIL; k = ast[k].next) {
+                const Node& x = ast[k];
+                if (x.kind == NodeKind::IDENT) name = ast.atom(x);
+                else if (x.kind == NodeKind::NUMBER && name != Ast::NIL) {
+                    enterSymbol(name, Symbol::Type::CONST, ast.number(x));
+                    name = Ast::NIL;
+                } else if (x.kind == NodeKind::SYMBOL && x.tok != Tok::EQL) name = Ast::NIL;
+            }
+        } else if (n.kind == NodeKind::VAR_DECL) {
+            for (uint32_t k = n.first; k != Ast::NIL; k = ast[k].next)
+                if (ast[k].kind == NodeKind::IDENT) enterSymbol(ast.atom(ast[k]), Symbol::Type::VAR);
+        } else if (n.kind == NodeKind::PROC_DECL) {
+            uint32_t name = ast.child(c, 1);
+            if (name != Ast::NIL && ast[name].kind == NodeKind::IDENT)
+                enterSymbol(ast.atom(ast[name]), Symbol::Type::PROCEDURE);
+        }
     }
+}
 
-    indent_level--;
-}
\ No newline at end of file
+/**
+ * @brief 
+ * 重新分析一个单位。沿路径算出该处的 follow 集与可见的符号，与整篇分析走到这里时相同，
+ * 再调用 statement() 或 procDecl() 建出新的子树；一串子结点按复合语句中的循环分析
+ * @param unit 
+ * @param from 从单位的首记号开始的记号
+ * @param repl 新子树的根
+ * @return true 已换入
+ */
+bool Parser::reparse(const ReparseUnit& unit, TokenSource& from, uint32_t& repl)
+{
+    PL0_ZONE(Zone::PARSE);
+    const std::vector<uint32_t>& p = unit.path;
+    uint32_t target = p.back();
+    bool isProc = ast[target].kind == NodeKind::PROC_DECL;
+
+    std::vector<uint32_t> key;
+    for (uint32_t id : p)
+        if (ast[id].kind == NodeKind::BLOCK) key.push_back(id);
+    bool replay = isProc || key != scopeKey;
+    if (replay) symbols.clear();
+
+    TokSet follow = PROGRAM_FOLLOW;
+    for (size_t k = 1; k + 1 < p.size(); ++k) {
+        uint32_t id = p[k], next = p[k + 1];
+        switch (ast[id].kind) {
+        case NodeKind::BLOCK:
+            if (replay) replayDecls(id, next);
+            break;
+        case NodeKind::PROC_DECL:       // 进入其块：过程名登记在外层
+            if (replay) {
+                uint32_t name = ast.child(id, 1);
+                if (name != Ast::NIL && ast[name].kind == NodeKind::IDENT)
+                    enterSymbol(ast.atom(ast[name]), Symbol::Type::PROCEDURE);
+                symbols.enterScope();
+            }
+            follow |= DECL_BEGIN | STMT_BEGIN | toks(Tok::IDENT, Tok::SEMICOLON);
+            break;
+        case NodeKind::COMPOUND:
+            follow |= STMT_BEGIN | toks(Tok::IDENT, Tok::SEMICOLON, Tok::ENDSYM);
+            break;
+        case NodeKind::IF:
+            if (next == ast.child(id, 3)) follow |= toks(Tok::ELSESYM);
+            break;
+        default:
+            break;
+        }
+    }
+    // 过程声明会改动符号表，之后须重放
+    if (isProc) scopeKey.clear();
+    else scopeKey.swap(key);
+
+    src = &from;
+    look = Token();
+    path.clear();
+    diags.clear();
+    errorCount = syntaxErrorCount = 0;
+    errorRecoveryMode = false;
+    adv();
+    // 首记号须使外层走到同一处：块中的过程声明以 procedure 开头，块末的语句前不是声明，
+    // 复合语句中缺少 ';' 时靠下一条语句的开头继续，一串子结点以 ';' 开头时须仍是 ';'
+    uint32_t parent = p[p.size() - 2];
+    bool run = unit.last != Ast::NIL;
+    bool runSemi = run && ast[target].kind == NodeKind::SYMBOL;
+    if (isProc ? !is(Tok::PROCEDURESYM)
+        : run ? runSemi && !is(Tok::SEMICOLON)
+        : ast[parent].kind == NodeKind::BLOCK ? !in(STMT_BEGIN | toks(Tok::IDENT) | follow) || in(DECL_BEGIN)
+        : unit.mustStart && !in(STMT_BEGIN | toks(Tok::IDENT)))
+        return false;
+
+    // 新建的结点挂在一个不接入树的结点下，成功后再换入
+    uint32_t holder = attach(ast[parent].kind, cur());
+    path.push_back(Open{ holder, Ast::NIL });
+    if (isProc) {
+        procDecl(follow);
+    } else if (!run) {
+        statement(follow);
+    } else {
+        // 复合语句中的循环，走到原来的下一个子结点处为止
+        if (!runSemi) statement(follow);
+        while (cur().off < unit.end && (is(Tok::SEMICOLON) || in(STMT_BEGIN | toks(Tok::IDENT)))) {
+            sym(Tok::SEMICOLON);
+            if (is(Tok::SEMICOLON)) adv();
+            else err("语句之间缺少 ';'");
+            statement(follow);
+        }
+    }
+    repl = ast[holder].first;
+    uint32_t last = path.back().last;
+    path.clear();
+
+    // 单位末尾仍在恢复模式也可以：外层在这个记号上本来就没有报错（否则 Document 不会选这个单位），
+    // 恢复模式只压下外层的报错，不改变分析的走向
+    if (is(Tok::END) || cur().off != unit.end || cur().kind != unit.endKind) return false;
+    if (isProc) {
+        uint32_t was = ast.child(target, 1), now = ast.child(repl, 1);
+        if (was == Ast::NIL || now == Ast::NIL || ast.atom(ast[was]) != ast.atom(ast[now])) return false;
+    }
+    ast.splice(parent, unit.prev, run ? unit.last : target, repl, last);
+    return true;
+}
@@ -4,117 +4,132 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
+#include <ostream>
 
-/* 传进来的 token = (type, lexeme) */
-struct RawToken {
-    std::string type;   /* 如 "constsym" / "plus" / "ident" ... */
-    std::string lexeme; /* 对应词素               */
-};
+#include "../lexier/token.h"
+#include "../lexier/tokfile.h"
+#include "ast.h"
+#include "symtab.h"
 
-/* 枚举化后方便 switch */
-enum class Tok {
-    /* 关键字 */
-    BEGINSYM, ENDSYM,
-    CONSTSYM, VARSYM, PROCEDURESYM, CALLSYM,
-    IFSYM, ELSESYM, THENSYM, WHILESYM, DOSYM, ODDSYM,
-    READSYM, WRITESYM,
-    /* 标识符 / 常数 */
-    IDENT, NUMBER,
-    /* 运算符与界符 */
-    PLUS, MINUS, TIMES, SLASH,
-    EQL, NEQ, LSS, LEQ, GTR, GEQ,
-    BECOMES,
-    LPAREN, RPAREN, COMMA, SEMICOLON, PERIOD,
-    END       // 虚拟 EOF
-};
+/* 记号种类的集合，作错误恢复的 FIRST / FOLLOW 同步集，第 k 位对应种类码 k */
+typedef uint64_t TokSet;
+inline constexpr TokSet toks() { return 0; }
+template <class... Rest>
+inline constexpr TokSet toks(Tok t, Rest... rest) { return (TokSet(1) << static_cast<int>(t)) | toks(rest...); }
 
-// 符号表项结构，用于语义检查
-struct Symbol {
-    enum class Type { CONST, VAR, PROCEDURE };
-    std::string name;  // 符号名称
-    Type type;         // 符号类型
-    int value;         // 常量值（如果是常量）
-    int level;         // 嵌套层级
+/**
+ * @brief 一条诊断
+ * 语法错误与语义错误按出现的先后收集，分析结束后由 writeDiagnostics() 统一输出；
+ * 位置取报告时的当前记号，line 为 0 表示位置未知（空输入）。
+ */
+struct Diagnostic {
+    bool syntax;            // 语法错误；否则为语义错误
+    int line, col;
+    std::string message;    // 不含位置
+    // 语法错误：该记号上最后一次报错（含恢复模式下压下的）时正在构造的最内层结点，
+    // 增量分析据此判断单位之后那个记号上的错误是否来自单位内部
+    uint32_t node;
+};
 
-    Symbol(const std::string& n, Type t, int l, int v = 0)
-        : name(n), type(t), level(l), value(v) {}
+/**
+ * @brief 增量分析中重新分析的单位：语法树中的一条语句（STATEMENT）、一个过程声明（PROC_DECL），
+ * 或复合语句中相连的一串子结点（以 ';' 或 begin 后的首条语句开头、以语句结尾）
+ * 由 Document 在上一次的树上找出，见 incremental.h。
+ */
+struct ReparseUnit {
+    std::vector<uint32_t> path;     // 从根到该单位的结点，末尾即单位本身（一串时为其首个结点）
+    uint32_t last = Ast::NIL;       // 一串子结点的末个，单个单位时为 NIL
+    uint32_t prev = Ast::NIL;       // 单位的前一个兄弟，没有时为 NIL
+    uint32_t end = 0;               // 单位之后第一个记号在源程序中的偏移（按编辑后的文本）
+    Tok endKind = Tok::END;         // 该记号的种类
+    bool mustStart = false;         // 复合语句中前面缺少 ';' 的语句：首记号须仍能开始一条语句
 };
 
 class Parser {
 public:
-    explicit Parser(const std::vector<RawToken>& raw); /* 构造时完成映射 */
-    void parse();                                      /* 主入口         */
-    int getErrorCount() const { return errorCount; }   /* 获取错误计数   */
+    explicit Parser(TokenSource& src);                 /* 按需从 src 拉取记号 */
+    Parser();                                          /* 不带记号来源，须用 parse(from) 分析 */
+    const Ast& parse();                                /* 主入口，返回语法树；有语法错误时为恢复后的树 */
+    const Ast& parse(TokenSource& from);               /* 改从 from 取记号，整篇重新分析 */
+    /*
+     * 在上一次分析得到的树上重新分析一个单位：from 从单位的首记号开始给出记号，
+     * 分析完后下一个记号须恰好从 unit.end 开始、种类为 unit.endKind，
+     * 过程声明还须保持过程名不变；满足时把新子树换入树中（新根为 repl，一串时为新串的首个结点）并返回 true，
+     * diagnostics() 只含该单位内的诊断。不满足时树不变，调用方应改为分析更大的单位。
+     */
+    bool reparse(const ReparseUnit& unit, TokenSource& from, uint32_t& repl);
+    int getErrorCount() const { return errorCount; }   /* 语法与语义错误的总数 */
+    int getSyntaxErrorCount() const { return syntaxErrorCount; }
+    const std::vector<Diagnostic>& diagnostics() const { return diags; }
+    /* 上一次分析得到的树；可改写的版本供增量分析平移结点位置 */
+    const Ast& tree() const { return ast; }
+    Ast& tree() { return ast; }
+    /* 每条诊断一行：消息，再加 " at Line L, Col C" */
+    void writeDiagnostics(std::ostream& out) const;
+    /*
+     * 流式分析：parse() 每建好一个结点就交给 stream，叶子随即、非终结符在其子结点分析完后即从树中删去，
+     * 树中只留从根到当前位置的一条路径，内存随嵌套深度而不随程序长度增长。
+     * 分析结束后 tree() 为空，诊断中的 node 不再有意义，也不能再 reparse()。为 nullptr 时恢复建整棵树
+     */
+    void setStream(TreeStream* s) { stream = s; }
 private:
     /* 内部实现隐藏 */
-    struct Token { Tok t; std::string lex; };
-    std::vector<Token> toks;
-    size_t pos = 0;
-    bool errorRecoveryMode = false;  // 错误恢复模式标记
+    /* 文法只需向前看一个记号，因此只保留当前记号 */
+    TokenSource* src;
+    Token look = Token();
+    uint32_t lookAtom = Interner::NONE;     // 当前记号的原子编号，未查时为 NONE
+    bool errorRecoveryMode = false;  // 报过语法错误且尚未消耗记号：此间的语法错误不再报告
+    size_t recoveryDiag = 0;         // 进入恢复模式的那条诊断
     int errorCount = 0;              // 错误计数器
+    int syntaxErrorCount = 0;
+    std::vector<Diagnostic> diags;
 
-    // 符号表及相关
-    std::vector<Symbol> symbolTable;
-    int currentLevel = 0;
+    // 语法树及当前所在的结点路径（根在前），每层记下其末个子结点以便追加
+    struct Open { uint32_t id, last; };
+    Ast ast;
+    std::vector<Open> path;
+    TreeStream* stream = nullptr;
+    uint32_t streamed = 0;          // 流式分析已交出的结点数，即下一个结点的先序编号
+
+    // 符号表，层级即 symbols.level()
+    SymbolTable symbols;
+    // 符号表当前对应的作用域：重新分析语句时，路径上的 BLOCK 与上次相同就不必重放声明
+    std::vector<uint32_t> scopeKey;
 
     /* 小工具 */
     Token& cur();     bool is(Tok);  void adv();
-    void err(const std::string&);
-    void reportError(const std::string& message);  // 报告错误但不退出
-    void errorRecovery(const std::vector<Tok>& syncTokens);  // 错误恢复
+    bool in(TokSet s);  /* 当前记号是否属于 s */
+    std::string lex();  /* 当前记号的词素 */
+    void err(const std::string&);                   // 报告语法错误，不跳过记号
+    void reportError(const std::string& message, bool syntax = false);  // 记下一条诊断
+    void errorRecovery(TokSet sync);                // 跳过记号直到 sync 中的一个或 EOF
+    void test(TokSet expected, TokSet stop, const std::string& m);
+
+    // 建树
+    uint32_t attach(NodeKind k, const Token& at, Lexeme text = Lexeme{ "", 0 });
+    void emit(uint32_t id);     // 流式分析时交出刚建好的结点
+    void open(NodeKind k);  void close();
+    void leaf(NodeKind k);  void sym(Tok t);  void paren(Tok t);
     
-    // 符号表操作
-    void enterSymbol(const std::string& name, Symbol::Type type, int value = 0);
-    bool symbolExists(const std::string& name, int level = -1);
-    Symbol* findSymbol(const std::string& name);
+    // 符号表操作与语义检查
+    uint32_t atom();    /* 当前标识符的原子编号，每个记号只查一次原子表 */
+    void enterSymbol(uint32_t name, Symbol::Type type, int64_t value = 0);
+    Symbol* findSymbol(uint32_t name);
+    void checkIdent(unsigned allowed, int bad);     // 检查当前标识符的种类
+    void semanticError(int n);                      // 报告 err_msg 中的第 n 号错误
+    void replayDecls(uint32_t block, uint32_t stop);  // 按树登记 block 中 stop 之前的声明
 
-    /* 文法函数 */
-    void program();  void block();
-    void constDecl(); void varDecl();
-    void statement(); void condition();
-    void expression(); void term(); void factor();
+    /* 文法函数；follow 为调用处允许紧随其后的记号，出错时跳到其中之一 */
+    void program();  void block(TokSet follow);
+    void constDecl(TokSet follow); void varDecl(TokSet follow);
+    void constDef(const char* missing, TokSet follow);
+    void procDecl(TokSet follow);
+    void statement(TokSet follow); void condition(TokSet follow);
+    void expression(TokSet follow); void term(TokSet follow); void factor(TokSet follow);
+    void endDecl(TokSet follow);   /* 声明末尾的 ';' */
 
     void expect(Tok t);
 };
 
-static std::string tokToString(Tok t)
-{
-    switch (t) {
-        case Tok::BEGINSYM: return "begin";
-        case Tok::ENDSYM: return "end";
-        case Tok::CONSTSYM: return "const";
-        case Tok::VARSYM: return "var";
-        case Tok::PROCEDURESYM: return "procedure";
-        case Tok::CALLSYM: return "call";
-        case Tok::IFSYM: return "if";
-        case Tok::ELSESYM: return "else";
-        case Tok::THENSYM: return "then";
-        case Tok::WHILESYM: return "while";
-        case Tok::DOSYM: return "do";
-        case Tok::ODDSYM: return "odd";
-        case Tok::READSYM: return "read";
-        case Tok::WRITESYM: return "write";
-        case Tok::IDENT: return "标识符";
-        case Tok::NUMBER: return "常数";
-        case Tok::PLUS: return "+";
-        case Tok::MINUS: return "-";
-        case Tok::TIMES: return "*";
-        case Tok::SLASH: return "/";
-        case Tok::EQL: return "=";
-        case Tok::NEQ: return "<>";
-        case Tok::LSS: return "<";
-        case Tok::LEQ: return "<=";
-        case Tok::GTR: return ">";
-        case Tok::GEQ: return ">=";
-        case Tok::BECOMES: return ":=";
-        case Tok::LPAREN: return "(";
-        case Tok::RPAREN: return ")";
-        case Tok::COMMA: return ",";
-        case Tok::SEMICOLON: return ";";
-        case Tok::PERIOD: return ".";
-        case Tok::END: return "<EOF>";
-        default: return "<未知符号>";
-    }
-}
-
 #endif
\ No newline at end of file
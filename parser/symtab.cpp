@@ -0,0 +1,51 @@
+#include "symtab.h"
+
+/**
+ * @brief
+ * 清空符号表，只留最外层
+ */
+void SymbolTable::clear()
+{
+    syms.clear();
+    marks.assign(1, 0);
+    top.clear();
+}
+
+/**
+ * @brief
+ * 进入新的一层作用域
+ */
+void SymbolTable::enterScope()
+{
+    marks.push_back(syms.size());
+}
+
+/**
+ * @brief
+ * 弹出最内层的全部符号，各名字恢复为被遮住的外层符号；最外层不弹出
+ */
+void SymbolTable::leaveScope()
+{
+    if (marks.size() <= 1) return;
+    size_t base = marks.back();
+    marks.pop_back();
+    while (syms.size() > base) {
+        const Symbol& s = syms.back();
+        top[s.atom] = s.shadow;
+        syms.pop_back();
+    }
+}
+
+/**
+ * @brief
+ * 在当前层声明符号
+ */
+Symbol& SymbolTable::declare(uint32_t atom, Symbol::Type type, int64_t value)
+{
+    if (atom >= top.size()) top.resize(atom + 1 > top.size() * 2 ? atom + 1 : top.size() * 2, -1);
+    syms.push_back(Symbol(atom, type, level(), value));
+    Symbol& sym = syms.back();
+    sym.shadow = top[atom];
+    top[atom] = static_cast<int>(syms.size() - 1);
+    return sym;
+}
@@ -0,0 +1,64 @@
+#ifndef PL0_SYMTAB_H
+#define PL0_SYMTAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 符号表项结构，用于语义检查
+struct Symbol {
+    enum class Type { CONST, VAR, PROCEDURE };
+    uint32_t atom;     // 符号名称在原子表中的编号，名字见 Interner::name()
+    Type type;         // 符号类型
+    int64_t value;     // 常量值（如果是常量），变量为地址，过程为入口
+    int level;         // 嵌套层级
+    int shadow;        // 被它遮住的外层同名符号，没有为 -1
+
+    Symbol(uint32_t a, Type t, int l, int64_t v = 0)
+        : atom(a), type(t), value(v), level(l), shadow(-1) {}
+};
+
+/**
+ * @brief 按作用域嵌套的符号表
+ * 名字以原子编号表示（见 ../lexier/intern.h），编号从 0 起连续，
+ * 因此不需要自己的散列表：top[原子] 直接记着该名字当前可见的最内层符号。
+ * 符号按声明顺序压栈，每进入一层过程记下栈高，离开时整层弹出；
+ * 符号自己记着被它遮住的外层同名符号，弹出时把 top 恢复过去。于是
+ *   查找   一次数组下标，O(1)，不比较也不散列字符串
+ *   声明   O(1)：新符号接在栈顶，top 指向它
+ *   出作用域 与该层符号数成正比
+ */
+class SymbolTable {
+public:
+    SymbolTable() { clear(); }
+
+    void enterScope();                  /* 进入新的一层 */
+    void leaveScope();                  /* 弹出最内层的全部符号 */
+    int level() const { return static_cast<int>(marks.size()) - 1; }
+
+    /* 在当前层声明符号，返回新符号 */
+    Symbol& declare(uint32_t atom, Symbol::Type type, int64_t value = 0);
+    /* 最内层可见的同名符号，没有返回 nullptr */
+    Symbol* find(uint32_t atom)
+    {
+        int k = atom < top.size() ? top[atom] : -1;
+        return k < 0 ? nullptr : &syms[k];
+    }
+    /* 当前层是否已声明过该名字 */
+    bool declaredHere(uint32_t atom)
+    {
+        Symbol* s = find(atom);
+        return s && s->level == level();
+    }
+
+    size_t size() const { return syms.size(); }
+    const Symbol& operator[](size_t k) const { return syms[k]; }
+    void clear();
+
+private:
+    std::vector<Symbol> syms;
+    std::vector<size_t> marks;          // 各层开始时的栈高，marks[0] 为最外层
+    std::vector<int> top;               // 原子 -> 当前可见的最内层符号，没有为 -1
+};
+
+#endif
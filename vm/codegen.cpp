@@ -0,0 +1,240 @@
+#include "codegen.h"
+
+#include "../lexier/stack.h"
+
+/**
+ * @brief
+ * 为整棵树生成代码
+ */
+const Program& CodeGen::generate(const Ast& tree)
+{
+    ast = &tree;
+    prog.code.clear();
+    prog.maxTemp = 0;
+    symbols.clear();
+    depth = 0;
+    if (!tree.empty()) block(tree.child(tree.root(), 0), true);
+    linkCalls();
+    return prog;
+}
+
+/**
+ * @brief
+ * 追加一条指令，同时记下表达式栈的深度变化
+ */
+int CodeGen::emit(Op op, int l, int64_t a)
+{
+    depth += stackEffect(op, a);
+    if (depth > prog.maxTemp) prog.maxTemp = depth;
+    prog.code.push_back(Instr{ op, static_cast<uint8_t>(l), a });
+    return here() - 1;
+}
+
+/**
+ * @brief
+ * 分程序=[常量声明][变量声明]{过程声明}<语句>
+ */
+void CodeGen::block(uint32_t id, bool main)
+{
+    if (Stack::low()) return Stack::run([&] { block(id, main); });
+    int jump = -1;
+    int vars = 0;
+    for (uint32_t c = node(id).first; c != Ast::NIL; c = node(c).next) {
+        const Node& n = node(c);
+        if (n.kind == NodeKind::CONST_DECL) {
+            uint32_t name = Ast::NIL;
+            for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next) {
+                const Node& leaf = node(k);
+                if (leaf.kind == NodeKind::IDENT) name = ast->atom(leaf);
+                else if (leaf.kind == NodeKind::NUMBER)
+                    symbols.declare(name, Symbol::Type::CONST, ast->number(leaf));
+            }
+        } else if (n.kind == NodeKind::VAR_DECL) {
+            for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next)
+                if (node(k).kind == NodeKind::IDENT)
+                    symbols.declare(ast->atom(node(k)), Symbol::Type::VAR, FRAME_HEADER + vars++);
+        } else if (n.kind == NodeKind::PROC_DECL) {
+            if (jump < 0) jump = emit(Op::JMP, 0, 0);
+            // 过程名属于外层；入口记为其分程序开头，若那里是 JMP，由 linkCalls() 改正
+            symbols.declare(ast->atom(node(ast->child(c, 1))), Symbol::Type::PROCEDURE, here());
+            symbols.enterScope();
+            block(ast->child(c, 3), false);
+            symbols.leaveScope();
+        } else if (n.kind == NodeKind::STATEMENT) {
+            if (jump >= 0) prog.code[jump].a = here();
+            emit(Op::INT, 0, FRAME_HEADER + vars);
+            statement(c);
+        }
+    }
+    if (main) emit(Op::HLT, 0, 0);
+    else emit(Op::OPR, 0, OPR_RET);
+}
+
+/**
+ * @brief
+ * 语句=<赋值语句>|<条件语句>|<当循环语句>|<过程调用语句>|<复合语句>|<读语句>|<写语句>|<空>
+ */
+void CodeGen::statement(uint32_t id)
+{
+    if (Stack::low()) return Stack::run([&] { statement(id); });
+    uint32_t s = node(id).first;
+    if (s == Ast::NIL) return;          // 空语句
+    const Node& n = node(s);
+    switch (n.kind) {
+    case NodeKind::ASSIGN:
+        expression(ast->child(s, 2));
+        store(Op::STO, ast->child(s, 0));
+        break;
+    case NodeKind::CALL: {
+        const Symbol* p = symbols.find(ast->atom(node(ast->child(s, 1))));
+        emit(Op::CAL, symbols.level() - p->level, p->value);
+        break;
+    }
+    case NodeKind::COMPOUND:
+        for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next)
+            if (node(k).kind == NodeKind::STATEMENT) statement(k);
+        break;
+    case NodeKind::IF: {
+        condition(ast->child(s, 1));
+        int jpc = emit(Op::JPC, 0, 0);
+        statement(ast->child(s, 3));
+        uint32_t otherwise = ast->child(s, 5);
+        if (otherwise == Ast::NIL) {
+            prog.code[jpc].a = here();
+        } else {
+            int jmp = emit(Op::JMP, 0, 0);
+            prog.code[jpc].a = here();
+            statement(otherwise);
+            prog.code[jmp].a = here();
+        }
+        break;
+    }
+    case NodeKind::WHILE: {
+        int top = here();
+        condition(ast->child(s, 1));
+        int jpc = emit(Op::JPC, 0, 0);
+        statement(ast->child(s, 3));
+        emit(Op::JMP, 0, top);
+        prog.code[jpc].a = here();
+        break;
+    }
+    case NodeKind::READ:
+        store(Op::RED, ast->child(s, 2));
+        break;
+    case NodeKind::WRITE:
+        expression(ast->child(s, 2));
+        emit(Op::WRT, 0, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief
+ * 条件=ODD<表达式>|<表达式><比较运算符><表达式>
+ */
+void CodeGen::condition(uint32_t id)
+{
+    uint32_t first = node(id).first;
+    if (node(first).kind == NodeKind::SYMBOL) {     // odd
+        expression(node(first).next);
+        emit(Op::OPR, 0, OPR_ODD);
+        return;
+    }
+    uint32_t op = node(first).next;
+    expression(first);
+    expression(node(op).next);
+    int opr = OPR_EQL;
+    switch (node(op).tok) {
+    case Tok::EQL: opr = OPR_EQL; break;
+    case Tok::NEQ: opr = OPR_NEQ; break;
+    case Tok::LSS: opr = OPR_LSS; break;
+    case Tok::GEQ: opr = OPR_GEQ; break;
+    case Tok::GTR: opr = OPR_GTR; break;
+    case Tok::LEQ: opr = OPR_LEQ; break;
+    default: break;
+    }
+    emit(Op::OPR, 0, opr);
+}
+
+/**
+ * @brief
+ * 表达式=[+|-]<项>{<加法运算符><项>}
+ */
+void CodeGen::expression(uint32_t id)
+{
+    if (Stack::low()) return Stack::run([&] { expression(id); });
+    uint32_t k = node(id).first;
+    bool negate = false;
+    if (node(k).kind == NodeKind::UNARY_OP) {
+        negate = node(k).tok == Tok::MINUS;
+        k = node(k).next;
+    }
+    term(k);
+    if (negate) emit(Op::OPR, 0, OPR_NEG);
+    for (k = node(k).next; k != Ast::NIL; k = node(node(k).next).next) {
+        Tok op = node(k).tok;
+        term(node(k).next);
+        emit(Op::OPR, 0, op == Tok::PLUS ? OPR_ADD : OPR_SUB);
+    }
+}
+
+/**
+ * @brief
+ * 项=<因子>{<乘法运算符><因子>}
+ */
+void CodeGen::term(uint32_t id)
+{
+    uint32_t k = node(id).first;
+    factor(k);
+    for (k = node(k).next; k != Ast::NIL; k = node(node(k).next).next) {
+        Tok op = node(k).tok;
+        factor(node(k).next);
+        emit(Op::OPR, 0, op == Tok::TIMES ? OPR_MUL : OPR_DIV);
+    }
+}
+
+/**
+ * @brief
+ * 因子=<标识符>|<无符号整数>|(<表达式>)
+ */
+void CodeGen::factor(uint32_t id)
+{
+    uint32_t k = node(id).first;
+    const Node& n = node(k);
+    if (n.kind == NodeKind::IDENT) load(k);
+    else if (n.kind == NodeKind::NUMBER) emit(Op::LIT, 0, ast->number(n));
+    else expression(n.next);            // 括号
+}
+
+/**
+ * @brief
+ * 标识符取值：常量为 LIT，变量为 LOD
+ */
+void CodeGen::load(uint32_t ident)
+{
+    const Symbol* s = symbols.find(ast->atom(node(ident)));
+    if (s->type == Symbol::Type::CONST) emit(Op::LIT, 0, s->value);
+    else emit(Op::LOD, symbols.level() - s->level, s->value);
+}
+
+/**
+ * @brief
+ * 存入变量：赋值为 STO，读语句为 RED
+ */
+void CodeGen::store(Op op, uint32_t ident)
+{
+    const Symbol* s = symbols.find(ast->atom(node(ident)));
+    emit(op, symbols.level() - s->level, s->value);
+}
+
+/**
+ * @brief
+ * 指向分程序开头 JMP 的调用直接改到入口，省去每次调用多执行的一条跳转
+ */
+void CodeGen::linkCalls()
+{
+    for (Instr& in : prog.code)
+        if (in.op == Op::CAL && prog.code[in.a].op == Op::JMP) in.a = prog.code[in.a].a;
+}
@@ -0,0 +1,57 @@
+#ifndef PL0_CODEGEN_H
+#define PL0_CODEGEN_H
+
+#include <cstdint>
+
+#include "../parser/ast.h"
+#include "../parser/symtab.h"
+#include "pcode.h"
+
+/**
+ * @brief P-code 生成器
+ * 在 Parser 建好的语法树上一趟生成经典 PL/0 的 P-code，名字解析与 Parser 一致：
+ * 用同样的顺序声明、同样按作用域嵌套的符号表，因此只应对没有语义错误的树调用。
+ * 符号表项的 value 在这里另作他用：常量为其值，变量为其在活动记录中的地址，
+ * 过程为其分程序的第一条指令。
+ *
+ * 分程序的代码为
+ *   [JMP 入口]      有内层过程时跳过它们的代码
+ *   内层过程 ...
+ *   入口: INT 0, 3+变量数
+ *   语句
+ *   OPR 0, 0        主程序为 HLT
+ * 调用在生成过程体时可能还不知道入口（递归调用），先指向分程序开头的 JMP，
+ * 全部生成后再把这类 CAL 直接改到入口。
+ */
+class CodeGen {
+public:
+    CodeGen() {}
+
+    /* 为整棵树生成代码 */
+    const Program& generate(const Ast& ast);
+
+private:
+    CodeGen(const CodeGen&);            // 不可拷贝
+    CodeGen& operator=(const CodeGen&);
+
+    const Ast* ast = nullptr;
+    Program prog;
+    SymbolTable symbols;
+    int depth = 0;                      // 当前表达式栈上的临时单元数
+
+    int emit(Op op, int l, int64_t a);      // 追加一条指令，返回其地址
+    int here() const { return static_cast<int>(prog.code.size()); }
+    const Node& node(uint32_t id) const { return (*ast)[id]; }
+
+    void block(uint32_t id, bool main);
+    void statement(uint32_t id);
+    void condition(uint32_t id);
+    void expression(uint32_t id);
+    void term(uint32_t id);
+    void factor(uint32_t id);
+    void load(uint32_t ident);
+    void store(Op op, uint32_t ident);  // STO 或 RED
+    void linkCalls();
+};
+
+#endif
@@ -0,0 +1,450 @@
+#include "ir.h"
+
+#include "../lexier/stack.h"
+#include "../parser/symtab.h"
+
+namespace {
+
+/**
+ * @brief 由语法树生成中间表示
+ * 名字解析与 CodeGen 相同；符号表项的 value 对过程为其在 IrProgram::procs 中的下标。
+ * 注意 procs、blocks 在生成内层过程、新建基本块时会扩容，不能跨这些操作持有其元素的引用。
+ */
+class Lowering {
+public:
+    Lowering(const Ast& a, IrProgram& p) : ast(a), ir(p) {}
+
+    void program()
+    {
+        ir.procs.clear();
+        if (ast.empty()) return;
+        newProc(Interner::NONE, -1, 0);
+        enter(newBlock());
+        block(ast.child(ast.root(), 0));
+        leave(IrBlock::RETURN);
+    }
+
+private:
+    const Ast& ast;
+    IrProgram& ir;
+    SymbolTable symbols;
+    int proc = 0;               // 当前过程
+    int32_t cur = -1;           // 当前基本块
+
+    const Node& node(uint32_t id) const { return ast[id]; }
+    IrProc& current() { return ir.procs[proc]; }
+
+    int newProc(uint32_t name, int parent, int level)
+    {
+        ir.procs.push_back(IrProc());
+        IrProc& p = ir.procs.back();
+        p.name = name;
+        p.level = level;
+        p.parent = parent;
+        return static_cast<int>(ir.procs.size() - 1);
+    }
+    int32_t newBlock()
+    {
+        current().blocks.push_back(IrBlock());
+        return static_cast<int32_t>(current().blocks.size() - 1);
+    }
+    /* 开始往块 b 里放语句，b 按此顺序排放 */
+    void enter(int32_t b)
+    {
+        cur = b;
+        current().order.push_back(b);
+    }
+    /* 结束当前块 */
+    void leave(IrBlock::Exit exit, int32_t next = -1, int32_t cond = -1, int32_t other = -1)
+    {
+        IrBlock& b = current().blocks[cur];
+        b.exit = exit;
+        b.next = next;
+        b.cond = cond;
+        b.other = other;
+    }
+    void add(IrStmt::Kind kind, int l, int32_t target, int32_t expr)
+    {
+        current().blocks[cur].stmts.push_back(IrStmt{ kind, static_cast<uint8_t>(l), target, expr });
+    }
+    int32_t make(IrOp op, int32_t x, int32_t y = -1, int64_t value = 0, int l = 0)
+    {
+        current().exprs.push_back(IrExpr{ op, static_cast<uint8_t>(l), x, y, value });
+        return static_cast<int32_t>(current().exprs.size() - 1);
+    }
+    const Symbol& lookup(uint32_t ident) { return *symbols.find(ast.atom(node(ident))); }
+
+    void block(uint32_t id);
+    void statement(uint32_t id);
+    int32_t condition(uint32_t id);
+    int32_t expression(uint32_t id);
+    int32_t term(uint32_t id);
+    int32_t factor(uint32_t id);
+};
+
+/**
+ * @brief
+ * 分程序=[常量声明][变量声明]{过程声明}<语句>，语句接在当前块之后
+ */
+void Lowering::block(uint32_t id)
+{
+    if (Stack::low()) return Stack::run([&] { block(id); });
+    for (uint32_t c = node(id).first; c != Ast::NIL; c = node(c).next) {
+        const Node& n = node(c);
+        if (n.kind == NodeKind::CONST_DECL) {
+            uint32_t name = Ast::NIL;
+            for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next) {
+                const Node& leaf = node(k);
+                if (leaf.kind == NodeKind::IDENT) name = ast.atom(leaf);
+                else if (leaf.kind == NodeKind::NUMBER)
+                    symbols.declare(name, Symbol::Type::CONST, ast.number(leaf));
+            }
+        } else if (n.kind == NodeKind::VAR_DECL) {
+            for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next)
+                if (node(k).kind == NodeKind::IDENT) {
+                    uint32_t name = ast.atom(node(k));
+                    symbols.declare(name, Symbol::Type::VAR, FRAME_HEADER + static_cast<int>(current().vars.size()));
+                    current().vars.push_back(name);
+                }
+        } else if (n.kind == NodeKind::PROC_DECL) {
+            uint32_t name = ast.atom(node(ast.child(c, 1)));
+            int outer = proc;
+            int32_t outerBlock = cur;
+            int p = newProc(name, outer, symbols.level() + 1);
+            symbols.declare(name, Symbol::Type::PROCEDURE, p);      // 过程名属于外层
+            symbols.enterScope();
+            proc = p;
+            enter(newBlock());
+            block(ast.child(c, 3));
+            leave(IrBlock::RETURN);
+            symbols.leaveScope();
+            proc = outer;
+            cur = outerBlock;
+        } else if (n.kind == NodeKind::STATEMENT) {
+            statement(c);
+        }
+    }
+}
+
+/**
+ * @brief
+ * 语句：if、while 结束当前块并新建块，其余语句追加到当前块
+ */
+void Lowering::statement(uint32_t id)
+{
+    if (Stack::low()) return Stack::run([&] { statement(id); });
+    uint32_t s = node(id).first;
+    if (s == Ast::NIL) return;
+    const Node& n = node(s);
+    switch (n.kind) {
+    case NodeKind::ASSIGN: {
+        int32_t e = expression(ast.child(s, 2));
+        const Symbol& v = lookup(ast.child(s, 0));
+        add(IrStmt::ASSIGN, symbols.level() - v.level, v.value, e);
+        break;
+    }
+    case NodeKind::CALL: {
+        const Symbol& p = lookup(ast.child(s, 1));
+        add(IrStmt::CALL, symbols.level() - p.level, p.value, -1);
+        break;
+    }
+    case NodeKind::COMPOUND:
+        for (uint32_t k = n.first; k != Ast::NIL; k = node(k).next)
+            if (node(k).kind == NodeKind::STATEMENT) statement(k);
+        break;
+    case NodeKind::IF: {
+        int32_t c = condition(ast.child(s, 1));
+        uint32_t otherwise = ast.child(s, 5);
+        int32_t then = newBlock();
+        int32_t alt = otherwise == Ast::NIL ? -1 : newBlock();
+        int32_t join = newBlock();
+        leave(IrBlock::BRANCH, then, c, alt < 0 ? join : alt);
+        enter(then);
+        statement(ast.child(s, 3));
+        leave(IrBlock::JUMP, join);
+        if (alt >= 0) {
+            enter(alt);
+            statement(otherwise);
+            leave(IrBlock::JUMP, join);
+        }
+        enter(join);
+        break;
+    }
+    case NodeKind::WHILE: {
+        int32_t head = newBlock();
+        leave(IrBlock::JUMP, head);
+        enter(head);
+        int32_t c = condition(ast.child(s, 1));
+        int32_t body = newBlock();
+        int32_t exit = newBlock();
+        leave(IrBlock::BRANCH, body, c, exit);
+        enter(body);
+        statement(ast.child(s, 3));
+        leave(IrBlock::JUMP, head);
+        enter(exit);
+        break;
+    }
+    case NodeKind::READ: {
+        const Symbol& v = lookup(ast.child(s, 2));
+        add(IrStmt::READ, symbols.level() - v.level, v.value, -1);
+        break;
+    }
+    case NodeKind::WRITE:
+        add(IrStmt::WRITE, 0, 0, expression(ast.child(s, 2)));
+        break;
+    default:
+        break;
+    }
+}
+
+int32_t Lowering::condition(uint32_t id)
+{
+    uint32_t first = node(id).first;
+    if (node(first).kind == NodeKind::SYMBOL)           // odd
+        return make(IrOp::ODD, expression(node(first).next));
+    uint32_t op = node(first).next;
+    int32_t lhs = expression(first);
+    int32_t rhs = expression(node(op).next);
+    IrOp cmp = IrOp::EQL;
+    switch (node(op).tok) {
+    case Tok::EQL: cmp = IrOp::EQL; break;
+    case Tok::NEQ: cmp = IrOp::NEQ; break;
+    case Tok::LSS: cmp = IrOp::LSS; break;
+    case Tok::GEQ: cmp = IrOp::GEQ; break;
+    case Tok::GTR: cmp = IrOp::GTR; break;
+    case Tok::LEQ: cmp = IrOp::LEQ; break;
+    default: break;
+    }
+    return make(cmp, lhs, rhs);
+}
+
+int32_t Lowering::expression(uint32_t id)
+{
+    if (Stack::low()) {
+        int32_t e;
+        Stack::run([&] { e = expression(id); });
+        return e;
+    }
+    uint32_t k = node(id).first;
+    bool negate = false;
+    if (node(k).kind == NodeKind::UNARY_OP) {
+        negate = node(k).tok == Tok::MINUS;
+        k = node(k).next;
+    }
+    int32_t e = term(k);
+    if (negate) e = make(IrOp::NEG, e);
+    for (k = node(k).next; k != Ast::NIL; k = node(node(k).next).next) {
+        IrOp op = node(k).tok == Tok::PLUS ? IrOp::ADD : IrOp::SUB;
+        e = make(op, e, term(node(k).next));
+    }
+    return e;
+}
+
+int32_t Lowering::term(uint32_t id)
+{
+    uint32_t k = node(id).first;
+    int32_t e = factor(k);
+    for (k = node(k).next; k != Ast::NIL; k = node(node(k).next).next) {
+        IrOp op = node(k).tok == Tok::TIMES ? IrOp::MUL : IrOp::DIV;
+        e = make(op, e, factor(node(k).next));
+    }
+    return e;
+}
+
+int32_t Lowering::factor(uint32_t id)
+{
+    uint32_t k = node(id).first;
+    const Node& n = node(k);
+    if (n.kind == NodeKind::NUMBER) return make(IrOp::NUM, -1, -1, ast.number(n));
+    if (n.kind != NodeKind::IDENT) return expression(n.next);          // 括号
+    const Symbol& s = lookup(k);
+    if (s.type == Symbol::Type::CONST) return make(IrOp::CONST, static_cast<int32_t>(s.atom), -1, s.value);
+    return make(IrOp::LOAD, s.value, -1, 0, symbols.level() - s.level);
+}
+
+/**
+ * @brief 由中间表示生成 P-code
+ */
+class Emitter {
+public:
+    Emitter(const IrProgram& i, Program& p) : ir(i), prog(p) {}
+
+    void run();
+
+private:
+    struct Fixup { int at; int32_t target; };
+
+    const IrProgram& ir;
+    Program& prog;
+    int depth = 0;
+
+    int emit(Op op, int l, int64_t a)
+    {
+        depth += stackEffect(op, a);
+        if (depth > prog.maxTemp) prog.maxTemp = depth;
+        prog.code.push_back(Instr{ op, static_cast<uint8_t>(l), a });
+        return static_cast<int>(prog.code.size() - 1);
+    }
+    void expr(const IrProc& p, int32_t e);
+};
+
+void Emitter::expr(const IrProc& p, int32_t id)
+{
+    if (Stack::low()) return Stack::run([&] { expr(p, id); });
+    static const int oprs[] = { 0, 0, 0, OPR_NEG, OPR_ODD, OPR_ADD, OPR_SUB, OPR_MUL, OPR_DIV,
+                                OPR_EQL, OPR_NEQ, OPR_LSS, OPR_GEQ, OPR_GTR, OPR_LEQ };
+    const IrExpr& e = p.exprs[id];
+    switch (e.op) {
+    case IrOp::NUM: case IrOp::CONST: emit(Op::LIT, 0, e.value); return;
+    case IrOp::LOAD: emit(Op::LOD, e.l, e.x); return;
+    case IrOp::NEG: case IrOp::ODD: expr(p, e.x); break;
+    default: expr(p, e.x); expr(p, e.y); break;
+    }
+    emit(Op::OPR, 0, oprs[static_cast<int>(e.op)]);
+}
+
+void Emitter::run()
+{
+    prog.code.clear();
+    prog.maxTemp = 0;
+    std::vector<int> entry(ir.procs.size(), -1);
+    std::vector<Fixup> calls;
+    for (size_t k = 0; k < ir.procs.size(); ++k) {
+        const IrProc& p = ir.procs[k];
+        if (!p.live) continue;
+        entry[k] = emit(Op::INT, 0, FRAME_HEADER + static_cast<int>(p.vars.size()));
+        std::vector<int> label(p.blocks.size(), -1);
+        std::vector<Fixup> jumps;
+        for (size_t i = 0; i < p.order.size(); ++i) {
+            int32_t id = p.order[i];
+            int32_t follow = i + 1 < p.order.size() ? p.order[i + 1] : -1;
+            const IrBlock& b = p.blocks[id];
+            label[id] = static_cast<int>(prog.code.size());
+            for (const IrStmt& s : b.stmts) {
+                switch (s.kind) {
+                case IrStmt::ASSIGN: expr(p, s.expr); emit(Op::STO, s.l, s.target); break;
+                case IrStmt::CALL: calls.push_back(Fixup{ emit(Op::CAL, s.l, 0), s.target }); break;
+                case IrStmt::READ: emit(Op::RED, s.l, s.target); break;
+                case IrStmt::WRITE: expr(p, s.expr); emit(Op::WRT, 0, 0); break;
+                }
+            }
+            switch (b.exit) {
+            case IrBlock::JUMP:
+                if (b.next != follow) jumps.push_back(Fixup{ emit(Op::JMP, 0, 0), b.next });
+                break;
+            case IrBlock::BRANCH:
+                expr(p, b.cond);
+                jumps.push_back(Fixup{ emit(Op::JPC, 0, 0), b.other });
+                if (b.next != follow) jumps.push_back(Fixup{ emit(Op::JMP, 0, 0), b.next });
+                break;
+            case IrBlock::RETURN:
+                if (k == 0) emit(Op::HLT, 0, 0);
+                else emit(Op::OPR, 0, OPR_RET);
+                break;
+            }
+        }
+        for (const Fixup& f : jumps) prog.code[f.at].a = label[f.target];
+    }
+    for (const Fixup& f : calls) prog.code[f.at].a = entry[f.target];
+}
+
+/* ------------ 文本形式 ------------ */
+
+class Printer {
+public:
+    Printer(const IrProgram& i, FILE* o, const Interner* n) : ir(i), out(o), names(n) {}
+
+    void run();
+
+private:
+    const IrProgram& ir;
+    FILE* out;
+    const Interner* names;
+
+    std::string name(uint32_t atom) const
+    {
+        if (!names || atom == Interner::NONE) return "?";
+        Lexeme l = names->name(atom);
+        return std::string(l.ptr, l.len);
+    }
+    std::string variable(int proc, int l, int32_t addr) const;
+    std::string expr(int proc, int32_t id) const;
+};
+
+/* 变量名：沿定义关系向外走 l 层找到所属过程 */
+std::string Printer::variable(int proc, int l, int32_t addr) const
+{
+    int p = proc;
+    while (l-- > 0 && p >= 0) p = ir.procs[p].parent;
+    size_t k = static_cast<size_t>(addr - FRAME_HEADER);
+    if (p < 0 || k >= ir.procs[p].vars.size()) return "@" + std::to_string(addr);
+    return name(ir.procs[p].vars[k]);
+}
+
+std::string Printer::expr(int proc, int32_t id) const
+{
+    if (Stack::low()) {
+        std::string s;
+        Stack::run([&] { s = expr(proc, id); });
+        return s;
+    }
+    static const char* const ops[] = { "", "", "", "-", "odd ", " + ", " - ", " * ", " / ",
+                                       " = ", " # ", " < ", " >= ", " > ", " <= " };
+    const IrExpr& e = ir.procs[proc].exprs[id];
+    switch (e.op) {
+    case IrOp::NUM: return std::to_string(e.value);
+    case IrOp::CONST: return name(static_cast<uint32_t>(e.x));
+    case IrOp::LOAD: return variable(proc, e.l, e.x);
+    case IrOp::NEG: case IrOp::ODD: return ops[static_cast<int>(e.op)] + expr(proc, e.x);
+    default: return "(" + expr(proc, e.x) + ops[static_cast<int>(e.op)] + expr(proc, e.y) + ")";
+    }
+}
+
+void Printer::run()
+{
+    for (size_t k = 0; k < ir.procs.size(); ++k) {
+        const IrProc& p = ir.procs[k];
+        int proc = static_cast<int>(k);
+        std::fprintf(out, "%s %s  层级 %d，变量 %zu 个%s\n", k ? "procedure" : "program",
+                     k ? name(p.name).c_str() : "main", p.level, p.vars.size(), p.live ? "" : "，不会被调用");
+        if (!p.live) continue;
+        for (int32_t id : p.order) {
+            const IrBlock& b = p.blocks[id];
+            std::fprintf(out, "  B%d:\n", id);
+            for (const IrStmt& s : b.stmts) {
+                switch (s.kind) {
+                case IrStmt::ASSIGN:
+                    std::fprintf(out, "    %s := %s\n", variable(proc, s.l, s.target).c_str(), expr(proc, s.expr).c_str());
+                    break;
+                case IrStmt::CALL: std::fprintf(out, "    call %s\n", name(ir.procs[s.target].name).c_str()); break;
+                case IrStmt::READ: std::fprintf(out, "    read %s\n", variable(proc, s.l, s.target).c_str()); break;
+                case IrStmt::WRITE: std::fprintf(out, "    write %s\n", expr(proc, s.expr).c_str()); break;
+                }
+            }
+            switch (b.exit) {
+            case IrBlock::JUMP: std::fprintf(out, "    goto B%d\n", b.next); break;
+            case IrBlock::BRANCH:
+                std::fprintf(out, "    if %s goto B%d else B%d\n", expr(proc, b.cond).c_str(), b.next, b.other);
+                break;
+            case IrBlock::RETURN: std::fprintf(out, "    %s\n", k ? "return" : "halt"); break;
+            }
+        }
+    }
+}
+
+}
+
+void lowerToIr(const Ast& ast, IrProgram& ir)
+{
+    Lowering(ast, ir).program();
+}
+
+void emitPcode(const IrProgram& ir, Program& prog)
+{
+    Emitter(ir, prog).run();
+}
+
+void printIr(const IrProgram& ir, FILE* out, const Interner* names)
+{
+    Printer(ir, out, names).run();
+}
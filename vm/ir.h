@@ -0,0 +1,123 @@
+#ifndef PL0_IR_H
+#define PL0_IR_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../parser/ast.h"
+#include "pcode.h"
+
+/**
+ * @brief 中间表示的表达式运算
+ * CONST 为对 const 名字的引用，值已知但尚未代入；NUM 为字面常数或折叠后的结果。
+ */
+enum class IrOp : unsigned char {
+    NUM, CONST, LOAD,
+    NEG, ODD,
+    ADD, SUB, MUL, DIV,
+    EQL, NEQ, LSS, GEQ, GTR, LEQ
+};
+
+/* 表达式结点，按下标存放在所属过程的 exprs 中 */
+struct IrExpr {
+    IrOp op;
+    uint8_t l;          // LOAD 的层差
+    int32_t x, y;       // 子表达式；LOAD 为变量地址，CONST 为名字的原子编号
+    int64_t value;      // NUM、CONST 的值
+};
+
+/* 基本块中的语句 */
+struct IrStmt {
+    enum Kind : unsigned char { ASSIGN, CALL, READ, WRITE };
+    Kind kind;
+    uint8_t l;          // 变量或被调过程的层差
+    int32_t target;     // ASSIGN / READ 为变量地址，CALL 为过程下标
+    int32_t expr;       // ASSIGN / WRITE 的表达式，其余为 -1
+};
+
+/**
+ * @brief 基本块
+ * 语句顺序执行，最后由出口转移：
+ *   JUMP    转到 next
+ *   BRANCH  cond 非 0 转到 next，否则转到 other
+ *   RETURN  过程返回，主程序为停机
+ */
+struct IrBlock {
+    enum Exit : unsigned char { JUMP, BRANCH, RETURN };
+    std::vector<IrStmt> stmts;
+    Exit exit = RETURN;
+    int32_t cond = -1;
+    int32_t next = -1, other = -1;
+};
+
+/**
+ * @brief 过程（下标 0 为主程序）
+ * blocks 按创建顺序编号，入口为 0 号块；order 为排放顺序，即源程序中出现的先后，
+ * 生成代码时按它排放，删除的块不在其中。
+ */
+struct IrProc {
+    uint32_t name;              // 原子编号，主程序为 Interner::NONE
+    int level;                  // 过程体的层级，主程序为 0
+    int parent;                 // 定义它的外层过程，主程序为 -1
+    std::vector<uint32_t> vars; // 变量名的原子编号，第 k 个变量的地址为 3+k
+    bool live = true;           // 从主程序出发是否可能被调用
+    std::vector<IrExpr> exprs;
+    std::vector<IrBlock> blocks;
+    std::vector<int32_t> order;
+};
+
+/* 程序的中间表示：每个过程一张控制流图 */
+struct IrProgram {
+    std::vector<IrProc> procs;
+};
+
+/* 由语法树生成中间表示，与 CodeGen 一样只应对没有语义错误的树调用 */
+void lowerToIr(const Ast& ast, IrProgram& ir);
+
+/* 由中间表示生成 P-code：主程序在前，各过程依次排在其后，不再需要绕过内层过程的 JMP */
+void emitPcode(const IrProgram& ir, Program& prog);
+
+/* 以文本列出中间表示，names 给出原子对应的名字，可为 nullptr */
+void printIr(const IrProgram& ir, FILE* out, const Interner* names);
+
+/* 一个优化遍的统计 */
+struct PassStats {
+    const char* name;
+    int runs = 0;               // 执行次数
+    long changes = 0;           // 改写的次数，含义见各遍
+    double seconds = 0;
+};
+
+/**
+ * @brief 优化遍的流水线
+ *   常量传播   const 名字代入其值；基本块内已知为常数的变量代入其值（遇到 call、read 失效）
+ *   常量折叠   运算数都是常数的运算（含 odd 与比较）算出结果
+ *   分支化简   条件为常数的分支改为跳转，跳转到空块的改为跳到其后继，
+ *              只有一个前驱的块并入前驱，使块内的常量传播能跨过原来的块界
+ *   删除死代码 删除入口到不了的基本块，以及从主程序出发不会被调用的过程
+ * 四遍依次执行，有改动时再来一轮，直到不再变化（至多 maxRounds 轮）。
+ * 折叠与运行时的语义一致：按 64 位补码回绕，除数为 0 时不折叠。
+ */
+class Optimizer {
+public:
+    int maxRounds = 8;
+
+    void run(IrProgram& ir);
+
+    const std::vector<PassStats>& stats() const { return passes; }
+    int rounds() const { return roundCount; }
+    /* 中间表示的规模：语句数与基本块数 */
+    static size_t statements(const IrProgram& ir);
+    static size_t blocks(const IrProgram& ir);
+
+    /* 把各遍统计写成表格 */
+    void report(FILE* out) const;
+
+private:
+    std::vector<PassStats> passes;
+    int roundCount = 0;
+};
+
+#endif
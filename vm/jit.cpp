@@ -0,0 +1,487 @@
+#include "jit.h"
+
+#include <cstddef>
+#include <cstring>
+
+#ifdef PL0_JIT_X64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool Jit::supported()
+{
+#ifdef PL0_JIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+Jit::Jit(size_t stackWords) : stack(stackWords < 64 ? 64 : stackWords) {}
+
+Jit::~Jit()
+{
+    release();
+}
+
+void Jit::release()
+{
+#ifdef PL0_JIT_X64
+    if (mem) munmap(mem, mapped);
+#endif
+    mem = nullptr;
+    size = mapped = 0;
+}
+
+#ifdef PL0_JIT_X64
+
+namespace {
+
+/* 出错原因，下标为 Context::error */
+const char* const errors[] = { "", "栈溢出", "除数为 0", "读入失败" };
+enum { E_NONE, E_STACK, E_DIV, E_READ };
+
+enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum Cond { CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+/* 表达式临时单元所用的寄存器，按栈深度依次使用 */
+const Reg temps[] = { R8, R9, R10, R11, RSI, RDI, R14, R15 };
+const int TEMP_REGS = sizeof(temps) / sizeof(temps[0]);
+
+/**
+ * @brief 最小的 x86-64 汇编器，只有即时编译用到的指令，全部为 64 位操作数
+ */
+class Asm {
+public:
+    std::vector<uint8_t> buf;
+
+    size_t pos() const { return buf.size(); }
+    void byte(unsigned b) { buf.push_back(static_cast<uint8_t>(b)); }
+    void dword(uint32_t v) { for (int k = 0; k < 4; ++k) byte(v >> (8 * k)); }
+    void qword(uint64_t v) { for (int k = 0; k < 8; ++k) byte(static_cast<unsigned>(v >> (8 * k))); }
+    void patch(size_t at, int32_t v) { std::memcpy(&buf[at], &v, 4); }
+
+    /* REX 前缀，reg 为 ModRM 的 reg 字段，rm 为 r/m 字段或基址 */
+    void rex(int reg, int rm, bool w = true) { byte(0x40 | (w ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0)); }
+    void direct(int reg, int rm) { byte(0xC0 | (reg & 7) << 3 | (rm & 7)); }
+    /* [base + disp] */
+    void memory(int reg, int base, int32_t disp)
+    {
+        bool small = disp >= -128 && disp <= 127;
+        byte((small ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7));
+        if ((base & 7) == RSP) byte(0x24);          // rsp / r12 作基址需要 SIB
+        if (small) byte(static_cast<unsigned>(disp)); else dword(static_cast<uint32_t>(disp));
+    }
+
+    /* dst op= src：op 为 01 add、29 sub、39 cmp、85 test、89 mov 等 "r/m, r" 形式 */
+    void rr(unsigned op, Reg dst, Reg src) { rex(src, dst); byte(op); direct(src, dst); }
+    void mov(Reg dst, Reg src) { rr(0x89, dst, src); }
+    void load(Reg dst, Reg base, int32_t disp) { rex(dst, base); byte(0x8B); memory(dst, base, disp); }
+    void store(Reg base, int32_t disp, Reg src) { rex(src, base); byte(0x89); memory(src, base, disp); }
+    void lea(Reg dst, Reg base, int32_t disp) { rex(dst, base); byte(0x8D); memory(dst, base, disp); }
+    void store32(Reg base, int32_t disp, int32_t imm)      /* mov dword [base+disp], imm */
+    {
+        if (base & 8) byte(0x41);
+        byte(0xC7); memory(0, base, disp); dword(static_cast<uint32_t>(imm));
+    }
+    void movImm(Reg dst, int64_t imm)
+    {
+        if (imm >= INT32_MIN && imm <= INT32_MAX) { rex(0, dst); byte(0xC7); direct(0, dst); dword(static_cast<uint32_t>(imm)); }
+        else { rex(0, dst); byte(0xB8 + (dst & 7)); qword(static_cast<uint64_t>(imm)); }
+    }
+    void imul(Reg dst, Reg src) { rex(dst, src); byte(0x0F); byte(0xAF); direct(dst, src); }
+    void neg(Reg r) { rex(0, r); byte(0xF7); direct(3, r); }
+    void andImm8(Reg r, int8_t imm) { rex(0, r); byte(0x83); direct(4, r); byte(static_cast<unsigned>(imm)); }
+    void cmpImm8(Reg r, int8_t imm) { rex(0, r); byte(0x83); direct(7, r); byte(static_cast<unsigned>(imm)); }
+    void cqo() { byte(0x48); byte(0x99); }
+    void idiv(Reg r) { rex(0, r); byte(0xF7); direct(7, r); }
+    void xor32(Reg r) { if (r & 8) byte(0x45); byte(0x31); direct(r, r); }
+    void setcc(Cond c) { byte(0x0F); byte(0x90 + c); byte(0xC0); }         // setcc al
+    void movzxAl() { byte(0x0F); byte(0xB6); byte(0xC0); }                 // movzx eax, al
+    void push(Reg r) { if (r & 8) byte(0x41); byte(0x50 + (r & 7)); }
+    void pop(Reg r) { if (r & 8) byte(0x41); byte(0x58 + (r & 7)); }
+    void ret() { byte(0xC3); }
+    void callRax() { byte(0xFF); byte(0xD0); }
+    void repStosq() { byte(0xF3); byte(0x48); byte(0xAB); }
+
+    /* 32 位相对跳转，返回偏移量所在位置，待 patch */
+    size_t jmp() { byte(0xE9); dword(0); return pos() - 4; }
+    size_t call() { byte(0xE8); dword(0); return pos() - 4; }
+    size_t jcc(Cond c) { byte(0x0F); byte(0x80 + c); dword(0); return pos() - 4; }
+    /* 把 at 处的相对偏移指向 target */
+    void link(size_t at, size_t target) { patch(at, static_cast<int32_t>(target - (at + 4))); }
+};
+
+int jitRead(Jit::Context* c, Word* dst)
+{
+    long long v;
+    if (std::fscanf(c->in, "%lld", &v) != 1) return 0;
+    *dst = v;
+    return 1;
+}
+
+void jitWrite(Jit::Context* c, Word v)
+{
+    std::fprintf(c->out, "%lld\n", static_cast<long long>(v));
+}
+
+/**
+ * @brief 逐条翻译 P-code
+ */
+class Translator {
+public:
+    explicit Translator(const Program& p) : prog(p), labels(p.code.size() + 1, 0) {}
+
+    bool run(std::vector<uint8_t>& out, std::string& err);
+
+private:
+    struct Fixup { size_t at; int target; };       // 跳到 P-code 地址 target
+    struct Stub { size_t at; int error; int pc; };  // 跳到出错处理
+
+    const Program& prog;
+    Asm a;
+    std::vector<size_t> labels;         // P-code 地址 -> 机器码偏移
+    std::vector<Fixup> fixups;
+    std::vector<Stub> stubs;
+    std::vector<size_t> exits;          // HLT 的跳转
+
+    static int32_t slot(int k) { return 8 * k; }            // 变量 / 活动记录第 k 个单元的偏移
+    /* 第 k 个临时单元：寄存器，或 r12 之上的数据栈 */
+    static bool inReg(int k) { return k < TEMP_REGS; }
+    static int32_t spill(int k) { return 8 * (k - TEMP_REGS); }
+
+    void get(Reg dst, int k) { if (inReg(k)) { if (temps[k] != dst) a.mov(dst, temps[k]); } else a.load(dst, R12, spill(k)); }
+    void put(int k, Reg src) { if (inReg(k)) { if (temps[k] != src) a.mov(temps[k], src); } else a.store(R12, spill(k), src); }
+    /* 第 k 个临时单元所在的寄存器；在内存中时先取到 scratch */
+    Reg use(int k, Reg scratch) { if (inReg(k)) return temps[k]; get(scratch, k); return scratch; }
+
+    Reg frame(int l);                   // 层差为 l 的活动记录基址所在的寄存器
+    void callHelper(const void* fn);
+    void fail(Cond c, int error, int pc) { stubs.push_back(Stub{ a.jcc(c), error, pc }); }
+    void binary(unsigned op, int k);
+    void compare(Cond c, int k);
+    void divide(int k, int pc);
+};
+
+/**
+ * @brief
+ * 沿静态链取 l 次，结果在 rax；l 为 0 时直接用 rbx
+ */
+Reg Translator::frame(int l)
+{
+    if (l == 0) return RBX;
+    a.load(RAX, RBX, 0);
+    while (--l > 0) a.load(RAX, RAX, 0);
+    return RAX;
+}
+
+/**
+ * @brief
+ * 调用读写函数：参数已在 rdi、rsi，机器栈按 16 字节对齐后调用，返回后恢复
+ */
+void Translator::callHelper(const void* fn)
+{
+    a.store(RBP, offsetof(Jit::Context, callRsp), RSP);
+    a.andImm8(RSP, -16);
+    a.movImm(RAX, reinterpret_cast<int64_t>(fn));
+    a.callRax();
+    a.load(RSP, RBP, offsetof(Jit::Context, callRsp));
+}
+
+/**
+ * @brief
+ * 第 k 个临时单元 op= 第 k+1 个
+ */
+void Translator::binary(unsigned op, int k)
+{
+    if (inReg(k)) {
+        Reg rhs = use(k + 1, RCX);
+        if (op == 0xAF) a.imul(temps[k], rhs); else a.rr(op, temps[k], rhs);
+        return;
+    }
+    get(RAX, k);
+    get(RCX, k + 1);
+    if (op == 0xAF) a.imul(RAX, RCX); else a.rr(op, RAX, RCX);
+    put(k, RAX);
+}
+
+void Translator::compare(Cond c, int k)
+{
+    Reg lhs = use(k, RAX);
+    Reg rhs = use(k + 1, RCX);
+    a.rr(0x39, lhs, rhs);
+    a.setcc(c);
+    a.movzxAl();
+    put(k, RAX);
+}
+
+/**
+ * @brief
+ * 有符号除法，除数为 -1 时取负，避免最小值除以 -1 触发异常
+ */
+void Translator::divide(int k, int pc)
+{
+    get(RAX, k);
+    get(RCX, k + 1);
+    a.rr(0x85, RCX, RCX);
+    fail(CC_E, E_DIV, pc);
+    a.cmpImm8(RCX, -1);
+    a.byte(0x75); a.byte(5);            // jne 除法
+    a.neg(RAX);
+    a.byte(0xEB); a.byte(5);            // jmp 结束
+    a.cqo();
+    a.idiv(RCX);
+    put(k, RAX);
+}
+
+bool Translator::run(std::vector<uint8_t>& out, std::string& err)
+{
+    const std::vector<Instr>& code = prog.code;
+    int n = static_cast<int>(code.size());
+
+    // 各条指令执行前的表达式栈深度；跳转目标处必须为 0
+    std::vector<int> depth(n + 1, 0);
+    std::vector<bool> target(n + 1, false);
+    for (int i = 0; i < n; ++i) {
+        const Instr& in = code[i];
+        if (in.op == Op::CAL || in.op == Op::JMP || in.op == Op::JPC) {
+            if (in.a < 0 || in.a >= n) {
+                err = "地址 " + std::to_string(i) + ": 跳转目标越界";
+                return false;
+            }
+            target[in.a] = true;
+        }
+        int d = depth[i] + stackEffect(in.op, in.a);
+        if (in.op == Op::JMP || in.op == Op::HLT || (in.op == Op::OPR && in.a == OPR_RET)) d = 0;
+        bool bad = d < 0
+            || ((in.op == Op::CAL || in.op == Op::RED || in.op == Op::INT) && depth[i] != 0)
+            || (in.op == Op::WRT && depth[i] != 1)
+            || (in.op == Op::OPR && in.a >= OPR_ADD && in.a != OPR_ODD && depth[i] < 2);
+        if (bad) {
+            err = "地址 " + std::to_string(i) + ": 表达式栈的形状不支持即时编译";
+            return false;
+        }
+        depth[i + 1] = d;
+    }
+    for (int i = 0; i < n; ++i)
+        if (target[i] && depth[i] != 0) {
+            err = "地址 " + std::to_string(i) + ": 跳转目标处表达式栈不为空";
+            return false;
+        }
+
+    // 入口：void entry(Context* rdi)
+    const Reg saved[] = { RBX, RBP, R12, R13, R14, R15 };
+    for (Reg r : saved) a.push(r);
+    a.mov(RBP, RDI);
+    a.store(RBP, offsetof(Jit::Context, savedRsp), RSP);
+    a.load(RBX, RBP, offsetof(Jit::Context, stack));
+    a.mov(R12, RBX);
+    a.load(R13, RBP, offsetof(Jit::Context, limit));
+
+    for (int i = 0; i < n; ++i) {
+        labels[i] = a.pos();
+        const Instr& in = code[i];
+        int d = depth[i];
+        switch (in.op) {
+        case Op::LIT:
+            if (inReg(d)) a.movImm(temps[d], in.a);
+            else { a.movImm(RAX, in.a); put(d, RAX); }
+            break;
+        case Op::LOD: {
+            Reg base = frame(in.l);
+            Reg dst = inReg(d) ? temps[d] : RCX;
+            a.load(dst, base, slot(in.a));
+            put(d, dst);
+            break;
+        }
+        case Op::STO: {
+            Reg base = frame(in.l);
+            a.store(base, slot(in.a), use(d - 1, RCX));
+            break;
+        }
+        case Op::CAL: {
+            Reg link = frame(in.l);
+            a.store(R12, 0, link);                  // 静态链
+            a.store(R12, 8, RBX);                   // 动态链
+            a.mov(RBX, R12);
+            fixups.push_back(Fixup{ a.call(), static_cast<int>(in.a) });
+            break;
+        }
+        case Op::INT: {
+            a.lea(RDX, R12, slot(in.a));
+            a.rr(0x39, RDX, R13);                   // cmp rdx, r13
+            fail(CC_A, E_STACK, i);
+            int vars = in.a - FRAME_HEADER;
+            if (vars > 16) {
+                a.lea(RDI, RBX, slot(FRAME_HEADER));
+                a.movImm(RCX, vars);
+                a.xor32(RAX);
+                a.repStosq();
+            } else if (vars > 0) {
+                a.xor32(RCX);
+                for (int k = 0; k < vars; ++k) a.store(RBX, slot(FRAME_HEADER + k), RCX);
+            }
+            a.mov(R12, RDX);
+            break;
+        }
+        case Op::JMP:
+            fixups.push_back(Fixup{ a.jmp(), static_cast<int>(in.a) });
+            break;
+        case Op::JPC: {
+            Reg r = use(d - 1, RAX);
+            a.rr(0x85, r, r);
+            fixups.push_back(Fixup{ a.jcc(CC_E), static_cast<int>(in.a) });
+            break;
+        }
+        case Op::RED: {
+            Reg base = frame(in.l);
+            a.lea(RSI, base, slot(in.a));
+            a.mov(RDI, RBP);
+            callHelper(reinterpret_cast<const void*>(&jitRead));
+            a.rr(0x85, RAX, RAX);
+            fail(CC_E, E_READ, i);
+            break;
+        }
+        case Op::WRT:
+            get(RSI, d - 1);
+            a.mov(RDI, RBP);
+            callHelper(reinterpret_cast<const void*>(&jitWrite));
+            break;
+        case Op::HLT:
+            exits.push_back(a.jmp());
+            break;
+        case Op::OPR:
+            switch (in.a) {
+            case OPR_RET:
+                a.mov(R12, RBX);
+                a.load(RBX, RBX, 8);
+                a.ret();
+                break;
+            case OPR_NEG:
+                if (inReg(d - 1)) a.neg(temps[d - 1]);
+                else { get(RAX, d - 1); a.neg(RAX); put(d - 1, RAX); }
+                break;
+            case OPR_ODD:
+                if (inReg(d - 1)) a.andImm8(temps[d - 1], 1);
+                else { get(RAX, d - 1); a.andImm8(RAX, 1); put(d - 1, RAX); }
+                break;
+            case OPR_ADD: binary(0x01, d - 2); break;
+            case OPR_SUB: binary(0x29, d - 2); break;
+            case OPR_MUL: binary(0xAF, d - 2); break;
+            case OPR_DIV: divide(d - 2, i); break;
+            case OPR_EQL: compare(CC_E, d - 2); break;
+            case OPR_NEQ: compare(CC_NE, d - 2); break;
+            case OPR_LSS: compare(CC_L, d - 2); break;
+            case OPR_GEQ: compare(CC_GE, d - 2); break;
+            case OPR_GTR: compare(CC_G, d - 2); break;
+            case OPR_LEQ: compare(CC_LE, d - 2); break;
+            default:
+                err = "地址 " + std::to_string(i) + ": 未知的运算";
+                return false;
+            }
+            break;
+        }
+    }
+
+    // 出错处理：记下原因与地址后从出口返回
+    for (const Stub& s : stubs) {
+        a.link(s.at, a.pos());
+        a.store32(RBP, offsetof(Jit::Context, error), s.error);
+        a.store32(RBP, offsetof(Jit::Context, pc), s.pc);
+        exits.push_back(a.jmp());
+    }
+    // 出口：恢复进入时的机器栈，可从任意调用深度直接返回
+    size_t exit = a.pos();
+    a.load(RSP, RBP, offsetof(Jit::Context, savedRsp));
+    for (int k = 5; k >= 0; --k) a.pop(saved[k]);
+    a.ret();
+
+    for (const Fixup& f : fixups) a.link(f.at, labels[f.target]);
+    for (size_t at : exits) a.link(at, exit);
+    out.swap(a.buf);
+    return true;
+}
+
+}
+
+/**
+ * @brief
+ * 编译程序
+ */
+bool Jit::compile(const Program& prog, std::string& err)
+{
+    release();
+    if (prog.code.empty()) {
+        err = "没有代码";
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    Translator t(prog);
+    if (!t.run(bytes, err)) return false;
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    mapped = (bytes.size() + page - 1) / page * page;
+    void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        mapped = 0;
+        err = "无法分配可执行内存";
+        return false;
+    }
+    std::memcpy(p, bytes.data(), bytes.size());
+    if (mprotect(p, mapped, PROT_READ | PROT_EXEC) != 0) {      // 写完再改为可执行，不同时可写可执行
+        munmap(p, mapped);
+        mapped = 0;
+        err = "无法把内存设为可执行";
+        return false;
+    }
+    mem = p;
+    size = bytes.size();
+    maxTemp = prog.maxTemp;
+    return true;
+}
+
+#else
+
+bool Jit::compile(const Program&, std::string& err)
+{
+    err = "本平台不支持即时编译";
+    return false;
+}
+
+#endif
+
+/**
+ * @brief
+ * 运行编译好的程序
+ */
+bool Jit::run(FILE* in, FILE* out, std::string& err)
+{
+#ifdef PL0_JIT_X64
+    if (!mem) {
+        err = "尚未编译";
+        return false;
+    }
+    size_t spill = maxTemp > TEMP_REGS ? maxTemp - TEMP_REGS : 0;
+    if (spill + 2 * FRAME_HEADER >= stack.size()) {
+        err = "栈溢出";
+        return false;
+    }
+    Context ctx;
+    ctx.stack = stack.data();
+    ctx.limit = stack.data() + stack.size() - spill - FRAME_HEADER;
+    ctx.savedRsp = ctx.callRsp = nullptr;
+    ctx.in = in;
+    ctx.out = out;
+    ctx.error = E_NONE;
+    ctx.pc = 0;
+    stack[0] = stack[1] = stack[2] = 0;
+    reinterpret_cast<void (*)(Context*)>(mem)(&ctx);
+    if (ctx.error == E_NONE) return true;
+    err = "地址 " + std::to_string(ctx.pc) + ": " + errors[ctx.error];
+    return false;
+#else
+    (void)in; (void)out;
+    err = "本平台不支持即时编译";
+    return false;
+#endif
+}
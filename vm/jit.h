@@ -0,0 +1,74 @@
+#ifndef PL0_JIT_H
+#define PL0_JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pcode.h"
+
+/* 只在 x86-64 的类 Unix 系统上生成机器码，其他平台 Jit::supported() 为 false */
+#if defined(__x86_64__) && (defined(__linux__) || defined(__FreeBSD__))
+#define PL0_JIT_X64 1
+#endif
+
+/**
+ * @brief P-code 到 x86-64 机器码的即时编译器
+ * 把 CodeGen 生成的 P-code 逐条译成机器码，放进 mmap 得到的内存，写完后改为只读可执行，在本进程内运行。
+ *
+ * 寄存器分配
+ *   rbx  当前活动记录的基址        r12  活动记录之上的第一个空单元
+ *   r13  INT 之后栈顶的上限        rbp  运行上下文（输入输出、出错信息）
+ *   表达式的临时单元按栈深度放在 r8 r9 r10 r11 rsi rdi r14 r15，更深的放在 r12 之上的数据栈里；
+ *   rax rcx rdx 为暂存。P-code 的栈深度在编译时就已确定，运行时不再移动操作数栈指针。
+ *
+ * 活动记录仍在数据栈上，布局与虚拟机相同（见 pcode.h），变量地址不变，只是静态链、动态链存的是
+ * 基址的绝对地址；返回地址由机器的 call/ret 保存，第三个单元空着。LOD/STO/CAL 的层差为 l 时
+ * 沿静态链取 l 次。
+ *
+ * 要求每个跳转目标处表达式栈为空，CodeGen 的输出总是如此；不满足时 compile() 报错。
+ */
+class Jit {
+public:
+    explicit Jit(size_t stackWords = 1 << 20);
+    ~Jit();
+
+    /* 本平台能否即时编译 */
+    static bool supported();
+
+    /* 编译程序，失败时返回 false 并在 err 中给出原因 */
+    bool compile(const Program& prog, std::string& err);
+    /* 运行编译好的程序，语义与 VM::run 相同 */
+    bool run(FILE* in, FILE* out, std::string& err);
+
+    /* 生成的机器码字节数 */
+    size_t codeSize() const { return size; }
+
+    /* 运行上下文，生成的代码经 rbp 访问 */
+    struct Context {
+        Word* stack;            // 数据栈底
+        Word* limit;            // INT 之后栈顶的上限
+        void* savedRsp;         // 进入时的机器栈指针，出错时据此直接返回
+        void* callRsp;          // 调用读写函数前的机器栈指针（调用时须按 16 字节对齐）
+        FILE* in;
+        FILE* out;
+        int32_t error;          // 0 为正常结束
+        int32_t pc;             // 出错指令的 P-code 地址
+    };
+
+private:
+    Jit(const Jit&);                    // 不可拷贝
+    Jit& operator=(const Jit&);
+
+    void release();
+
+    std::vector<Word> stack;
+    int maxTemp = 0;
+    void* mem = nullptr;                // 可执行内存
+    size_t size = 0;                    // 机器码字节数
+    size_t mapped = 0;                  // 映射的字节数
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "ir.h"
+
+#include <chrono>
+
+#include "../lexier/stack.h"
+
+namespace {
+
+/* 变量的已知常数值；同一过程体内一个变量总以同样的 (层差, 地址) 引用 */
+struct Known {
+    uint8_t l;
+    int32_t addr;
+    int64_t value;
+};
+
+void forget(std::vector<Known>& known, int l, int32_t addr)
+{
+    for (size_t k = 0; k < known.size(); ++k)
+        if (known[k].l == l && known[k].addr == addr) {
+            known[k] = known.back();
+            known.pop_back();
+            return;
+        }
+}
+
+/* 把表达式中的 const 引用与已知变量换成常数 */
+long substitute(IrProc& p, int32_t id, const std::vector<Known>& known)
+{
+    if (Stack::low()) {
+        long n;
+        Stack::run([&] { n = substitute(p, id, known); });
+        return n;
+    }
+    IrExpr& e = p.exprs[id];
+    switch (e.op) {
+    case IrOp::NUM: return 0;
+    case IrOp::CONST: e.op = IrOp::NUM; return 1;
+    case IrOp::LOAD:
+        for (const Known& k : known)
+            if (k.l == e.l && k.addr == e.x) {
+                e.op = IrOp::NUM;
+                e.value = k.value;
+                return 1;
+            }
+        return 0;
+    case IrOp::NEG: case IrOp::ODD: return substitute(p, e.x, known);
+    default: return substitute(p, e.x, known) + substitute(p, e.y, known);
+    }
+}
+
+/**
+ * @brief
+ * 常量传播：const 名字代入其值；在每个基本块内自前向后记下被赋了常数的变量，
+ * 之后对它的引用代入该常数，直到它被重新赋值、读入，或遇到可能改写任何可见变量的 call。
+ * 不跨基本块传播。
+ */
+long propagate(IrProc& p)
+{
+    long changes = 0;
+    std::vector<Known> known;
+    for (int32_t id : p.order) {
+        IrBlock& b = p.blocks[id];
+        known.clear();
+        for (const IrStmt& s : b.stmts) {
+            if (s.expr >= 0) changes += substitute(p, s.expr, known);
+            switch (s.kind) {
+            case IrStmt::ASSIGN:
+                forget(known, s.l, s.target);
+                if (p.exprs[s.expr].op == IrOp::NUM) known.push_back(Known{ s.l, s.target, p.exprs[s.expr].value });
+                break;
+            case IrStmt::READ: forget(known, s.l, s.target); break;
+            case IrStmt::CALL: known.clear(); break;
+            case IrStmt::WRITE: break;
+            }
+        }
+        if (b.exit == IrBlock::BRANCH) changes += substitute(p, b.cond, known);
+    }
+    return changes;
+}
+
+/* 与虚拟机相同的运算：加减乘按 64 位补码回绕，除数为 -1 时取负 */
+bool evaluate(IrOp op, int64_t x, int64_t y, int64_t& r)
+{
+    uint64_t ux = static_cast<uint64_t>(x), uy = static_cast<uint64_t>(y);
+    switch (op) {
+    case IrOp::NEG: r = static_cast<int64_t>(0 - ux); break;
+    case IrOp::ODD: r = x & 1; break;
+    case IrOp::ADD: r = static_cast<int64_t>(ux + uy); break;
+    case IrOp::SUB: r = static_cast<int64_t>(ux - uy); break;
+    case IrOp::MUL: r = static_cast<int64_t>(ux * uy); break;
+    case IrOp::DIV:
+        if (y == 0) return false;           // 留到运行时报错
+        r = y == -1 ? static_cast<int64_t>(0 - ux) : x / y;
+        break;
+    case IrOp::EQL: r = x == y; break;
+    case IrOp::NEQ: r = x != y; break;
+    case IrOp::LSS: r = x < y; break;
+    case IrOp::GEQ: r = x >= y; break;
+    case IrOp::GTR: r = x > y; break;
+    case IrOp::LEQ: r = x <= y; break;
+    default: return false;
+    }
+    return true;
+}
+
+/* 自底向上折叠，返回折叠的运算个数 */
+long foldExpr(IrProc& p, int32_t id)
+{
+    if (Stack::low()) {
+        long n;
+        Stack::run([&] { n = foldExpr(p, id); });
+        return n;
+    }
+    IrOp op = p.exprs[id].op;
+    if (op == IrOp::NUM || op == IrOp::CONST || op == IrOp::LOAD) return 0;
+    bool unary = op == IrOp::NEG || op == IrOp::ODD;
+    int32_t x = p.exprs[id].x, y = p.exprs[id].y;
+    long changes = foldExpr(p, x) + (unary ? 0 : foldExpr(p, y));
+    if (p.exprs[x].op != IrOp::NUM || (!unary && p.exprs[y].op != IrOp::NUM)) return changes;
+    int64_t r;
+    if (!evaluate(op, p.exprs[x].value, unary ? 0 : p.exprs[y].value, r)) return changes;
+    p.exprs[id].op = IrOp::NUM;
+    p.exprs[id].value = r;
+    return changes + 1;
+}
+
+/* 常量折叠 */
+long fold(IrProc& p)
+{
+    long changes = 0;
+    for (int32_t id : p.order) {
+        IrBlock& b = p.blocks[id];
+        for (const IrStmt& s : b.stmts)
+            if (s.expr >= 0) changes += foldExpr(p, s.expr);
+        if (b.exit == IrBlock::BRANCH) changes += foldExpr(p, b.cond);
+    }
+    return changes;
+}
+
+/* 表达式求值时是否可能因除数为 0 而出错 */
+bool mayTrap(const IrProc& p, int32_t id)
+{
+    if (Stack::low()) {
+        bool r;
+        Stack::run([&] { r = mayTrap(p, id); });
+        return r;
+    }
+    const IrExpr& e = p.exprs[id];
+    switch (e.op) {
+    case IrOp::NUM: case IrOp::CONST: case IrOp::LOAD: return false;
+    case IrOp::NEG: case IrOp::ODD: return mayTrap(p, e.x);
+    case IrOp::DIV:
+        if (p.exprs[e.y].op != IrOp::NUM || p.exprs[e.y].value == 0) return true;
+        // fall through
+    default: return mayTrap(p, e.x) || mayTrap(p, e.y);
+    }
+}
+
+/**
+ * @brief
+ * 跳过只有一条跳转的空块，返回最终目标。
+ * 结果记在 to 中（-1 为未求），沿途的块一并记下，每个块只走一次：
+ * 嵌套的 if 留下一长串首尾相接的空汇合块，逐个从头走会是平方的代价
+ * @param path 暂存沿途的块
+ */
+int32_t thread(const IrProc& p, int32_t target, std::vector<int32_t>& to, std::vector<int32_t>& path)
+{
+    const int32_t ON_PATH = -2;
+    path.clear();
+    int32_t t = target;
+    while (to[t] == -1) {
+        const IrBlock& b = p.blocks[t];
+        if (!b.stmts.empty() || b.exit != IrBlock::JUMP || b.next == t) {
+            to[t] = t;
+            break;
+        }
+        to[t] = ON_PATH;
+        path.push_back(t);
+        t = b.next;
+    }
+    int32_t final = to[t] == ON_PATH ? t : to[t];   // 空块成环时停在环的入口
+    for (int32_t k : path) to[k] = final;
+    return final;
+}
+
+/**
+ * @brief
+ * 分支化简：条件为常数或两个去向相同（且条件求值不会出错）的分支改为跳转；跳转、分支的目标若是空的跳转块，直接指向其最终目标；
+ * 跳转到的块若只有这一个前驱，把它并进来，使块内的常量传播能继续往下走
+ */
+long simplify(IrProc& p)
+{
+    long changes = 0;
+    for (int32_t id : p.order) {
+        IrBlock& b = p.blocks[id];
+        if (b.exit != IrBlock::BRANCH) continue;
+        const IrExpr& c = p.exprs[b.cond];
+        // 两个去向相同时条件仍须求值，除数可能为 0 的留着分支，由运行时报错
+        if (c.op == IrOp::NUM || (b.next == b.other && !mayTrap(p, b.cond))) {
+            if (c.op == IrOp::NUM && c.value == 0) b.next = b.other;
+            b.exit = IrBlock::JUMP;
+            b.cond = b.other = -1;
+            ++changes;
+        }
+    }
+
+    // 分支都化简完再跳过空块，改成跳转的空块也能被跳过
+    std::vector<int32_t> to(p.blocks.size(), -1), path;
+    for (int32_t id : p.order) {
+        IrBlock& b = p.blocks[id];
+        if (b.exit == IrBlock::RETURN) continue;
+        int32_t next = thread(p, b.next, to, path);
+        if (next != b.next) { b.next = next; ++changes; }
+        if (b.exit == IrBlock::BRANCH) {
+            int32_t other = thread(p, b.other, to, path);
+            if (other != b.other) { b.other = other; ++changes; }
+        }
+    }
+
+    std::vector<int> preds(p.blocks.size(), 0);
+    for (int32_t id : p.order) {
+        const IrBlock& b = p.blocks[id];
+        if (b.exit != IrBlock::RETURN) ++preds[b.next];
+        if (b.exit == IrBlock::BRANCH) ++preds[b.other];
+    }
+    for (int32_t id : p.order) {
+        IrBlock& b = p.blocks[id];
+        while (b.exit == IrBlock::JUMP && b.next != id && b.next != 0 && preds[b.next] == 1) {
+            IrBlock& t = p.blocks[b.next];
+            b.stmts.insert(b.stmts.end(), t.stmts.begin(), t.stmts.end());
+            b.exit = t.exit;
+            b.cond = t.cond;
+            b.next = t.next;
+            b.other = t.other;
+            // 被并入的块不再有前驱，由删除死代码去掉
+            t.stmts.clear();
+            t.exit = IrBlock::RETURN;
+            t.cond = t.next = t.other = -1;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+/**
+ * @brief
+ * 删除死代码：入口到不了的基本块从排放顺序中去掉；主程序出发调用不到的过程标为不会被调用。
+ * 返回删除的基本块数（含死过程的全部块）。
+ */
+long eliminate(IrProgram& ir)
+{
+    long changes = 0;
+    std::vector<char> called(ir.procs.size(), 0);
+    std::vector<int> work;
+    called[0] = 1;
+    work.push_back(0);
+    while (!work.empty()) {
+        IrProc& p = ir.procs[work.back()];
+        work.pop_back();
+        std::vector<char> seen(p.blocks.size(), 0);
+        std::vector<int32_t> stack(1, 0);
+        seen[0] = 1;
+        while (!stack.empty()) {
+            const IrBlock& b = p.blocks[stack.back()];
+            stack.pop_back();
+            for (const IrStmt& s : b.stmts)
+                if (s.kind == IrStmt::CALL && !called[s.target]) {
+                    called[s.target] = 1;
+                    work.push_back(s.target);
+                }
+            int32_t to[2] = { b.exit == IrBlock::RETURN ? -1 : b.next, b.exit == IrBlock::BRANCH ? b.other : -1 };
+            for (int32_t t : to)
+                if (t >= 0 && !seen[t]) { seen[t] = 1; stack.push_back(t); }
+        }
+        size_t kept = 0;
+        for (int32_t id : p.order)
+            if (seen[id]) p.order[kept++] = id;
+        changes += static_cast<long>(p.order.size() - kept);
+        p.order.resize(kept);
+    }
+    for (size_t k = 0; k < ir.procs.size(); ++k)
+        if (!called[k] && ir.procs[k].live) {
+            ir.procs[k].live = false;
+            changes += static_cast<long>(ir.procs[k].order.size());
+        }
+    return changes;
+}
+
+}
+
+size_t Optimizer::statements(const IrProgram& ir)
+{
+    size_t n = 0;
+    for (const IrProc& p : ir.procs)
+        if (p.live)
+            for (int32_t id : p.order) n += p.blocks[id].stmts.size();
+    return n;
+}
+
+size_t Optimizer::blocks(const IrProgram& ir)
+{
+    size_t n = 0;
+    for (const IrProc& p : ir.procs)
+        if (p.live) n += p.order.size();
+    return n;
+}
+
+/**
+ * @brief
+ * 依次执行各遍，有改动时再来一轮
+ */
+void Optimizer::run(IrProgram& ir)
+{
+    typedef std::chrono::steady_clock Clock;
+    passes.assign(4, PassStats());
+    passes[0].name = "常量传播";
+    passes[1].name = "常量折叠";
+    passes[2].name = "分支化简";
+    passes[3].name = "删除死代码";
+    roundCount = 0;
+
+    for (bool changed = true; changed && roundCount < maxRounds; ++roundCount) {
+        changed = false;
+        for (int k = 0; k < 4; ++k) {
+            Clock::time_point t0 = Clock::now();
+            long n = 0;
+            if (k == 3) {
+                n = eliminate(ir);
+            } else {
+                for (IrProc& p : ir.procs) {
+                    if (!p.live) continue;
+                    n += k == 0 ? propagate(p) : k == 1 ? fold(p) : simplify(p);
+                }
+            }
+            PassStats& s = passes[k];
+            s.seconds += std::chrono::duration<double>(Clock::now() - t0).count();
+            ++s.runs;
+            s.changes += n;
+            changed = changed || n > 0;
+        }
+    }
+}
+
+void Optimizer::report(FILE* out) const
+{
+    std::fprintf(out, "%-16s %6s %10s %10s\n", "优化遍", "执行", "改动", "耗时 ms");
+    for (const PassStats& s : passes)
+        std::fprintf(out, "%-16s %6d %10ld %10.3f\n", s.name, s.runs, s.changes, s.seconds * 1e3);
+    std::fprintf(out, "共 %d 轮\n", roundCount);
+}
@@ -0,0 +1,85 @@
+#ifndef PL0_PCODE_H
+#define PL0_PCODE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief P-code 指令码
+ * 经典 PL/0 指令集，另加读写与停机：
+ *   LIT 0,a   常数 a 入栈
+ *   OPR 0,a   运算，a 见 Opr
+ *   LOD l,a   把层差为 l 的变量 a 入栈
+ *   STO l,a   栈顶存入层差为 l 的变量 a
+ *   CAL l,a   调用层差为 l、入口为 a 的过程
+ *   INT 0,a   栈顶上移 a 个单元（为活动记录分配空间）
+ *   JMP 0,a   无条件跳转到 a
+ *   JPC 0,a   栈顶为 0 时跳转到 a（出栈）
+ *   RED l,a   读入一个整数存入层差为 l 的变量 a
+ *   WRT 0,0   栈顶出栈并写出，每个值一行
+ *   HLT 0,0   停机，由生成器放在代码末尾作为主程序的返回地址
+ */
+enum class Op : unsigned char { LIT, OPR, LOD, STO, CAL, INT, JMP, JPC, RED, WRT, HLT };
+
+/* OPR 的运算编号，与经典 PL/0 一致 */
+enum Opr {
+    OPR_RET = 0, OPR_NEG = 1, OPR_ADD = 2, OPR_SUB = 3, OPR_MUL = 4, OPR_DIV = 5,
+    OPR_ODD = 6, OPR_EQL = 8, OPR_NEQ = 9, OPR_LSS = 10, OPR_GEQ = 11, OPR_GTR = 12, OPR_LEQ = 13
+};
+
+/* 指令，16 字节；LIT 的常数与运行时的存储单元一样是 64 位 */
+struct Instr {
+    Op op;
+    uint8_t l;          // 层差
+    int64_t a;          // 常数、地址或运算编号
+};
+
+/* 运行时的存储单元 */
+typedef int64_t Word;
+
+/*
+ * 活动记录：b 为基址
+ *   s[b]     静态链，定义该过程的外层过程的活动记录基址
+ *   s[b+1]   动态链，调用者的活动记录基址
+ *   s[b+2]   返回地址
+ *   s[b+3..] 局部变量，第 k 个变量的地址为 3+k
+ */
+const int FRAME_HEADER = 3;
+
+/**
+ * @brief 目标程序
+ * 代码从地址 0 开始执行，主程序的分程序以 HLT 结束。
+ * maxTemp 为任一过程内表达式求值时栈上最多的临时单元数，
+ * 虚拟机据此只在分配活动记录（INT）时检查栈是否够用，入栈时不再逐条检查。
+ */
+struct Program {
+    std::vector<Instr> code;
+    int maxTemp = 0;
+};
+
+/* 指令执行后表达式栈深度的变化 */
+inline int stackEffect(Op op, int64_t a)
+{
+    switch (op) {
+    case Op::LIT: case Op::LOD: return 1;
+    case Op::STO: case Op::JPC: case Op::WRT: return -1;
+    case Op::OPR: return a == OPR_RET || a == OPR_NEG || a == OPR_ODD ? 0 : -1;    // 其余为二元运算
+    default: return 0;
+    }
+}
+
+inline const char* opName(Op op)
+{
+    static const char* const names[] = { "LIT", "OPR", "LOD", "STO", "CAL", "INT", "JMP", "JPC", "RED", "WRT", "HLT" };
+    return names[static_cast<int>(op)];
+}
+
+/* 以 "地址 助记符 l a" 的格式逐条列出代码 */
+inline void listCode(const std::vector<Instr>& code, FILE* out)
+{
+    for (size_t k = 0; k < code.size(); ++k)
+        std::fprintf(out, "%5zu  %s %u, %lld\n", k, opName(code[k].op), code[k].l, static_cast<long long>(code[k].a));
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "vm.h"
+
+#include <climits>
+
+namespace {
+
+/* 译码后的操作码：OPR 拆成各运算，LOD/STO 另有层差为 0 的形式，LIT 另有常数超出 32 位的形式 */
+enum XOp : unsigned {
+    X_LIT, X_LITW, X_LOD, X_LOD0, X_STO, X_STO0, X_CAL, X_INT, X_JMP, X_JPC, X_RED, X_WRT, X_HLT,
+    X_RET, X_NEG, X_ADD, X_SUB, X_MUL, X_DIV, X_ODD, X_EQL, X_NEQ, X_LSS, X_GEQ, X_GTR, X_LEQ,
+    X_BAD       // 未知的 OPR 运算
+};
+
+XOp decode(const Instr& in)
+{
+    switch (in.op) {
+    case Op::LIT: return in.a >= INT32_MIN && in.a <= INT32_MAX ? X_LIT : X_LITW;
+    case Op::LOD: return in.l ? X_LOD : X_LOD0;
+    case Op::STO: return in.l ? X_STO : X_STO0;
+    case Op::CAL: return X_CAL;
+    case Op::INT: return X_INT;
+    case Op::JMP: return X_JMP;
+    case Op::JPC: return X_JPC;
+    case Op::RED: return X_RED;
+    case Op::WRT: return X_WRT;
+    case Op::HLT: return X_HLT;
+    case Op::OPR: break;
+    }
+    switch (in.a) {
+    case OPR_RET: return X_RET;
+    case OPR_NEG: return X_NEG;
+    case OPR_ADD: return X_ADD;
+    case OPR_SUB: return X_SUB;
+    case OPR_MUL: return X_MUL;
+    case OPR_DIV: return X_DIV;
+    case OPR_ODD: return X_ODD;
+    case OPR_EQL: return X_EQL;
+    case OPR_NEQ: return X_NEQ;
+    case OPR_LSS: return X_LSS;
+    case OPR_GEQ: return X_GEQ;
+    case OPR_GTR: return X_GTR;
+    case OPR_LEQ: return X_LEQ;
+    default: return X_BAD;
+    }
+}
+
+/* 加减乘按 64 位补码回绕，不触发有符号溢出 */
+inline Word wrap(uint64_t v) { return static_cast<Word>(v); }
+
+}
+
+VM::VM(size_t stackWords) : stack(stackWords < 64 ? 64 : stackWords) {}
+
+const char* VM::dispatch()
+{
+#ifdef PL0_VM_THREADED
+    return "computed goto";
+#else
+    return "switch";
+#endif
+}
+
+/**
+ * @brief
+ * 运行程序
+ * 栈指针 sp 指向栈顶之上的第一个空单元，bp 为当前活动记录的基址；
+ * 活动记录里的静态链、动态链存的是基址在栈中的下标，返回地址为指令下标。
+ */
+bool VM::run(const Program& prog, FILE* in, FILE* out, std::string& err)
+{
+    count = 0;
+    const std::vector<Instr>& code = prog.code;
+    if (code.empty()) {
+        err = "没有代码";
+        return false;
+    }
+
+#ifdef PL0_VM_THREADED
+    static const void* const labels[] = {
+        &&L_LIT, &&L_LITW, &&L_LOD, &&L_LOD0, &&L_STO, &&L_STO0, &&L_CAL, &&L_INT, &&L_JMP, &&L_JPC, &&L_RED, &&L_WRT, &&L_HLT,
+        &&L_RET, &&L_NEG, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_ODD, &&L_EQL, &&L_NEQ, &&L_LSS, &&L_GEQ, &&L_GTR, &&L_LEQ,
+        &&L_BAD
+    };
+#endif
+    cells.resize(code.size());
+    wide.clear();
+    for (size_t k = 0; k < code.size(); ++k) {
+        const Instr& i = code[k];
+        if ((i.op == Op::CAL || i.op == Op::JMP || i.op == Op::JPC)
+            && (i.a < 0 || static_cast<size_t>(i.a) >= code.size())) {
+            err = "地址 " + std::to_string(k) + ": 跳转目标越界";
+            return false;
+        }
+        XOp x = decode(i);
+#ifdef PL0_VM_THREADED
+        cells[k].h = labels[x];
+#else
+        cells[k].op = x;
+#endif
+        cells[k].l = i.l;
+        if (x == X_LITW) {
+            cells[k].a = static_cast<int32_t>(wide.size());
+            wide.push_back(i.a);
+        } else {
+            cells[k].a = static_cast<int32_t>(i.a);
+        }
+    }
+
+    if (static_cast<size_t>(prog.maxTemp) + 2 * FRAME_HEADER >= stack.size()) {
+        err = "栈溢出";
+        return false;
+    }
+    Word* const s = stack.data();
+    Word* const limit = s + stack.size() - prog.maxTemp - FRAME_HEADER;     // INT 之后栈顶不得越过
+    Word* sp = s;                       // 主程序的活动记录从栈底开始，静态链、动态链、返回地址均为 0
+    Word* bp = s;
+    s[0] = s[1] = s[2] = 0;
+    const Cell* const base = cells.data();
+    const Cell* ip = base;
+    uint64_t n = 0;
+    const char* why = nullptr;
+
+#define FRAME(l) Word* f = bp; for (int32_t k = (l); k > 0; --k) f = s + *f
+#ifdef PL0_VM_THREADED
+#define CASE(x) L_##x:
+#define DISPATCH() do { ++n; goto *ip->h; } while (0)
+    DISPATCH();
+#else
+#define CASE(x) case X_##x:
+#define DISPATCH() continue
+    for (;;) {
+        ++n;
+        switch (ip->op) {
+#endif
+        CASE(LIT) *sp++ = ip->a; ++ip; DISPATCH();
+        CASE(LITW) *sp++ = wide[ip->a]; ++ip; DISPATCH();
+        CASE(LOD0) *sp++ = bp[ip->a]; ++ip; DISPATCH();
+        CASE(LOD) { FRAME(ip->l); *sp++ = f[ip->a]; ++ip; DISPATCH(); }
+        CASE(STO0) bp[ip->a] = *--sp; ++ip; DISPATCH();
+        CASE(STO) { FRAME(ip->l); f[ip->a] = *--sp; ++ip; DISPATCH(); }
+        CASE(CAL) {
+            FRAME(ip->l);
+            sp[0] = f - s;                  // 静态链：被调过程定义处的活动记录
+            sp[1] = bp - s;                 // 动态链
+            sp[2] = ip - base + 1;          // 返回地址
+            bp = sp;
+            ip = base + ip->a;
+            DISPATCH();
+        }
+        CASE(INT) {
+            Word* top = sp + ip->a;
+            if (top > limit) { why = "栈溢出"; goto fail; }
+            for (Word* p = bp + FRAME_HEADER; p < top; ++p) *p = 0;
+            sp = top;
+            ++ip;
+            DISPATCH();
+        }
+        CASE(JMP) ip = base + ip->a; DISPATCH();
+        CASE(JPC) ip = *--sp ? ip + 1 : base + ip->a; DISPATCH();
+        CASE(RED) {
+            long long v;
+            if (std::fscanf(in, "%lld", &v) != 1) { why = "读入失败"; goto fail; }
+            FRAME(ip->l);
+            f[ip->a] = v;
+            ++ip;
+            DISPATCH();
+        }
+        CASE(WRT) std::fprintf(out, "%lld\n", static_cast<long long>(*--sp)); ++ip; DISPATCH();
+        CASE(HLT) goto done;
+        CASE(RET) sp = bp; ip = base + bp[2]; bp = s + bp[1]; DISPATCH();
+        CASE(NEG) sp[-1] = wrap(0 - static_cast<uint64_t>(sp[-1])); ++ip; DISPATCH();
+        CASE(ADD) --sp; sp[-1] = wrap(static_cast<uint64_t>(sp[-1]) + static_cast<uint64_t>(sp[0])); ++ip; DISPATCH();
+        CASE(SUB) --sp; sp[-1] = wrap(static_cast<uint64_t>(sp[-1]) - static_cast<uint64_t>(sp[0])); ++ip; DISPATCH();
+        CASE(MUL) --sp; sp[-1] = wrap(static_cast<uint64_t>(sp[-1]) * static_cast<uint64_t>(sp[0])); ++ip; DISPATCH();
+        CASE(DIV) {
+            --sp;
+            if (sp[0] == 0) { why = "除数为 0"; goto fail; }
+            sp[-1] = sp[0] == -1 ? wrap(0 - static_cast<uint64_t>(sp[-1])) : sp[-1] / sp[0];
+            ++ip;
+            DISPATCH();
+        }
+        CASE(ODD) sp[-1] &= 1; ++ip; DISPATCH();
+        CASE(EQL) --sp; sp[-1] = sp[-1] == sp[0]; ++ip; DISPATCH();
+        CASE(NEQ) --sp; sp[-1] = sp[-1] != sp[0]; ++ip; DISPATCH();
+        CASE(LSS) --sp; sp[-1] = sp[-1] < sp[0]; ++ip; DISPATCH();
+        CASE(GEQ) --sp; sp[-1] = sp[-1] >= sp[0]; ++ip; DISPATCH();
+        CASE(GTR) --sp; sp[-1] = sp[-1] > sp[0]; ++ip; DISPATCH();
+        CASE(LEQ) --sp; sp[-1] = sp[-1] <= sp[0]; ++ip; DISPATCH();
+        CASE(BAD) why = "未知的运算"; goto fail;
+#ifndef PL0_VM_THREADED
+        }
+    }
+#endif
+#undef FRAME
+#undef CASE
+#undef DISPATCH
+
+done:
+    count = n;
+    return true;
+fail:
+    count = n;
+    err = "地址 " + std::to_string(ip - base) + ": " + why;
+    return false;
+}
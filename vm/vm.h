@@ -0,0 +1,56 @@
+#ifndef PL0_VM_H
+#define PL0_VM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pcode.h"
+
+/* GCC/Clang 下用标签地址（computed goto）做线程化分派；定义 PL0_VM_SWITCH 可强制用 switch */
+#if defined(__GNUC__) && !defined(PL0_VM_SWITCH)
+#define PL0_VM_THREADED 1
+#endif
+
+/**
+ * @brief P-code 虚拟机
+ * 运行前把指令译成内部形式：OPR 按运算拆成各自的操作码，LOD/STO 的层差为 0 时
+ * 另用不走静态链的操作码；线程化分派时每条指令直接存其处理代码的地址，
+ * 每条指令执行完直接跳到下一条的处理代码，不经过集中的 switch。
+ *
+ * 数据栈以 64 位整数为单元，活动记录的布局见 pcode.h；局部变量在分配时清零。
+ * 栈空间只在 INT 分配活动记录时检查（留出 Program::maxTemp 个临时单元），
+ * 除数为 0、栈溢出、读入失败时停止运行并给出原因。
+ */
+class VM {
+public:
+    explicit VM(size_t stackWords = 1 << 20);
+
+    /* 运行程序，read 从 in 读整数，write 向 out 写整数，每个一行；出错时返回 false 并在 err 中给出原因 */
+    bool run(const Program& prog, FILE* in, FILE* out, std::string& err);
+
+    /* 上一次运行执行的指令条数 */
+    uint64_t steps() const { return count; }
+
+    /* 分派方式："computed goto" 或 "switch" */
+    static const char* dispatch();
+
+private:
+    /* 译码后的指令 */
+    struct Cell {
+#ifdef PL0_VM_THREADED
+        const void* h;      // 处理代码的地址
+#else
+        unsigned op;
+#endif
+        int32_t l, a;       // 超出 32 位的 LIT 常数存在 wide 里，a 为其下标
+    };
+
+    std::vector<Word> stack;
+    std::vector<Cell> cells;
+    std::vector<Word> wide;
+    uint64_t count = 0;
+};
+
+#endif